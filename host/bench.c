@@ -0,0 +1,276 @@
+/*
+ * bench.c
+ * Host benchmark for the ephemeris routines in src/ephemeris.c.
+ *
+ * Every function is evaluated over the same sweep of timestamps, a few
+ * passes each, and the fastest pass is reported so that the numbers
+ * are repeatable from run to run.
+ *
+ *   bench [samples] [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephemeris_fixed.h"
+#include "ephemeris_cache.h"
+#include "ephemeris_batch.h"
+
+#define SWEEP_START 631152000L    // 1990-01-01 00:00 UTC
+#define SWEEP_END   2208988800L   // 2040-01-01 00:00 UTC
+
+typedef struct {
+  struct tm tm;
+  time_t when;
+  double T;
+  double longitude;
+  double range;
+} Sample;
+
+typedef struct {
+  const char *name;
+  double (*fn)(const Sample *s);
+} BenchCase;
+
+static Sample *s_samples;
+static int s_sample_count;
+static volatile double s_sink;
+
+
+static double bench_DateToJD(const Sample *s) {
+  struct tm t = s->tm;
+  return DateToJD(&t);
+}
+
+static double bench_JDtoT(const Sample *s) {
+  double JD = 2451545.0 + s->T * 36525.0;
+  return JDtoT(&JD);
+}
+
+static double bench_sigmaMoonLongitude(const Sample *s) {
+  return sigmaMoonLongitude(s->T);
+}
+
+static double bench_sigmaMoonRange(const Sample *s) {
+  return sigmaMoonRange(s->T);
+}
+
+static double bench_moonPosition(const Sample *s) {
+  MoonPosition pos;
+  moonPosition(s->T, &pos);
+  return pos.longitude + pos.latitude + pos.range;
+}
+
+static double bench_moonPositionFixed(const Sample *s) {
+  MoonPositionFixed pos;
+  moonPositionFixed(s->when, &pos);
+  return pos.longitude + pos.latitude + pos.range;
+}
+
+static double bench_moonRA(const Sample *s) {
+  return moonRA(s->longitude);
+}
+
+static double bench_sunRA(const Sample *s) {
+  return sunRA(s->T);
+}
+
+static double bench_greenwichSiderealTime(const Sample *s) {
+  struct tm t = s->tm;
+  return greenwichSiderealTime(s->T, &t);
+}
+
+static double bench_moonOrbitalSpeed(const Sample *s) {
+  return moonOrbitalSpeed(s->range);
+}
+
+static double bench_epochFromTime(const Sample *s) {
+  Epoch epoch;
+  epochFromTime(&epoch, s->when);
+  return epoch.gst;
+}
+
+// Everything canvas_update_proc computes for one frame, from one epoch.
+static double bench_tick(const Sample *s) {
+  Epoch epoch;
+  epochFromTime(&epoch, s->when);
+  MoonPosition moon;
+  moonPositionAt(&epoch, &moon);
+  double speed = moonOrbitalSpeed(moon.range);
+  double moonHourAngle = normDegrees(epoch.gst - moonRA(moon.longitude));
+  double sunHourAngle = normDegrees(epoch.gst - sunRAAt(&epoch));
+  return speed + sinx(radians(moonHourAngle)) + cosx(radians(moonHourAngle)) + sunHourAngle;
+}
+
+// The same frame with LUNA_FIXED_POINT.
+static double bench_tick_fixed(const Sample *s) {
+  MoonPositionFixed moon;
+  moonPositionFixed(s->when, &moon);
+  int32_t sidereal = greenwichSiderealTimeFixed(s->when);
+  int32_t moonAngle = (sidereal - moonRAFixed(moon.longitude)) & (EPH_TRIG_MAX_ANGLE - 1);
+  int32_t sunAngle = (sidereal - sunRAFixed(s->when)) & (EPH_TRIG_MAX_ANGLE - 1);
+  double speed = moonOrbitalSpeed(moon.range * 0.00062137119);
+  return speed + sinLookup(moonAngle) + cosLookup(moonAngle) + sunAngle;
+}
+
+// The same frame answered from the Chebyshev cache.  Consecutive
+// samples are far apart, so the sweep is walked a minute at a time.
+static EphemerisCache s_cache;
+
+static double bench_tick_cached(const Sample *s) {
+  time_t when = s_samples[0].when + 60 * (s - s_samples);
+  Epoch epoch;
+  epochFromTime(&epoch, when);
+  CachedEphemeris cached;
+  ephemerisCacheGet(&s_cache, when, &cached);
+  double speed = moonOrbitalSpeed(cached.range);
+  double moonHourAngle = normDegrees(epoch.gst - cached.moonRA);
+  double sunHourAngle = normDegrees(epoch.gst - cached.sunRA);
+  return speed + sinx(radians(moonHourAngle)) + cosx(radians(moonHourAngle)) + sunHourAngle;
+}
+
+static const BenchCase s_cases[] = {
+  { "DateToJD",              bench_DateToJD },
+  { "JDtoT",                 bench_JDtoT },
+  { "epochFromTime",         bench_epochFromTime },
+  { "sigmaMoonLongitude",    bench_sigmaMoonLongitude },
+  { "sigmaMoonRange",        bench_sigmaMoonRange },
+  { "moonPosition",          bench_moonPosition },
+  { "moonPositionFixed",     bench_moonPositionFixed },
+  { "moonRA",                bench_moonRA },
+  { "sunRA",                 bench_sunRA },
+  { "greenwichSiderealTime", bench_greenwichSiderealTime },
+  { "moonOrbitalSpeed",      bench_moonOrbitalSpeed },
+  { "tick (full frame)",     bench_tick },
+  { "tick (fixed point)",    bench_tick_fixed },
+  { "tick (cached, 1/min)",  bench_tick_cached },
+};
+
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static double angle_error(double a, double b) {
+  double d = normDegrees(a - b);
+  return d >= 180.0 ? 360.0 - d : d;
+}
+
+
+// moonPositionBatch() against the same instants one moonPosition() and
+// moonRA() at a time, and how far apart the answers are.
+static void run_batch(int passes) {
+  int n = s_sample_count;
+  double *T = malloc(sizeof(double) * n * 7);
+  double *lon = T + n, *range = lon + n, *ra = range + n;
+  double *slon = ra + n, *srange = slon + n, *sra = srange + n;
+  double batch = 0.0, scalar = 0.0;
+  double lonError = 0.0, rangeError = 0.0, raError = 0.0;
+
+  for (int i = 0; i < n; i++) {
+    T[i] = s_samples[i].T;
+  }
+  for (int pass = 0; pass < passes; pass++) {
+    double start = now_ns();
+    moonPositionBatch(T, lon, range, ra, n);
+    double elapsed = now_ns() - start;
+    if (pass == 0 || elapsed < batch) {
+      batch = elapsed;
+    }
+
+    start = now_ns();
+    for (int i = 0; i < n; i++) {
+      MoonPosition pos;
+      moonPosition(T[i], &pos);
+      slon[i] = pos.longitude;
+      srange[i] = pos.range;
+      sra[i] = moonRA(pos.longitude);
+    }
+    elapsed = now_ns() - start;
+    if (pass == 0 || elapsed < scalar) {
+      scalar = elapsed;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    double e = angle_error(lon[i], slon[i]);
+    lonError = e > lonError ? e : lonError;
+    e = range[i] > srange[i] ? range[i] - srange[i] : srange[i] - range[i];
+    rangeError = e > rangeError ? e : rangeError;
+    e = angle_error(ra[i], sra[i]);
+    raError = e > raError ? e : raError;
+  }
+
+  printf("\nlongitude, range and RA for %d timestamps\n\n", n);
+  printf("%-24s %12s %14s\n", "", "ns/eval", "evals/s");
+  printf("%-24s %12.1f %14.0f\n", "moonPositionBatch", batch / n, 1e9 * n / batch);
+  printf("%-24s %12.1f %14.0f\n", "N x scalar", scalar / n, 1e9 * n / scalar);
+  printf("\nspeedup %.2fx, batch vs scalar: longitude %.6f deg, range %.4f mi, RA %.6f deg\n",
+         scalar / batch, lonError, rangeError, raError);
+  free(T);
+}
+
+
+static void make_samples(int count) {
+  double step = (double)(SWEEP_END - SWEEP_START) / count;
+
+  s_samples = malloc(sizeof(Sample) * count);
+  s_sample_count = count;
+  for (int i = 0; i < count; i++) {
+    Sample *s = &s_samples[i];
+    time_t when = SWEEP_START + (time_t)(i * step);
+    s->when = when;
+    gmtime_r(&when, &s->tm);
+    double JD = DateToJD(&s->tm);
+    s->T = JDtoT(&JD);
+    s->longitude = sigmaMoonLongitude(s->T);
+    s->range = sigmaMoonRange(s->T);
+  }
+}
+
+
+static double run_case(const BenchCase *c, int passes) {
+  double best = 0.0;
+
+  for (int pass = 0; pass < passes; pass++) {
+    double acc = 0.0;
+    double start = now_ns();
+    for (int i = 0; i < s_sample_count; i++) {
+      acc += c->fn(&s_samples[i]);
+    }
+    double elapsed = now_ns() - start;
+    s_sink = acc;
+    if (pass == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best / s_sample_count;
+}
+
+
+int main(int argc, char **argv) {
+  int samples = argc > 1 ? atoi(argv[1]) : 20000;
+  int passes = argc > 2 ? atoi(argv[2]) : 5;
+
+  if (samples < 1 || passes < 1) {
+    fprintf(stderr, "usage: %s [samples] [passes]\n", argv[0]);
+    return 1;
+  }
+  make_samples(samples);
+
+  printf("%d timestamps, 1990-2040, best of %d passes\n\n", samples, passes);
+  printf("%-24s %12s %14s\n", "function", "ns/eval", "evals/s");
+  for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+    double ns = run_case(&s_cases[i], passes);
+    printf("%-24s %12.1f %14.0f\n", s_cases[i].name, ns, 1e9 / ns);
+  }
+
+  run_batch(passes);
+
+  free(s_samples);
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * cache_check.c
+ * Replays minute ticks through the Chebyshev ephemeris cache
+ * (src/ephemeris_cache.c), with occasional clock jumps, and compares
+ * every answer with a direct evaluation.  Fails if an angle is off by
+ * more than MAX_ANGLE_ERROR degrees or the range by more than
+ * MAX_RANGE_ERROR miles.  The right ascension bound is set by the
+ * direct path: the Taylor sinx()/cosx() step by ~5e-4 at PI, which a
+ * smooth fit does not follow.  One pixel on the face is about 1 degree.
+ * The rates, the series' own and the derivative of the fit, are held
+ * to MAX_LONGITUDE_RATE_ERROR degrees and MAX_RANGE_RATE_ERROR miles a
+ * day against a central difference of the series over a minute either
+ * side; the face shows the range rate to a tenth of a mile an hour.
+ *
+ *   cache_check [days]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephemeris_cache.h"
+
+#define START 1420070400L          // 2015-01-01 00:00 UTC
+
+#define MAX_ANGLE_ERROR 0.05
+#define MAX_RANGE_ERROR 0.5
+#define MAX_LONGITUDE_RATE_ERROR 0.001
+#define MAX_RANGE_RATE_ERROR     0.1
+
+// Either side of the tick for the central difference, seconds
+#define RATE_STEP 60.0
+
+
+static double angleError(double a, double b) {
+  double d = normDegrees(a - b);
+  d = d >= 180.0 ? 360.0 - d : d;
+  return d;
+}
+
+
+static void worst(double *w, double e) {
+  if (e < 0) {
+    e = -e;
+  }
+  if (e > *w) {
+    *w = e;
+  }
+}
+
+
+int main(int argc, char **argv) {
+  int days = argc > 1 ? atoi(argv[1]) : 60;
+  EphemerisCache cache;
+  CachedEphemeris cached;
+  double lon = 0, range = 0, mra = 0, sra = 0;
+  double lonRate = 0, rangeRate = 0, cachedLonRate = 0, cachedRangeRate = 0;
+  unsigned int seed = 4321;
+  int ticks = 0;
+  time_t t = START;
+
+  ephemerisCacheInit(&cache);
+  while (t < START + days * 86400L) {
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    double JD = DateToJD(&tm);
+    double T = JDtoT(&JD);
+    MoonPosition moon, before, after;
+    moonPosition(T, &moon);
+    moonPosition(T - RATE_STEP / 86400.0 / 36525.0, &before);
+    moonPosition(T + RATE_STEP / 86400.0 / 36525.0, &after);
+    double differenceLonRate = normDegrees(after.longitude - before.longitude + 180.0) - 180.0;
+    differenceLonRate *= 86400.0 / (2.0 * RATE_STEP);
+    double differenceRangeRate = (after.range - before.range) * 86400.0 / (2.0 * RATE_STEP);
+
+    ephemerisCacheGet(&cache, t, &cached);
+    worst(&lon, angleError(cached.longitude, moon.longitude));
+    worst(&range, cached.range - moon.range);
+    worst(&mra, angleError(cached.moonRA, moonRA(moon.longitude)));
+    worst(&sra, angleError(cached.sunRA, sunRA(T)));
+    worst(&lonRate, moon.longitudeRate - differenceLonRate);
+    worst(&rangeRate, moon.rangeRate - differenceRangeRate);
+    worst(&cachedLonRate, cached.longitudeRate - differenceLonRate);
+    worst(&cachedRangeRate, cached.rangeRate - differenceRangeRate);
+    ticks++;
+
+    // Mostly minute ticks, now and then the clock is set
+    seed = seed * 1103515245u + 12345u;
+    if ((seed >> 16) % 500 == 0) {
+      t += (time_t)((seed >> 8) % 172800) - 86400;
+    } else {
+      t += 60;
+    }
+  }
+
+  printf("%d ticks over %d days, %u fits (%.1f ticks per fit)\n\n",
+         ticks, days, cache.fits, (double)ticks / cache.fits);
+  printf("longitude   %.6f deg\n", lon);
+  printf("range       %.6f mi\n", range);
+  printf("moon RA     %.6f deg\n", mra);
+  printf("sun RA      %.6f deg\n", sra);
+  printf("\nrates against a central difference, per day\n");
+  printf("longitude   %.6f deg series   %.6f deg cache\n", lonRate, cachedLonRate);
+  printf("range       %.6f mi series    %.6f mi cache\n", rangeRate, cachedRangeRate);
+
+  int failed = 0;
+  if (lon > MAX_ANGLE_ERROR || mra > MAX_ANGLE_ERROR || sra > MAX_ANGLE_ERROR
+      || range > MAX_RANGE_ERROR) {
+    printf("FAIL: bound is %.3f deg / %.1f mi\n", MAX_ANGLE_ERROR, MAX_RANGE_ERROR);
+    failed = 1;
+  }
+  if (lonRate > MAX_LONGITUDE_RATE_ERROR || cachedLonRate > MAX_LONGITUDE_RATE_ERROR
+      || rangeRate > MAX_RANGE_RATE_ERROR || cachedRangeRate > MAX_RANGE_RATE_ERROR) {
+    printf("FAIL: rate bound is %.3f deg / %.1f mi a day\n",
+           MAX_LONGITUDE_RATE_ERROR, MAX_RANGE_RATE_ERROR);
+    failed = 1;
+  }
+  return failed;
+}
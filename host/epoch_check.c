@@ -0,0 +1,103 @@
+/*
+ * epoch_check.c
+ * Compares the epoch (src/epoch.c) with the routines it stands in for:
+ * the fundamental arguments against the polynomials in lunar_terms.h
+ * and sidereal time against greenwichSiderealTime(), at T from
+ * DateToJD() and JDtoT(), over random instants from 1900 to 2100.
+ * Also that epochFromT() agrees with epochFromTime().  Fails if any
+ * is off by more than MAX_ERROR degrees, about what the Julian date
+ * in a double resolves at these dates.
+ *
+ *   epoch_check [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "epoch.h"
+#include "lunar_terms.h"
+
+#define SWEEP_START -2208988800LL  // 1900-01-01 00:00 UTC
+#define SWEEP_END   4102444800LL   // 2100-01-01 00:00 UTC
+
+#define MAX_ERROR 1e-6
+
+enum {
+  CHECK_L, CHECK_D, CHECK_M, CHECK_MM, CHECK_F, CHECK_E, CHECK_GST, CHECK_FROM_T,
+  CHECKS
+};
+
+static const char *s_names[CHECKS] = {
+  "L", "D", "M", "M'", "F", "E", "sidereal time", "epochFromT",
+};
+
+
+static double angleError(double a, double b) {
+  double d = normDegrees(a - b);
+  return d >= 180.0 ? 360.0 - d : d;
+}
+
+
+int main(int argc, char **argv) {
+  int samples = argc > 1 ? atoi(argv[1]) : 200000;
+  double worst[CHECKS] = {0};
+  time_t worstAt[CHECKS] = {0};
+  unsigned int seed = 2468;
+  int failures = 0;
+
+  for (int i = 0; i < samples; i++) {
+    seed = seed * 1103515245u + 12345u;
+    unsigned int high = seed >> 8;
+    seed = seed * 1103515245u + 12345u;
+    double u = (high + (double)(seed >> 16) / 65536.0) / 16777216.0;
+    time_t t = (time_t)(SWEEP_START + (long long)(u * (SWEEP_END - SWEEP_START)));
+    if (i < 3) {
+      // J2000.0 itself and either side of it
+      t = EPOCH_J2000_UNIX - 1 + i;
+    }
+
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    double JD = DateToJD(&tm);
+    double T = JDtoT(&JD);
+    Epoch epoch, fromT;
+    epochFromTime(&epoch, t);
+    epochFromT(&fromT, epoch.T);
+
+    double error[CHECKS] = {
+      [CHECK_L]  = angleError(degrees(epoch.L), moonMeanLongitude(T)),
+      [CHECK_D]  = angleError(degrees(epoch.D), moonMeanElongation(T)),
+      [CHECK_M]  = angleError(degrees(epoch.M), sunMeanAnomaly(T)),
+      [CHECK_MM] = angleError(degrees(epoch.Mm), moonMeanAnomaly(T)),
+      [CHECK_F]  = angleError(degrees(epoch.F), moonArgLatitude(T)),
+      [CHECK_E]  = epoch.Epow[2] - Eccentricity(T) * Eccentricity(T),
+      [CHECK_GST] = angleError(epoch.gst, greenwichSiderealTime(T, &tm)),
+      [CHECK_FROM_T] = angleError(fromT.gst, epoch.gst) + angleError(degrees(fromT.L), degrees(epoch.L)),
+    };
+    for (int check = 0; check < CHECKS; check++) {
+      double e = error[check] < 0 ? -error[check] : error[check];
+      if (e > worst[check]) {
+        worst[check] = e;
+        worstAt[check] = t;
+      }
+    }
+  }
+
+  printf("%d instants, 1900-2100\n\n", samples);
+  printf("%-16s %12s   %s\n", "quantity", "max error", "at");
+  for (int check = 0; check < CHECKS; check++) {
+    char when[32];
+    struct tm tm;
+    gmtime_r(&worstAt[check], &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    printf("%-16s %12.3g   %s\n", s_names[check], worst[check], when);
+    if (worst[check] > MAX_ERROR) {
+      failures++;
+    }
+  }
+  if (failures > 0) {
+    printf("FAIL: bound is %g deg\n", MAX_ERROR);
+  }
+  return failures > 0;
+}
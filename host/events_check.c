@@ -0,0 +1,192 @@
+/*
+ * events_check.c
+ * Checks the lunar events engine (src/lunar_events.c).
+ *
+ * Phases, perigee and apogee are compared with published times.  Rise,
+ * set and transit are compared with a brute force scan, a minute at a
+ * time, of the altitude and hour angle worked out with libm, for random
+ * times and places.  Also checks that the results are cached: a second
+ * update makes no ephemeris calls, and a new location only repeats the
+ * local searches.
+ *
+ *   events_check [places]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "lunar_events.h"
+
+#define SWEEP_START 946684800L    // 2000-01-01 00:00 UTC
+#define SWEEP_DAYS  (30 * 365)
+
+#define SCAN_STEP   60
+#define SCAN_HOURS  27
+
+// Published times, UT.  The bound covers the truncated series, UT taken
+// for dynamical time, the geometric solar longitude and, for perigee and
+// apogee, the flat bottom of the range curve.  The long double reference
+// puts the phases 125 to 186 s late on its own.
+#define MAX_PHASE_ERROR   240
+#define MAX_APSIS_ERROR   (45 * 60)
+#define MAX_LOCAL_ERROR   (LUNAR_EVENT_TOLERANCE + 2 * SCAN_STEP)
+
+typedef struct {
+  const char *name;
+  int event;
+  time_t when;
+  int32_t bound;
+} Reference;
+
+static const Reference s_references[] = {
+  // Meeus - Astronomical Algorithms - examples 49.a and 50.a
+  { "new moon 1977-02-18",      LUNAR_NEW_MOON,      225085014,  MAX_PHASE_ERROR },
+  { "apogee 1988-10-07",        LUNAR_APOGEE,        592259355,  MAX_APSIS_ERROR },
+  { "full moon 2015-01-05",     LUNAR_FULL_MOON,     1420433580, MAX_PHASE_ERROR },
+  { "apogee 2015-01-09",        LUNAR_APOGEE,        1420827540, MAX_APSIS_ERROR },
+  { "last quarter 2015-01-13",  LUNAR_LAST_QUARTER,  1421142360, MAX_PHASE_ERROR },
+  { "new moon 2015-01-20",      LUNAR_NEW_MOON,      1421759640, MAX_PHASE_ERROR },
+  { "perigee 2015-01-21",       LUNAR_PERIGEE,       1421870820, MAX_APSIS_ERROR },
+  { "first quarter 2015-01-27", LUNAR_FIRST_QUARTER, 1422334080, MAX_PHASE_ERROR },
+};
+
+
+// sin(altitude) - sin(h0) and sin(hour angle) from libm.
+static void horizon(time_t t, double latitude, double longitude, double *rise, double *transit) {
+  double d = (t - 946728000.0) / 86400.0;
+  double T = d / 36525.0;
+  double e = obliquityE * M_PI / 180.0;
+  MoonPosition moon;
+
+  moonPosition(T, &moon);
+  double l = moon.longitude * M_PI / 180.0;
+  double b = moon.latitude * M_PI / 180.0;
+  double ra = atan2(sin(l) * cos(e) - tan(b) * sin(e), cos(l));
+  double dec = asin(sin(b) * cos(e) + cos(b) * sin(e) * sin(l));
+  // Meeus - Astronomical Algorithms - formula 12.4
+  double theta = 280.46061837 + 360.98564736629 * d + 0.000387933 * T * T;
+  double H = (theta - longitude) * M_PI / 180.0 - ra;
+  double phi = latitude * M_PI / 180.0;
+
+  *rise = sin(phi) * sin(dec) + cos(phi) * cos(dec) * cos(H) - sin(0.125 * M_PI / 180.0);
+  *transit = sin(H);
+}
+
+
+// First rising zero of each function after now, 0 if none.
+static void bruteForce(time_t now, double latitude, double longitude, time_t *when) {
+  double rise0,transit0;
+
+  when[LUNAR_RISE] = when[LUNAR_SET] = when[LUNAR_TRANSIT] = 0;
+  horizon(now, latitude, longitude, &rise0, &transit0);
+  for (time_t t = now + SCAN_STEP; t <= now + SCAN_HOURS * 3600; t += SCAN_STEP) {
+    double rise,transit;
+    horizon(t, latitude, longitude, &rise, &transit);
+    if (!when[LUNAR_RISE] && rise0 < 0 && rise >= 0) {
+      when[LUNAR_RISE] = t;
+    }
+    if (!when[LUNAR_SET] && rise0 >= 0 && rise < 0) {
+      when[LUNAR_SET] = t;
+    }
+    if (!when[LUNAR_TRANSIT] && transit0 < 0 && transit >= 0) {
+      when[LUNAR_TRANSIT] = t;
+    }
+    rise0 = rise;
+    transit0 = transit;
+  }
+}
+
+
+int main(int argc, char **argv) {
+  int places = argc > 1 ? atoi(argv[1]) : 200;
+  static const char *names[] = { "rise", "set", "transit" };
+  long worst[3] = { 0, 0, 0 };
+  int missing[3] = { 0, 0, 0 };
+  unsigned int seed = 2718;
+  unsigned long evaluations = 0, steps = 0, updates = 0;
+  int failed = 0;
+  LunarEvents events;
+
+  // Published events, each searched from a day before
+  printf("%-26s %12s\n", "event", "error (s)");
+  for (size_t i = 0; i < sizeof(s_references) / sizeof(s_references[0]); i++) {
+    const Reference *r = &s_references[i];
+    lunarEventsInit(&events);
+    lunarEventsUpdate(&events, r->when - 86400, 0, 0);
+    long error = (long)(events.when[r->event] - r->when);
+    lunarEventsDeinit(&events);
+    printf("%-26s %12ld\n", r->name, error);
+    if (labs(error) > r->bound) {
+      printf("FAIL: bound is %ld s\n", (long)r->bound);
+      failed = 1;
+    }
+  }
+
+  // Rise, set and transit against the brute force scan
+  for (int i = 0; i < places; i++) {
+    seed = seed * 1103515245u + 12345u;
+    time_t now = SWEEP_START + (time_t)((seed >> 4) % (SWEEP_DAYS * 86400u / 16)) * 16;
+    seed = seed * 1103515245u + 12345u;
+    int32_t latitude = (int32_t)((seed >> 8) % (120 * LUNAR_LOCATION_SCALE + 1)) - 60 * LUNAR_LOCATION_SCALE;
+    seed = seed * 1103515245u + 12345u;
+    int32_t longitude = (int32_t)((seed >> 8) % (360 * LUNAR_LOCATION_SCALE));
+    time_t expected[LUNAR_EVENTS];
+
+    lunarEventsInit(&events);
+    lunarEventsUpdate(&events, now, latitude, longitude);
+    evaluations += events.evaluations;
+    steps += events.steps;
+    updates++;
+    lunarEventsDeinit(&events);
+    bruteForce(now, (double)latitude / LUNAR_LOCATION_SCALE, (double)longitude / LUNAR_LOCATION_SCALE,
+               expected);
+
+    for (int event = LUNAR_RISE; event <= LUNAR_TRANSIT; event++) {
+      if (events.when[event] > now + SCAN_HOURS * 3600 - MAX_LOCAL_ERROR) {
+        continue;   // past the end of the brute force scan
+      }
+      if (!expected[event] || !events.when[event]) {
+        if (expected[event] != events.when[event]) {
+          missing[event]++;
+        }
+        continue;
+      }
+      long error = labs((long)(events.when[event] - expected[event]));
+      if (error > worst[event]) {
+        worst[event] = error;
+      }
+    }
+  }
+
+  printf("\n%d places, %.1f ephemeris calls and %.1f propagator steps per full search\n\n",
+         places, (double)evaluations / updates, (double)steps / updates);
+  printf("%-26s %12s %10s\n", "event", "error (s)", "missed");
+  for (int event = LUNAR_RISE; event <= LUNAR_TRANSIT; event++) {
+    printf("%-26s %12ld %10d\n", names[event], worst[event], missing[event]);
+    if (worst[event] > MAX_LOCAL_ERROR || missing[event] > 0) {
+      failed = 1;
+    }
+  }
+  if (failed) {
+    printf("FAIL: bound is %d s\n", MAX_LOCAL_ERROR);
+  }
+
+  // Cached until the events pass or the location moves
+  lunarEventsInit(&events);
+  lunarEventsUpdate(&events, SWEEP_START, 51 * LUNAR_LOCATION_SCALE, 0);
+  events.evaluations = 0;
+  lunarEventsUpdate(&events, SWEEP_START + 60, 51 * LUNAR_LOCATION_SCALE, 0);
+  unsigned int again = events.evaluations;
+  lunarEventsUpdate(&events, SWEEP_START + 60, 40 * LUNAR_LOCATION_SCALE, 74 * LUNAR_LOCATION_SCALE);
+  unsigned int moved = events.evaluations - again;
+  lunarEventsDeinit(&events);
+  printf("\nnext minute %u calls, new location %u calls\n", again, moved);
+  if (again != 0) {
+    printf("FAIL: events were searched again\n");
+    failed = 1;
+  }
+
+  return failed;
+}
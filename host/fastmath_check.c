@@ -0,0 +1,180 @@
+/*
+ * fastmath_check.c
+ * Accuracy and speed of src/fastmath.c against libm.
+ *
+ * Every function gets the same pseudo-random inputs over the range the
+ * ephemeris feeds it: series arguments up to a few dozen radians, any
+ * direction for the arctangent, twenty decades for the square root and
+ * degrees up to a million for the reductions.  Reports the maximum
+ * error (relative for sqrtx, absolute otherwise) and nanoseconds per
+ * call of both, fastest of a few passes, and fails if an error is over
+ * its bound.
+ *
+ *   fastmath_check [samples]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fastmath.h"
+
+#define PASSES 5
+
+typedef struct {
+  const char *name;
+  double (*fast)(double a, double b);
+  double (*libm)(double a, double b);
+  void (*input)(unsigned int *seed, double *a, double *b);
+  int relative;
+  double bound;
+} MathCase;
+
+static volatile double s_sink;
+
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static double uniform(unsigned int *seed, double lo, double hi) {
+  *seed = *seed * 1103515245u + 12345u;
+  return lo + (hi - lo) * (*seed >> 8) / 16777216.0;
+}
+
+
+static void seriesArgument(unsigned int *seed, double *a, double *b) {
+  *a = uniform(seed, -50.0, 50.0);
+  *b = 0;
+}
+
+static void direction(unsigned int *seed, double *a, double *b) {
+  double scale = pow(10.0, uniform(seed, -3.0, 3.0));
+  *a = scale * uniform(seed, -1.0, 1.0);
+  *b = scale * uniform(seed, -1.0, 1.0);
+}
+
+static void magnitude(unsigned int *seed, double *a, double *b) {
+  *a = pow(10.0, uniform(seed, -5.0, 15.0));
+  *b = 0;
+}
+
+static void degreeArgument(unsigned int *seed, double *a, double *b) {
+  *a = uniform(seed, -1000000.0, 1000000.0);
+  *b = 0;
+}
+
+
+static double fastSin(double a, double b) { return sinx(a); }
+static double libmSin(double a, double b) { return sin(a); }
+static double fastCos(double a, double b) { return cosx(a); }
+static double libmCos(double a, double b) { return cos(a); }
+
+static double fastSinCos(double a, double b) {
+  double s,c;
+  sincosx(a, &s, &c);
+  return s + c;
+}
+
+static double libmSinCos(double a, double b) {
+  return sin(a) + cos(a);
+}
+
+static double fastAtan2(double a, double b) { return atan2x(a, b); }
+static double libmAtan2(double a, double b) { return atan2(a, b); }
+static double fastSqrt(double a, double b) { return sqrtx((float)a); }
+static double libmSqrt(double a, double b) { return sqrtf((float)a); }
+static double fastNormDegrees(double a, double b) { return normDegrees(a); }
+
+static double libmNormDegrees(double a, double b) {
+  double d = fmod(a, 360.0);
+  return d < 0 ? d + 360.0 : d;
+}
+
+static double fastRadians(double a, double b) { return radians(a); }
+
+static double libmRadians(double a, double b) {
+  return libmNormDegrees(a, b) * (M_PI / 180.0);
+}
+
+
+static const MathCase s_cases[] = {
+  { "sinx",        fastSin,         libmSin,         seriesArgument, 0, 1.5e-9 },
+  { "cosx",        fastCos,         libmCos,         seriesArgument, 0, 1.5e-9 },
+  { "sincosx",     fastSinCos,      libmSinCos,      seriesArgument, 0, 3e-9 },
+  { "atan2x",      fastAtan2,       libmAtan2,       direction,      0, 2e-10 },
+  { "sqrtx",       fastSqrt,        libmSqrt,        magnitude,      1, 2.4e-7 },
+  { "normDegrees", fastNormDegrees, libmNormDegrees, degreeArgument, 0, 1e-9 },
+  { "radians",     fastRadians,     libmRadians,     degreeArgument, 0, 1e-11 },
+};
+
+
+static double timeCalls(double (*fn)(double, double), const double *a, const double *b, int n) {
+  double best = 1e30;
+  for (int pass = 0; pass < PASSES; pass++) {
+    double sum = 0.0;
+    double start = now();
+    for (int i = 0; i < n; i++) {
+      sum += fn(a[i], b[i]);
+    }
+    double elapsed = now() - start;
+    s_sink = sum;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+
+int main(int argc, char **argv) {
+  int samples = argc > 1 ? atoi(argv[1]) : 1000000;
+  double *a = malloc(samples * sizeof(double));
+  double *b = malloc(samples * sizeof(double));
+  int failed = 0;
+
+  if (a == NULL || b == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  printf("%d samples, fastest of %d passes\n\n", samples, PASSES);
+  printf("%-12s %12s %12s %10s %10s %8s\n",
+         "function", "max error", "bound", "fast ns", "libm ns", "speedup");
+  for (unsigned int c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); c++) {
+    const MathCase *mc = &s_cases[c];
+    unsigned int seed = 1 + c;
+    double worst = 0.0, at = 0.0;
+
+    for (int i = 0; i < samples; i++) {
+      mc->input(&seed, &a[i], &b[i]);
+      double expected = mc->libm(a[i], b[i]);
+      double error = fabs(mc->fast(a[i], b[i]) - expected);
+      if (mc->relative) {
+        error /= expected;
+      }
+      if (error > worst) {
+        worst = error;
+        at = a[i];
+      }
+    }
+
+    double fast = timeCalls(mc->fast, a, b, samples);
+    double libm = timeCalls(mc->libm, a, b, samples);
+    int bad = worst > mc->bound;
+    printf("%-12s %12.3g %12.3g %10.2f %10.2f %7.2fx%s\n",
+           mc->name, worst, mc->bound, 1e9 * fast / samples, 1e9 * libm / samples,
+           libm / fast, bad ? "  FAIL" : "");
+    if (bad) {
+      printf("             at %.17g\n", at);
+    }
+    failed |= bad;
+  }
+
+  free(a);
+  free(b);
+  return failed;
+}
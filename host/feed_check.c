@@ -0,0 +1,191 @@
+/*
+ * feed_check.c
+ * Packs ephemeris windows the way sendFeed() in pebble-js-app.js does,
+ * feeds them through src/ephemeris_feed.c and compares both ways of
+ * reading them back with the watch's own cache, minute by minute.
+ * Fails if the double path is off by more than MAX_ANGLE_ERROR degrees
+ * or MAX_RANGE_ERROR miles, that is more than the int32 units lose, or
+ * the integer path by more than MAX_FIXED_ERROR angle units or
+ * MAX_FIXED_RANGE_ERROR meters, or its range rate by more than
+ * MAX_FIXED_RANGE_RATE_ERROR meters a day.  Chunks the watch must not take, such
+ * as the zeroed initial value, are checked to be refused.
+ *
+ *   feed_check [days]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephemeris_cache.h"
+#include "ephemeris_feed.h"
+
+#define START 1420070400L          // 2015-01-01 00:00 UTC
+
+#define MAX_ANGLE_ERROR       0.0001
+#define MAX_RANGE_ERROR       0.01
+#define MAX_FIXED_ERROR       2
+#define MAX_FIXED_RANGE_ERROR 10      // eight terms of 1.6 m units
+#define MAX_FIXED_RANGE_RATE_ERROR 500   // a tenth of a mile an hour is 3862
+
+#define METERS_PER_MILE 1609.344
+
+
+static double angleError(double a, double b) {
+  double d = normDegrees(a - b);
+  d = d >= 180.0 ? 360.0 - d : d;
+  return d;
+}
+
+
+// Difference of two angles in EPH_TRIG_MAX_ANGLE units, the short way
+static int32_t fixedError(int32_t a, int32_t b) {
+  int32_t d = (a - b) & (EPH_TRIG_MAX_ANGLE - 1);
+  return d > EPH_TRIG_MAX_ANGLE / 2 ? EPH_TRIG_MAX_ANGLE - d : d;
+}
+
+
+static void worst(double *w, double e) {
+  if (e < 0) {
+    e = -e;
+  }
+  if (e > *w) {
+    *w = e;
+  }
+}
+
+
+static uint8_t *putInt32(uint8_t *p, int32_t value) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint32_t)value >> (8 * i);
+  }
+  return p + 4;
+}
+
+
+// One chunk as sendFeed() builds it, from the watch's own fit
+static void packWindow(EphemerisCache *fit, time_t start, int index, uint8_t *chunk) {
+  static const double units[EPH_CACHE_QUANTITIES] = {
+    [EPH_CACHE_LONGITUDE] = EPH_FEED_ANGLE_UNITS,
+    [EPH_CACHE_RANGE] = EPH_FEED_RANGE_UNITS,
+    [EPH_CACHE_MOON_RA] = EPH_FEED_ANGLE_UNITS,
+    [EPH_CACHE_SUN_RA] = EPH_FEED_ANGLE_UNITS,
+  };
+  CachedEphemeris unused;
+
+  ephemerisCacheGet(fit, start, &unused);
+  chunk[0] = EPH_FEED_VERSION;
+  chunk[1] = index;
+  chunk[2] = EPH_FEED_WINDOWS;
+  chunk[3] = 0;
+  uint8_t *p = putInt32(chunk + 4, (int32_t)start);
+  for (int q = 0; q < EPH_CACHE_QUANTITIES; q++) {
+    for (int j = 0; j < EPH_CACHE_TERMS; j++) {
+      p = putInt32(p, (int32_t)lround(fit->coefficients[q][j] * units[q]));
+    }
+  }
+}
+
+
+static int checkRefused(EphemerisFeed *feed) {
+  uint8_t chunk[EPH_FEED_CHUNK_SIZE] = {0};
+  int failures = 0;
+
+  failures += ephemerisFeedReceive(feed, chunk, sizeof(chunk));
+  chunk[0] = EPH_FEED_VERSION;
+  failures += ephemerisFeedReceive(feed, chunk, sizeof(chunk) - 1);
+  chunk[1] = EPH_FEED_WINDOWS;
+  failures += ephemerisFeedReceive(feed, chunk, sizeof(chunk));
+  if (failures > 0 || feed->chunks != 0 || ephemerisFeedEnd(feed) != 0) {
+    printf("FAIL: took a chunk it should have refused\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+int main(int argc, char **argv) {
+  int days = argc > 1 ? atoi(argv[1]) : 30;
+  EphemerisFeed feed;
+  EphemerisCache fit, loaded, direct;
+  CachedEphemeris fromFeed, fromCache;
+  FeedEphemerisFixed fixed;
+  double lon = 0, range = 0, mra = 0, sra = 0;
+  double fixedRange = 0, fixedRangeRate = 0;
+  int32_t fixedMoonRA = 0, fixedSunRA = 0;
+  uint8_t chunk[EPH_FEED_CHUNK_SIZE];
+  int ticks = 0;
+  int failures = 0;
+
+  ephemerisFeedInit(&feed);
+  failures += checkRefused(&feed);
+
+  ephemerisCacheInit(&fit);
+  ephemerisCacheInit(&loaded);
+  ephemerisCacheInit(&direct);
+  for (time_t day = START; day < START + days * 86400L; day += 86400) {
+    for (int i = 0; i < EPH_FEED_WINDOWS; i++) {
+      packWindow(&fit, day + i * EPH_CACHE_WINDOW, i, chunk);
+      if (!ephemerisFeedReceive(&feed, chunk, sizeof(chunk))) {
+        printf("FAIL: refused window %d of %ld\n", i, (long)day);
+        return 1;
+      }
+    }
+    if (ephemerisFeedEnd(&feed) != day + 86400) {
+      printf("FAIL: feed ends at %ld, not %ld\n", (long)ephemerisFeedEnd(&feed), (long)day + 86400);
+      failures++;
+    }
+
+    for (time_t t = day; t < day + 86400; t += 60) {
+      if (!ephemerisCacheCovers(&loaded, t) && !ephemerisFeedLoad(&feed, t, &loaded)) {
+        printf("FAIL: no window covers %ld\n", (long)t);
+        return 1;
+      }
+      ephemerisCacheGet(&loaded, t, &fromFeed);
+      ephemerisCacheGet(&direct, t, &fromCache);
+      worst(&lon, angleError(fromFeed.longitude, fromCache.longitude));
+      worst(&range, fromFeed.range - fromCache.range);
+      worst(&mra, angleError(fromFeed.moonRA, fromCache.moonRA));
+      worst(&sra, angleError(fromFeed.sunRA, fromCache.sunRA));
+
+      ephemerisFeedGetFixed(&feed, t, &fixed);
+      int32_t e = fixedError(fixed.moonRA, (int32_t)lround(fromCache.moonRA * EPH_TRIG_MAX_ANGLE / 360.0));
+      fixedMoonRA = e > fixedMoonRA ? e : fixedMoonRA;
+      e = fixedError(fixed.sunRA, (int32_t)lround(fromCache.sunRA * EPH_TRIG_MAX_ANGLE / 360.0));
+      fixedSunRA = e > fixedSunRA ? e : fixedSunRA;
+      worst(&fixedRange, fixed.range - fromCache.range * METERS_PER_MILE);
+      worst(&fixedRangeRate, fixed.rangeRate - fromCache.rangeRate * METERS_PER_MILE);
+      ticks++;
+    }
+  }
+  if (ephemerisFeedGetFixed(&feed, START + days * 86400L, &fixed) ||
+      ephemerisFeedLoad(&feed, START - 1, &loaded)) {
+    printf("FAIL: a window answered outside the feed\n");
+    failures++;
+  }
+
+  printf("%d ticks over %d days, %u chunks, %u refits\n\n",
+         ticks, days, feed.chunks, direct.fits);
+  printf("longitude   %.7f deg\n", lon);
+  printf("range       %.5f mi\n", range);
+  printf("moon RA     %.7f deg\n", mra);
+  printf("sun RA      %.7f deg\n", sra);
+  printf("fixed moon RA  %d\n", (int)fixedMoonRA);
+  printf("fixed sun RA   %d\n", (int)fixedSunRA);
+  printf("fixed range    %.1f m\n", fixedRange);
+  printf("fixed range rate  %.1f m/d\n", fixedRangeRate);
+
+  if (lon > MAX_ANGLE_ERROR || mra > MAX_ANGLE_ERROR || sra > MAX_ANGLE_ERROR
+      || range > MAX_RANGE_ERROR) {
+    printf("FAIL: bound is %.4f deg / %.2f mi\n", MAX_ANGLE_ERROR, MAX_RANGE_ERROR);
+    failures++;
+  }
+  if (fixedMoonRA > MAX_FIXED_ERROR || fixedSunRA > MAX_FIXED_ERROR
+      || fixedRange > MAX_FIXED_RANGE_ERROR || fixedRangeRate > MAX_FIXED_RANGE_RATE_ERROR) {
+    printf("FAIL: fixed bound is %d / %d m / %d m a day\n",
+           MAX_FIXED_ERROR, MAX_FIXED_RANGE_ERROR, MAX_FIXED_RANGE_RATE_ERROR);
+    failures++;
+  }
+  return failures > 0;
+}
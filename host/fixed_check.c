@@ -0,0 +1,125 @@
+/*
+ * fixed_check.c
+ * Compares the fixed point ephemeris (src/ephemeris_fixed.c) with the
+ * double one (src/ephemeris.c) over a sweep of timestamps and fails
+ * if any angle differs by more than EPH_FIXED_MAX_ERROR_ARCMIN, or the
+ * range by more than EPH_FIXED_MAX_ERROR_KM.  The longitude rate is
+ * held to EPH_FIXED_MAX_ERROR_ARCMIN a day and the range rate to
+ * EPH_FIXED_MAX_ERROR_KM a day.
+ *
+ *   fixed_check [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephemeris_fixed.h"
+
+#define SWEEP_START 631152000L    // 1990-01-01 00:00 UTC
+#define SWEEP_END   2208988800L   // 2040-01-01 00:00 UTC
+
+typedef struct {
+  const char *name;
+  double worst;
+  time_t when;
+} Check;
+
+enum {
+  CHECK_LONGITUDE,
+  CHECK_LATITUDE,
+  CHECK_MOON_RA,
+  CHECK_SUN_RA,
+  CHECK_SIDEREAL,
+  CHECK_HOUR_ANGLE,
+  CHECK_LONGITUDE_RATE,
+  CHECK_ANGLES,
+  CHECK_RANGE = CHECK_ANGLES,
+  CHECK_RANGE_RATE,
+  CHECK_COUNT
+};
+
+static Check s_checks[CHECK_COUNT] = {
+  { "longitude (arcmin)" },
+  { "latitude (arcmin)" },
+  { "moon RA (arcmin)" },
+  { "sun RA (arcmin)" },
+  { "sidereal time (arcmin)" },
+  { "moon hour angle (arcmin)" },
+  { "longitude rate (arcmin/d)" },
+  { "range (km)" },
+  { "range rate (km/d)" },
+};
+
+
+static double fixedDegrees(int32_t angle) {
+  return 360.0 * angle / EPH_TRIG_MAX_ANGLE;
+}
+
+
+// Difference of two angles in degrees, wrapped into [-180, 180).
+static double angleError(double a, double b) {
+  double d = normDegrees(a - b);
+  return d >= 180.0 ? d - 360.0 : d;
+}
+
+
+static void record(int check, double error, time_t when) {
+  if (error < 0) {
+    error = -error;
+  }
+  if (error > s_checks[check].worst) {
+    s_checks[check].worst = error;
+    s_checks[check].when = when;
+  }
+}
+
+
+int main(int argc, char **argv) {
+  int samples = argc > 1 ? atoi(argv[1]) : 100000;
+  unsigned int seed = 12345;
+  int failed = 0;
+
+  for (int i = 0; i < samples; i++) {
+    seed = seed * 1103515245u + 12345u;
+    time_t when = SWEEP_START + (time_t)((double)(SWEEP_END - SWEEP_START) * i / samples)
+                  + (seed >> 16) % 86400;
+    struct tm t;
+    gmtime_r(&when, &t);
+    double JD = DateToJD(&t);
+    double T = JDtoT(&JD);
+
+    MoonPosition moon;
+    MoonPositionFixed moonFixed;
+    moonPosition(T, &moon);
+    moonPositionFixed(when, &moonFixed);
+
+    double gst = greenwichSiderealTime(T, &t);
+    double ra = moonRA(moon.longitude);
+    int32_t gstFixed = greenwichSiderealTimeFixed(when);
+    int32_t raFixed = moonRAFixed(moonFixed.longitude);
+
+    record(CHECK_LONGITUDE, 60.0 * angleError(fixedDegrees(moonFixed.longitude), moon.longitude), when);
+    record(CHECK_LATITUDE, 60.0 * (fixedDegrees(moonFixed.latitude) - moon.latitude), when);
+    record(CHECK_MOON_RA, 60.0 * angleError(fixedDegrees(raFixed), ra), when);
+    record(CHECK_SUN_RA, 60.0 * angleError(fixedDegrees(sunRAFixed(when)), sunRA(T)), when);
+    record(CHECK_SIDEREAL, 60.0 * angleError(fixedDegrees(gstFixed), gst), when);
+    record(CHECK_HOUR_ANGLE, 60.0 * angleError(fixedDegrees(gstFixed - raFixed), gst - ra), when);
+    record(CHECK_LONGITUDE_RATE, 60.0 * (fixedDegrees(moonFixed.longitudeRate) - moon.longitudeRate), when);
+    record(CHECK_RANGE, moonFixed.range / 1000.0 - moon.range / 0.62137119, when);
+    record(CHECK_RANGE_RATE, moonFixed.rangeRate / 1000.0 - moon.rangeRate / 0.62137119, when);
+  }
+
+  printf("%d timestamps, 1990-2040, bound %d arcmin / %d km\n\n",
+         samples, EPH_FIXED_MAX_ERROR_ARCMIN, EPH_FIXED_MAX_ERROR_KM);
+  printf("%-26s %10s   %s\n", "quantity", "max error", "at");
+  for (int i = 0; i < CHECK_COUNT; i++) {
+    double bound = i < CHECK_ANGLES ? EPH_FIXED_MAX_ERROR_ARCMIN : (double)EPH_FIXED_MAX_ERROR_KM;
+    int bad = s_checks[i].worst > bound;
+    char when[32];
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&s_checks[i].when));
+    printf("%-26s %10.4f   %s%s\n", s_checks[i].name, s_checks[i].worst, when, bad ? "  FAIL" : "");
+    failed |= bad;
+  }
+  return failed;
+}
@@ -0,0 +1,85 @@
+/*
+ * format_check.c
+ * Compares the integer formatters (src/format.c) with snprintf() over
+ * the values the face shows and the edges of int32_t, including that
+ * each returns the end of what it wrote.
+ *
+ *   format_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "format.h"
+
+
+static int s_failures;
+
+static void expect(const char *what, long value, const char *got, const char *end,
+                   const char *want) {
+  if (strcmp(got, want) != 0 || end != got + strlen(want)) {
+    if (s_failures < 10) {
+      printf("%s(%ld): \"%s\", expected \"%s\"\n", what, value, got, want);
+    }
+    s_failures++;
+  }
+}
+
+
+static void checkInt(int32_t value) {
+  char got[16], want[16];
+  char *end = formatInt(got, value);
+  snprintf(want, sizeof(want), "%ld", (long)value);
+  expect("formatInt", value, got, end, want);
+}
+
+
+static void checkTenths(int32_t tenths) {
+  char got[16], want[16];
+  char *end = formatTenths(got, tenths);
+  long magnitude = labs((long)tenths);
+  snprintf(want, sizeof(want), "%s%ld.%ld", tenths < 0 ? "-" : "", magnitude / 10, magnitude % 10);
+  expect("formatTenths", tenths, got, end, want);
+}
+
+
+static void checkClock(int32_t minutes) {
+  char got[8], want[8];
+  char *end = formatClock(got, minutes);
+  long wrapped = ((minutes % 1440) + 1440) % 1440;
+  snprintf(want, sizeof(want), "%02ld:%02ld", wrapped / 60, wrapped % 60);
+  expect("formatClock", minutes, got, end, want);
+}
+
+
+int main(void) {
+  static const int32_t edges[] = {INT32_MIN, INT32_MIN + 1, -1000000, -10, -9, -1, 0, 1, 9, 10,
+                                  99, 100, 1000000, INT32_MAX - 1, INT32_MAX};
+  char text[32];
+  int checked = 0;
+
+  for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+    checkInt(edges[i]);
+    checkTenths(edges[i]);
+    checkClock(edges[i]);
+    checked += 3;
+  }
+  // Ranges in miles, speeds and rates in tenths of a mph, clock minutes
+  for (int32_t v = -300000; v <= 300000; v++) {
+    checkInt(v);
+    checkTenths(v);
+    checked += 2;
+  }
+  for (int32_t m = -3000; m <= 3000; m++) {
+    checkClock(m);
+    checked++;
+  }
+
+  char *end = formatText(formatInt(text, 252345), " mi\n");
+  formatText(formatTenths(end, -1234), " mph");
+  expect("chained", 0, text, text + strlen(text), "252345 mi\n-123.4 mph");
+  checked++;
+
+  printf("%d values, %d wrong\n", checked, s_failures);
+  return s_failures > 0;
+}
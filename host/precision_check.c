@@ -0,0 +1,241 @@
+/*
+ * precision_check.c
+ * What each precision tier of the lunar series (see lunar_terms.h)
+ * costs on screen.  Sweeps 1900-2100 and, for the double and fixed
+ * point ephemeris, compares every tier with the full series: the worst
+ * longitude, latitude and range errors, how far the moon marker on the
+ * 56 px orbit moved, and how often the marker, the moon time or the
+ * range text came out different.  The face shows whole minutes and
+ * miles and draws whole pixels, so small errors only show where a value
+ * sits on a boundary.  Every EVENT_STRIDE samples each tier also
+ * searches for moonrise and moonset at a location drawn from the same
+ * sweep, and the Rise and Set text is compared; it depends on the
+ * latitude, which the screen tier truncates.
+ *
+ * A tier counts as pixel-identical when no sample moved the marker or
+ * changed the moon time, range or Rise and Set text.  Fails if the tier
+ * built in (LUNAR_PRECISION) is not.
+ *
+ *   precision_check [samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephemeris_fixed.h"
+#include "lunar_events.h"
+#include "lunar_terms.h"
+
+#define SWEEP_START (-2208988800L)   // 1900-01-01 00:00 UTC
+#define SWEEP_END   4102444800L      // 2100-01-01 00:00 UTC
+
+#define ORBIT_RADIUS 56
+
+// Samples per search for the events, each a few dozen series
+#define EVENT_STRIDE 50
+
+enum { BACKEND_DOUBLE, BACKEND_FIXED, BACKENDS };
+
+static const char *s_backend_names[BACKENDS] = { "double", "fixed" };
+
+// What the face shows for one instant
+typedef struct {
+  double longitude;       // degrees
+  double latitude;        // degrees
+  double range;           // km
+  int x, y;               // moon marker, pixels from the centre
+  int minutes;            // moon time text
+  int miles;              // range text
+} Screen;
+
+typedef struct {
+  double longitude, latitude, range;   // worst errors: arcsec, arcsec, km
+  int pixels;                          // worst marker move
+  long moved, timeText, rangeText;     // samples that differ
+  long eventText;                      // searches whose Rise or Set differ
+  double seconds;                      // time spent in the series
+} TierReport;
+
+static TierReport s_reports[BACKENDS][LUNAR_PRECISIONS];
+
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static double angleError(double a, double b) {
+  double d = normDegrees(a - b);
+  d = d >= 180.0 ? 360.0 - d : d;
+  return d;
+}
+
+
+static void marker(Screen *s, double hourAngle) {
+  float moonX = (float)sinx(radians(hourAngle));
+  float moonY = (float)cosx(radians(hourAngle));
+  s->x = (int)(1.0 * moonX * ORBIT_RADIUS);
+  s->y = (int)(-1.0 * moonY * ORBIT_RADIUS);
+  s->minutes = (int)(hourAngle * 4.0);
+}
+
+
+// As luna.c draws it with the double ephemeris, at longitude 0
+static double screenDouble(Screen *s, time_t when) {
+  struct tm t;
+  gmtime_r(&when, &t);
+  double JD = DateToJD(&t);
+  double T = JDtoT(&JD);
+  MoonPosition moon;
+
+  double start = now();
+  moonPosition(T, &moon);
+  double elapsed = now() - start;
+
+  s->longitude = moon.longitude;
+  s->latitude = moon.latitude;
+  s->range = moon.range / 0.62137119;
+  s->miles = (int)moon.range;
+  marker(s, normDegrees(greenwichSiderealTime(T, &t) - moonRA(moon.longitude)));
+  return elapsed;
+}
+
+
+// As luna.c draws it with the fixed point ephemeris, at longitude 0
+static double screenFixed(Screen *s, time_t when) {
+  MoonPositionFixed moon;
+
+  double start = now();
+  moonPositionFixed(when, &moon);
+  double elapsed = now() - start;
+
+  int32_t angle = (greenwichSiderealTimeFixed(when) - moonRAFixed(moon.longitude))
+                  & (EPH_TRIG_MAX_ANGLE - 1);
+  s->longitude = 360.0 * moon.longitude / EPH_TRIG_MAX_ANGLE;
+  s->latitude = 360.0 * moon.latitude / EPH_TRIG_MAX_ANGLE;
+  s->range = moon.range / 1000.0;
+  s->miles = (int)(moon.range * 0.00062137119);
+  s->x = (int)((float)sinLookup(angle) / EPH_TRIG_MAX_RATIO * ORBIT_RADIUS);
+  s->y = (int)(-(float)cosLookup(angle) / EPH_TRIG_MAX_RATIO * ORBIT_RADIUS);
+  s->minutes = (int)(360.0 * angle / EPH_TRIG_MAX_ANGLE * 4.0);
+  return elapsed;
+}
+
+
+static void worst(double *w, double e) {
+  if (e < 0) {
+    e = -e;
+  }
+  if (e > *w) {
+    *w = e;
+  }
+}
+
+
+static void compare(TierReport *r, const Screen *full, const Screen *tier) {
+  int dx = abs(tier->x - full->x);
+  int dy = abs(tier->y - full->y);
+  int pixels = dx > dy ? dx : dy;
+
+  worst(&r->longitude, 3600.0 * angleError(tier->longitude, full->longitude));
+  worst(&r->latitude, 3600.0 * (tier->latitude - full->latitude));
+  worst(&r->range, tier->range - full->range);
+  if (pixels > r->pixels) {
+    r->pixels = pixels;
+  }
+  r->moved += pixels != 0;
+  r->timeText += tier->minutes != full->minutes;
+  r->rangeText += tier->miles != full->miles;
+}
+
+
+// The Rise and Set text, in minutes since the epoch or -1 for none.
+// Local time is a whole number of minutes from UTC, so the minutes
+// differ exactly when the text does.
+static void riseSet(time_t when, int32_t latitude, int32_t longitude, long *minutes) {
+  LunarEvents events;
+
+  lunarEventsInit(&events);
+  lunarEventsUpdate(&events, when, latitude, longitude);
+  for (int event = LUNAR_RISE; event <= LUNAR_SET; event++) {
+    minutes[event] = events.when[event] ? (long)(events.when[event] / 60) : -1;
+  }
+  lunarEventsDeinit(&events);
+}
+
+
+static void compareEvents(time_t when, unsigned int seed) {
+  int32_t latitude = (int32_t)((seed >> 8) % (121 * LUNAR_LOCATION_SCALE)) - 60 * LUNAR_LOCATION_SCALE;
+  int32_t longitude = (int32_t)((seed >> 4) % (360 * LUNAR_LOCATION_SCALE));
+  long full[2], tier[2];
+
+  for (int p = 0; p < LUNAR_PRECISIONS; p++) {
+    lunarPrecision = (LunarPrecision)p;
+    riseSet(when, latitude, longitude, p == LUNAR_PRECISION_FULL ? full : tier);
+    if (p != LUNAR_PRECISION_FULL && (tier[LUNAR_RISE] != full[LUNAR_RISE] ||
+                                      tier[LUNAR_SET] != full[LUNAR_SET])) {
+      // Both builds run the one search, in double
+      for (int backend = 0; backend < BACKENDS; backend++) {
+        s_reports[backend][p].eventText++;
+      }
+    }
+  }
+}
+
+
+int main(int argc, char **argv) {
+  long samples = argc > 1 ? atol(argv[1]) : 200000;
+  unsigned int seed = 2718;
+  int failed = 0;
+
+  for (long i = 0; i < samples; i++) {
+    seed = seed * 1103515245u + 12345u;
+    time_t when = SWEEP_START + (time_t)((double)(SWEEP_END - SWEEP_START) * i / samples)
+                  + (seed >> 16) % 86400;
+
+    for (int backend = 0; backend < BACKENDS; backend++) {
+      Screen full, tier;
+      for (int p = 0; p < LUNAR_PRECISIONS; p++) {
+        lunarPrecision = (LunarPrecision)p;
+        Screen *s = p == LUNAR_PRECISION_FULL ? &full : &tier;
+        double elapsed = backend == BACKEND_DOUBLE ? screenDouble(s, when) : screenFixed(s, when);
+        s_reports[backend][p].seconds += elapsed;
+        compare(&s_reports[backend][p], &full, s);
+      }
+    }
+    if (i % EVENT_STRIDE == 0) {
+      compareEvents(when, seed);
+    }
+  }
+  lunarPrecision = LUNAR_PRECISION;
+
+  printf("%ld timestamps, 1900-2100, each tier against the full series\n", samples);
+  for (int backend = 0; backend < BACKENDS; backend++) {
+    printf("\n%-6s %-7s %5s  %9s %9s %8s %6s %8s %8s %8s %8s %8s\n",
+           s_backend_names[backend], "tier", "trig", "lon (\")", "lat (\")", "range km",
+           "px", "moved %", "time %", "miles %", "events %", "ns/call");
+    for (int p = 0; p < LUNAR_PRECISIONS; p++) {
+      const TierReport *r = &s_reports[backend][p];
+      const LunarTier *tier = &lunarTiers[p];
+      int identical = r->moved == 0 && r->timeText == 0 && r->rangeText == 0 && r->eventText == 0;
+      // sine or cosine evaluations per call
+      int trig = (lunarTierComplete(tier) ? lunarLongitudeRangeSeries.count
+                                          : tier->longitude + tier->range) + tier->latitude;
+      printf("%-6s %-7s %5d  %9.2f %9.2f %8.3f %6d %8.4f %8.4f %8.4f %8.4f %8.1f%s\n",
+             "", tier->name, trig,
+             r->longitude, r->latitude, r->range, r->pixels,
+             100.0 * r->moved / samples, 100.0 * r->timeText / samples,
+             100.0 * r->rangeText / samples, 100.0 * r->eventText / (samples / EVENT_STRIDE),
+             1e9 * r->seconds / samples,
+             identical ? "  identical" : "");
+      if (p == LUNAR_PRECISION && !identical) {
+        printf("       built-in tier is not pixel-identical  FAIL\n");
+        failed = 1;
+      }
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,112 @@
+/*
+ * propagator_check.c
+ * The stepped moon position of src/ephemeris_propagator.c against
+ * moonPosition() at the same instants, and what each costs.
+ *
+ * Runs start at instants spread over 1900-2100 and take a few anchor
+ * intervals of steps each, for the step sizes below: a minute tick, the
+ * event scans' hour and the phase scans' twelve hours.  Reports the
+ * worst longitude, latitude, range and range rate difference per step
+ * size and the time per step next to the time per moonPosition() call,
+ * and fails if a difference is over its bound.
+ *
+ *   propagator_check [runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "ephemeris_propagator.h"
+
+#define SWEEP_START (-2208988800L)   // 1900-01-01 00:00 UTC
+#define SWEEP_END   4102444800L      // 2100-01-01 00:00 UTC
+#define J2000_UNIX  946728000.0
+
+#define STEPS (3 * EPH_PROPAGATOR_ANCHOR)
+
+// Bounds on the worst difference, arcseconds and miles, those of
+// reference_check.  The rotations carry the kernel error of sincosx()
+// from step to step, so the difference grows with the steps taken.
+#define MAX_ANGLE_ERROR 0.01
+#define MAX_RANGE_ERROR 0.001
+#define MAX_RANGE_RATE_ERROR 0.01     // miles a day
+
+static const int32_t s_steps[] = { 60, 60 * 60, 12 * 60 * 60 };
+
+static volatile double s_sink;
+
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static double angleError(double a, double b) {
+  double d = normDegrees(a - b);
+  d = d >= 180.0 ? 360.0 - d : d;
+  return d;
+}
+
+
+static void worst(double *w, double e) {
+  if (e < 0) {
+    e = -e;
+  }
+  if (e > *w) {
+    *w = e;
+  }
+}
+
+
+int main(int argc, char **argv) {
+  int runs = argc > 1 ? atoi(argv[1]) : 2000;
+  static MoonPropagator propagator;
+  int failed = 0;
+
+  printf("%d runs of %d steps, 1900-2100, against moonPosition()\n\n", runs, STEPS);
+  printf("%-8s %10s %10s %10s %10s %12s %12s\n",
+         "step", "lon (\")", "lat (\")", "range mi", "rate mi/d", "ns/step", "ns/position");
+  for (unsigned int k = 0; k < sizeof(s_steps) / sizeof(s_steps[0]); k++) {
+    int32_t step = s_steps[k];
+    double longitude = 0, latitude = 0, range = 0, rangeRate = 0;
+    double stepping = 0, exact = 0;
+
+    for (int run = 0; run < runs; run++) {
+      time_t start = SWEEP_START + (time_t)((double)(SWEEP_END - SWEEP_START) * run / runs);
+      MoonPosition stepped[STEPS], full[STEPS];
+      double begin;
+
+      begin = now();
+      moonPropagatorStart(&propagator, start, step);
+      for (int i = 0; i < STEPS; i++) {
+        moonPropagatorStep(&propagator);
+        moonPropagatorPosition(&propagator, &stepped[i]);
+      }
+      stepping += now() - begin;
+
+      begin = now();
+      for (int i = 0; i < STEPS; i++) {
+        moonPosition((start + (double)step * (i + 1) - J2000_UNIX) / 86400.0 / 36525.0, &full[i]);
+      }
+      exact += now() - begin;
+
+      for (int i = 0; i < STEPS; i++) {
+        worst(&longitude, 3600.0 * angleError(stepped[i].longitude, full[i].longitude));
+        worst(&latitude, 3600.0 * (stepped[i].latitude - full[i].latitude));
+        worst(&range, stepped[i].range - full[i].range);
+        worst(&rangeRate, stepped[i].rangeRate - full[i].rangeRate);
+        s_sink += stepped[i].range + full[i].range;
+      }
+    }
+
+    int bad = longitude > MAX_ANGLE_ERROR || latitude > MAX_ANGLE_ERROR || range > MAX_RANGE_ERROR
+              || rangeRate > MAX_RANGE_RATE_ERROR;
+    printf("%-8d %10.6f %10.6f %10.6f %10.6f %12.1f %12.1f%s\n", step, longitude, latitude, range, rangeRate,
+           1e9 * stepping / runs / STEPS, 1e9 * exact / runs / STEPS, bad ? "  FAIL" : "");
+    failed |= bad;
+  }
+  return failed;
+}
@@ -0,0 +1,113 @@
+/*
+ * reference.c
+ * Long double ephemeris, see reference.h.
+ */
+
+#include <math.h>
+#include "reference.h"
+#include "ephemeris.h"
+#include "lunar_terms.h"
+
+#define PI_L 3.141592653589793238462643383279503L
+
+static long double rad(long double d) {
+  return d * (PI_L / 180.0L);
+}
+
+
+static long double deg(long double r) {
+  return r * (180.0L / PI_L);
+}
+
+
+long double referenceNormDegrees(long double d) {
+  d = fmodl(d, 360.0L);
+  return d < 0 ? d + 360.0L : d;
+}
+
+
+// Sum of a whole table, every term scaled by its power of E
+static long double sumSeries(const LunarSeries *series, const long double *Epow,
+                             long double D, long double M, long double Mm, long double F,
+                             int cosine) {
+  long double sum = 0.0L;
+  for (int term = 0; term < series->count; term++) {
+    long double arg = series->D[term] * D + series->M[term] * M
+                    + series->Mm[term] * Mm + series->F[term] * F;
+    long double coefficient = cosine ? series->cosine[term] : series->sine[term];
+    sum += coefficient * Epow[series->E[term]] * (cosine ? cosl(arg) : sinl(arg));
+  }
+  return sum;
+}
+
+
+// Meeus - Astronomical Algorithms - chapter 47
+void referenceMoon(long double T, ReferenceMoon *moon) {
+  long double T2 = T * T, T3 = T2 * T, T4 = T3 * T;
+
+  // formulae 47.1 to 47.6
+  long double L  = 218.3164477L + 481267.88123421L * T - 0.0015786L * T2
+                 + T3 / 538841.0L - T4 / 65194000.0L;
+  long double D  = 297.8501921L + 445267.1114034L * T - 0.0018819L * T2
+                 + T3 / 545868.0L - T4 / 113065000.0L;
+  long double M  = 357.5291092L + 35999.0502909L * T - 0.0001536L * T2
+                 + T3 / 24490000.0L;
+  long double Mm = 134.9633964L + 477198.8675055L * T + 0.0087414L * T2
+                 + T3 / 69699.0L - T4 / 14712000.0L;
+  long double F  = 93.2720950L + 483202.0175233L * T - 0.0036539L * T2
+                 - T3 / 3526000.0L + T4 / 863310000.0L;
+  long double E  = 1.0L - 0.002516L * T - 0.0000074L * T2;
+  long double Epow[3] = { 1.0L, E, E * E };
+  long double A1 = rad(referenceNormDegrees(119.75L + 131.849L * T));
+  long double A2 = rad(referenceNormDegrees(53.09L + 479264.290L * T));
+  long double A3 = rad(referenceNormDegrees(313.45L + 481266.484L * T));
+
+  long double Lr = rad(referenceNormDegrees(L));
+  long double Dr = rad(referenceNormDegrees(D));
+  long double Mr = rad(referenceNormDegrees(M));
+  long double Mmr = rad(referenceNormDegrees(Mm));
+  long double Fr = rad(referenceNormDegrees(F));
+
+  long double sigmaL = sumSeries(&lunarLongitudeSeries, Epow, Dr, Mr, Mmr, Fr, 0);
+  long double sigmaR = sumSeries(&lunarRangeSeries, Epow, Dr, Mr, Mmr, Fr, 1);
+  long double sigmaB = sumSeries(&lunarLatitudeSeries, Epow, Dr, Mr, Mmr, Fr, 0);
+
+  sigmaL += 3958.0L * sinl(A1) + 1962.0L * sinl(Lr - Fr) + 318.0L * sinl(A2);
+  sigmaB += -2235.0L * sinl(Lr) + 382.0L * sinl(A3) + 175.0L * sinl(A1 - Fr)
+          + 175.0L * sinl(A1 + Fr) + 127.0L * sinl(Lr - Mmr) - 115.0L * sinl(Lr + Mmr);
+
+  moon->longitude = referenceNormDegrees(L + sigmaL / 1000000.0L);
+  moon->latitude = sigmaB / 1000000.0L;
+  moon->range = 385000.56L + sigmaR / 1000.0L;
+}
+
+
+long double referenceEclipticRA(long double L) {
+  long double e = rad(obliquityE);
+  return referenceNormDegrees(deg(atan2l(sinl(rad(L)) * cosl(e), cosl(rad(L)))));
+}
+
+
+// Meeus - Astronomical Algorithms - formulae 25.2 to 25.4
+long double referenceSunLongitude(long double T) {
+  long double L0 = 280.46646L + 36000.76983L * T + 0.0003032L * T * T;
+  long double M = rad(referenceNormDegrees(357.5291092L + 35999.0502909L * T
+                                           - 0.0001536L * T * T + T * T * T / 24490000.0L));
+  long double C = (1.914602L - 0.004817L * T - 0.000014L * T * T) * sinl(M)
+                + (0.019993L - 0.000101L * T) * sinl(2.0L * M)
+                + 0.000289L * sinl(3.0L * M);
+  return referenceNormDegrees(L0 + C);
+}
+
+
+long double referenceSunRA(long double T) {
+  return referenceEclipticRA(referenceSunLongitude(T));
+}
+
+
+// Meeus - Astronomical Algorithms - formula 12.4
+long double referenceSiderealTime(long double JD) {
+  long double T = (JD - 2451545.0L) / 36525.0L;
+  return referenceNormDegrees(280.46061837L + 360.98564736629L * (JD - 2451545.0L)
+                              + 0.000387933L * T * T - T * T * T / 38710000.0L);
+}
@@ -0,0 +1,57 @@
+#pragma once
+/*
+ * reference.h
+ * High precision reference for the ephemeris, for host checks only.
+ *
+ * The same Meeus series as src/ephemeris.c, every term of tables 47.A
+ * and 47.B, evaluated in long double with libm.  Nothing is truncated,
+ * looked up or approximated, so a difference from the watch routines
+ * is the error of their fast paths.  referencePositions[] holds
+ * published values that the reference itself is checked against.
+ */
+
+// Geocentric position of the moon, Meeus - Astronomical Algorithms -
+// chapter 47.
+typedef struct {
+  long double longitude;   // degrees, [0, 360)
+  long double latitude;    // degrees
+  long double range;       // km, center to center
+} ReferenceMoon;
+
+void referenceMoon(long double T, ReferenceMoon *moon);
+
+// Right ascension of ecliptic longitude L, ignoring latitude, with the
+// obliquity of ephemeris.h, as moonRA() does it.  Degrees.
+long double referenceEclipticRA(long double L);
+
+// The sun's true geometric longitude, Meeus chapter 25, and its right
+// ascension as sunRA() works it out.  Degrees.
+long double referenceSunLongitude(long double T);
+long double referenceSunRA(long double T);
+
+// Greenwich mean sidereal time at Julian day JD (UT), Meeus formula
+// 12.4.  Degrees.
+long double referenceSiderealTime(long double JD);
+
+long double referenceNormDegrees(long double d);
+
+// A published value.  T is Julian centuries from J2000.0 of the
+// instant, and what says which quantity value is.
+typedef enum {
+  REFERENCE_MOON_LONGITUDE,
+  REFERENCE_MOON_LATITUDE,
+  REFERENCE_MOON_RANGE,
+  REFERENCE_SUN_LONGITUDE,
+  REFERENCE_SIDEREAL_TIME,
+} ReferenceQuantity;
+
+typedef struct {
+  const char *source;
+  long double JD;
+  ReferenceQuantity what;
+  long double value;       // degrees or km
+  long double tolerance;   // last published digit
+} ReferencePosition;
+
+extern const ReferencePosition referencePositions[];
+extern const int referencePositionCount;
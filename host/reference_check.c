@@ -0,0 +1,297 @@
+/*
+ * reference_check.c
+ * Differential check of the ephemeris against the long double
+ * reference (reference.c), and a throughput benchmark of both.
+ *
+ * First the reference is held to the published positions in
+ * reference_positions.c.  Then random timestamps from 1900 to 2100 are
+ * split over all cores, and each thread runs its blocks through
+ * sigmaMoonLongitude(), sigmaMoonRange(), moonRA(), sunRA() and
+ * greenwichSiderealTime() and through the reference, timing both.
+ * moonRA() is given the reference longitude, so only its own error
+ * counts.  The reference works out longitude and range together, so
+ * both rows show the time of that one call.
+ *
+ * Reports the maximum and RMS error of each function and fails if a
+ * maximum is over its bound below.  sunRA() works from a shorter solar
+ * longitude than the reference, good to about half a minute of arc.
+ *
+ *   reference_check [samples [threads]]
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "ephemeris.h"
+#include "lunar_terms.h"
+#include "reference.h"
+
+#define SWEEP_START (-2208988800L)   // 1900-01-01 00:00 UTC
+#define SWEEP_END   4102444800L      // 2100-01-01 00:00 UTC
+#define BLOCK       256
+#define MAX_THREADS 64
+
+// Bounds on the maximum error, arcseconds or miles
+#define MAX_LONGITUDE_ERROR  0.01
+#define MAX_RANGE_ERROR      0.001
+#define MAX_MOON_RA_ERROR    0.01
+#define MAX_SUN_RA_ERROR     60.0
+#define MAX_SIDEREAL_ERROR   0.01
+
+enum {
+  FUNCTION_LONGITUDE,
+  FUNCTION_RANGE,
+  FUNCTION_MOON_RA,
+  FUNCTION_SUN_RA,
+  FUNCTION_SIDEREAL,
+  FUNCTIONS
+};
+
+typedef struct {
+  const char *name;
+  const char *unit;
+  double bound;
+} Function;
+
+static const Function s_functions[FUNCTIONS] = {
+  { "sigmaMoonLongitude",    "\"", MAX_LONGITUDE_ERROR },
+  { "sigmaMoonRange",        "mi", MAX_RANGE_ERROR },
+  { "moonRA",                "\"", MAX_MOON_RA_ERROR },
+  { "sunRA",                 "\"", MAX_SUN_RA_ERROR },
+  { "greenwichSiderealTime", "\"", MAX_SIDEREAL_ERROR },
+};
+
+typedef struct {
+  double worst;
+  time_t when;
+  double squares;
+  double fastSeconds;
+  double referenceSeconds;
+} Result;
+
+typedef struct {
+  long samples;
+  unsigned long long seed;
+  Result results[FUNCTIONS];
+} Worker;
+
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static unsigned long long nextRandom(unsigned long long *state) {
+  // xorshift64*
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+
+static double angleError(long double a, long double b) {
+  long double d = referenceNormDegrees(a - b);
+  return (double)(d >= 180.0L ? d - 360.0L : d);
+}
+
+
+static void record(Result *r, double error, time_t when) {
+  if (error < 0) {
+    error = -error;
+  }
+  r->squares += error * error;
+  if (error > r->worst) {
+    r->worst = error;
+    r->when = when;
+  }
+}
+
+
+static void *work(void *arg) {
+  Worker *w = arg;
+  time_t when[BLOCK];
+  struct tm tm[BLOCK];
+  double T[BLOCK];
+  long double JD[BLOCK];
+  double fast[FUNCTIONS][BLOCK];
+  long double reference[FUNCTIONS][BLOCK];
+  ReferenceMoon moon[BLOCK];
+
+  for (long done = 0; done < w->samples; done += BLOCK) {
+    int n = w->samples - done < BLOCK ? (int)(w->samples - done) : BLOCK;
+    double start;
+
+    for (int i = 0; i < n; i++) {
+      when[i] = SWEEP_START + (time_t)(nextRandom(&w->seed) % (SWEEP_END - SWEEP_START));
+      gmtime_r(&when[i], &tm[i]);
+      double jd = DateToJD(&tm[i]);
+      T[i] = JDtoT(&jd);
+      JD[i] = 2440587.5L + when[i] / 86400.0L;
+    }
+
+    // Reference, longitude and range from one call
+    start = now();
+    for (int i = 0; i < n; i++) {
+      referenceMoon((JD[i] - 2451545.0L) / 36525.0L, &moon[i]);
+    }
+    w->results[FUNCTION_LONGITUDE].referenceSeconds += now() - start;
+    w->results[FUNCTION_RANGE].referenceSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      reference[FUNCTION_MOON_RA][i] = referenceEclipticRA(moon[i].longitude);
+    }
+    w->results[FUNCTION_MOON_RA].referenceSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      reference[FUNCTION_SUN_RA][i] = referenceSunRA((JD[i] - 2451545.0L) / 36525.0L);
+    }
+    w->results[FUNCTION_SUN_RA].referenceSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      reference[FUNCTION_SIDEREAL][i] = referenceSiderealTime(JD[i]);
+    }
+    w->results[FUNCTION_SIDEREAL].referenceSeconds += now() - start;
+
+    // The watch routines
+    start = now();
+    for (int i = 0; i < n; i++) {
+      fast[FUNCTION_LONGITUDE][i] = sigmaMoonLongitude(T[i]);
+    }
+    w->results[FUNCTION_LONGITUDE].fastSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      fast[FUNCTION_RANGE][i] = sigmaMoonRange(T[i]);
+    }
+    w->results[FUNCTION_RANGE].fastSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      fast[FUNCTION_MOON_RA][i] = moonRA((double)moon[i].longitude);
+    }
+    w->results[FUNCTION_MOON_RA].fastSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      fast[FUNCTION_SUN_RA][i] = sunRA(T[i]);
+    }
+    w->results[FUNCTION_SUN_RA].fastSeconds += now() - start;
+
+    start = now();
+    for (int i = 0; i < n; i++) {
+      fast[FUNCTION_SIDEREAL][i] = greenwichSiderealTime(T[i], &tm[i]);
+    }
+    w->results[FUNCTION_SIDEREAL].fastSeconds += now() - start;
+
+    for (int i = 0; i < n; i++) {
+      record(&w->results[FUNCTION_LONGITUDE],
+             3600.0 * angleError(fast[FUNCTION_LONGITUDE][i], moon[i].longitude), when[i]);
+      record(&w->results[FUNCTION_RANGE],
+             fast[FUNCTION_RANGE][i] - (double)(moon[i].range * 0.62137119L), when[i]);
+      for (int f = FUNCTION_MOON_RA; f < FUNCTIONS; f++) {
+        record(&w->results[f], 3600.0 * angleError(fast[f][i], reference[f][i]), when[i]);
+      }
+    }
+  }
+  return NULL;
+}
+
+
+// The reference against what Meeus published
+static int checkReference(void) {
+  int failed = 0;
+
+  printf("%-12s %-16s %16s %16s\n", "reference", "quantity", "published", "error");
+  for (int i = 0; i < referencePositionCount; i++) {
+    const ReferencePosition *p = &referencePositions[i];
+    long double T = (p->JD - 2451545.0L) / 36525.0L;
+    ReferenceMoon moon;
+    long double value = 0, error;
+    const char *name = "";
+
+    referenceMoon(T, &moon);
+    switch (p->what) {
+      case REFERENCE_MOON_LONGITUDE: value = moon.longitude; name = "moon longitude"; break;
+      case REFERENCE_MOON_LATITUDE:  value = moon.latitude;  name = "moon latitude";  break;
+      case REFERENCE_MOON_RANGE:     value = moon.range;     name = "moon range";     break;
+      case REFERENCE_SUN_LONGITUDE:  value = referenceSunLongitude(T); name = "sun longitude"; break;
+      case REFERENCE_SIDEREAL_TIME:  value = referenceSiderealTime(p->JD); name = "sidereal time"; break;
+    }
+    error = value - p->value;
+    // Within one unit of the last digit given
+    int bad = error > p->tolerance || error < -p->tolerance;
+    printf("%-12s %-16s %16.7Lf %16.7Lf%s\n", p->source, name, p->value, error, bad ? "  FAIL" : "");
+    failed |= bad;
+  }
+  return failed;
+}
+
+
+int main(int argc, char **argv) {
+  long samples = argc > 1 ? atol(argv[1]) : 2000000;
+  int threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  static Worker workers[MAX_THREADS];
+  pthread_t ids[MAX_THREADS];
+  Result total[FUNCTIONS] = {{0}};
+  int failed;
+
+  // Comparison is with every term
+  lunarPrecision = LUNAR_PRECISION_FULL;
+
+  failed = checkReference();
+
+  if (threads < 1) {
+    threads = 1;
+  } else if (threads > MAX_THREADS) {
+    threads = MAX_THREADS;
+  }
+  double start = now();
+  for (int t = 0; t < threads; t++) {
+    workers[t].samples = samples / threads + (t < samples % threads);
+    workers[t].seed = 0x9E3779B97F4A7C15ULL * (t + 1);
+    pthread_create(&ids[t], NULL, work, &workers[t]);
+  }
+  for (int t = 0; t < threads; t++) {
+    pthread_join(ids[t], NULL);
+    for (int f = 0; f < FUNCTIONS; f++) {
+      Result *r = &workers[t].results[f];
+      if (r->worst >= total[f].worst) {
+        total[f].worst = r->worst;
+        total[f].when = r->when;
+      }
+      total[f].squares += r->squares;
+      total[f].fastSeconds += r->fastSeconds;
+      total[f].referenceSeconds += r->referenceSeconds;
+    }
+  }
+  double elapsed = now() - start;
+
+  printf("\n%ld timestamps, 1900-2100, %d threads, %.1f s\n\n", samples, threads, elapsed);
+  printf("%-22s %11s %11s %9s   %-20s %10s %10s\n",
+         "function", "max error", "rms error", "bound", "at", "fast M/s", "ref M/s");
+  for (int f = 0; f < FUNCTIONS; f++) {
+    const Result *r = &total[f];
+    const Function *fn = &s_functions[f];
+    int bad = r->worst > fn->bound;
+    char when[32];
+    struct tm tm;
+    gmtime_r(&r->when, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    // Per thread seconds, so rates are per core
+    printf("%-22s %9.4f%-2s %9.4f%-2s %9.4f   %-20s %10.3f %10.3f%s\n",
+           fn->name, r->worst, fn->unit, sqrt(r->squares / samples), fn->unit, fn->bound, when,
+           samples / r->fastSeconds / 1e6, samples / r->referenceSeconds / 1e6,
+           bad ? "  FAIL" : "");
+    failed |= bad;
+  }
+  return failed;
+}
@@ -0,0 +1,23 @@
+/*
+ * reference_positions.c
+ * Published positions the long double reference (reference.c) must
+ * reproduce, each to within a unit of the last digit given.
+ */
+
+#include "reference.h"
+
+const ReferencePosition referencePositions[] = {
+  // Meeus - Astronomical Algorithms - example 47.a, 1992 April 12 0h TD
+  { "Meeus 47.a",  2448724.5L, REFERENCE_MOON_LONGITUDE, 133.162655L, 0.000001L },
+  { "Meeus 47.a",  2448724.5L, REFERENCE_MOON_LATITUDE,  -3.229126L,  0.000001L },
+  { "Meeus 47.a",  2448724.5L, REFERENCE_MOON_RANGE,     368409.7L,   0.1L },
+  // Meeus - Astronomical Algorithms - example 25.a, 1992 October 13 0h TD
+  { "Meeus 25.a",  2448908.5L, REFERENCE_SUN_LONGITUDE,  199.90988L,  0.00001L },
+  // Meeus - Astronomical Algorithms - examples 12.a and 12.b, 1987 April 10
+  // 0h UT (13h10m46.3668s) and 19h21m00s UT.  Formula 12.4 in long double
+  // gives 128.73787328 for 12.b, so the book is allowed two in its last digit.
+  { "Meeus 12.a",  2446895.5L, REFERENCE_SIDEREAL_TIME,  197.693195L, 0.000001L },
+  { "Meeus 12.b",  2446896.30625L, REFERENCE_SIDEREAL_TIME, 128.7378734L, 0.0000002L },
+};
+
+const int referencePositionCount = sizeof(referencePositions) / sizeof(referencePositions[0]);
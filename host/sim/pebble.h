@@ -0,0 +1,301 @@
+#pragma once
+/*
+ * pebble.h
+ * Host stand-in for the parts of the Pebble SDK that luna.c uses, so
+ * that the face runs under host/sim/sim.c.  Types and signatures follow
+ * SDK 3; what the services do is simulated in sim.c against a clock
+ * the simulator owns.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Time comes from the simulator's clock
+time_t sim_time(time_t *tloc);
+#define time(tloc) sim_time(tloc)
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+// Logging
+#define APP_LOG_LEVEL_ERROR   1
+#define APP_LOG_LEVEL_WARNING 50
+#define APP_LOG_LEVEL_INFO    100
+#define APP_LOG_LEVEL_DEBUG   200
+void sim_log(int level, const char *fmt, ...);
+#define APP_LOG(level, fmt, ...) sim_log(level, fmt, ##__VA_ARGS__)
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+// Geometry
+typedef struct { int16_t x, y; } GPoint;
+typedef struct { int16_t w, h; } GSize;
+typedef struct { GPoint origin; GSize size; } GRect;
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+bool grect_equal(const GRect *const r1, const GRect *const r2);
+
+// Platform, basalt unless built as aplite with -DPBL_BW
+#ifdef PBL_BW
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_false)
+#else
+#define PBL_COLOR
+#define PBL_IF_COLOR_ELSE(if_true, if_false) (if_true)
+#endif
+
+// Colors, 8 bit argb as on basalt
+typedef union { uint8_t argb; } GColor8;
+typedef GColor8 GColor;
+#define GColorClear         ((GColor8){0x00})
+#define GColorBlack         ((GColor8){0xC0})
+#define GColorDarkGray      ((GColor8){0xD5})
+#define GColorLightGray     ((GColor8){0xEA})
+#define GColorWhite         ((GColor8){0xFF})
+#define GColorTiffanyBlue   ((GColor8){0xDA})
+#define GColorVividCerulean ((GColor8){0xCB})
+#define GColorCeleste       ((GColor8){0xEF})
+#define GColorBrightGreen   ((GColor8){0xDC})
+#define GColorIcterine      ((GColor8){0xFD})
+#define GColorChromeYellow  ((GColor8){0xF8})
+bool gcolor_equal(GColor8 x, GColor8 y);
+
+// Trigonometry
+#define TRIG_MAX_ANGLE 0x10000
+#define TRIG_MAX_RATIO 0xffff
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+int32_t atan2_lookup(int16_t y, int16_t x);
+
+// Bitmaps
+typedef enum {
+  GBitmapFormat1Bit,
+  GBitmapFormat8Bit,
+  GBitmapFormat1BitPalette,
+  GBitmapFormat2BitPalette,
+  GBitmapFormat4BitPalette,
+  GBitmapFormat8BitCircular,
+} GBitmapFormat;
+typedef struct GBitmap GBitmap;
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format);
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format,
+                                           GColor *palette, bool free_on_destroy);
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds);
+void gbitmap_destroy(GBitmap *bitmap);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+GRect gbitmap_get_bounds(const GBitmap *bitmap);
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap);
+
+// Graphics
+typedef struct GContext GContext;
+typedef enum { GCompOpAssign, GCompOpAssignInverted, GCompOpOr, GCompOpAnd, GCompOpClear, GCompOpSet } GCompOp;
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t width);
+void graphics_context_set_antialiased(GContext *ctx, bool enable);
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, int corner_mask);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+
+typedef struct {
+  uint32_t num_points;
+  GPoint *points;
+} GPathInfo;
+typedef struct GPath GPath;
+GPath *gpath_create(const GPathInfo *init);
+void gpath_destroy(GPath *path);
+void gpath_rotate_to(GPath *path, int32_t angle);
+void gpath_move_to(GPath *path, GPoint point);
+void gpath_draw_filled(GContext *ctx, GPath *path);
+void gpath_draw_outline(GContext *ctx, GPath *path);
+
+// Fonts and text
+typedef const struct SimFont *GFont;
+#define FONT_KEY_GOTHIC_14             "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_18             "RESOURCE_ID_GOTHIC_18"
+#define FONT_KEY_GOTHIC_18_BOLD        "RESOURCE_ID_GOTHIC_18_BOLD"
+#define FONT_KEY_LECO_20_BOLD_NUMBERS  "RESOURCE_ID_LECO_20_BOLD_NUMBERS"
+#define FONT_KEY_LECO_32_BOLD_NUMBERS  "RESOURCE_ID_LECO_32_BOLD_NUMBERS"
+GFont fonts_get_system_font(const char *font_key);
+typedef enum { GTextAlignmentLeft, GTextAlignmentCenter, GTextAlignmentRight } GTextAlignment;
+typedef enum { GTextOverflowModeWordWrap, GTextOverflowModeTrailingEllipsis, GTextOverflowModeFill } GTextOverflowMode;
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment, void *layout);
+
+// Layers and windows
+typedef struct Layer Layer;
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_mark_dirty(Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+GRect layer_get_frame(const Layer *layer);
+
+typedef struct TextLayer TextLayer;
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment);
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode mode);
+
+typedef struct BitmapLayer BitmapLayer;
+BitmapLayer *bitmap_layer_create(GRect frame);
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer);
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer);
+
+typedef struct Window Window;
+typedef void (*WindowHandler)(Window *window);
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_background_color(Window *window, GColor color);
+Layer *window_get_root_layer(const Window *window);
+void window_stack_push(Window *window, bool animated);
+
+// Services
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5,
+} TimeUnits;
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+
+typedef void (*AppFocusHandler)(bool in_focus);
+void app_focus_service_subscribe(AppFocusHandler handler);
+void app_focus_service_unsubscribe(void);
+
+typedef struct {
+  uint8_t charge_percent;
+  bool is_charging;
+  bool is_plugged;
+} BatteryChargeState;
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+BatteryChargeState battery_state_service_peek(void);
+
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+
+// Dictionaries and AppMessage
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+typedef struct {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+typedef struct {
+  TupleType type;
+  uint32_t key;
+  union {
+    struct { const uint8_t *data; uint16_t length; } bytes;
+    struct { const char *data; uint16_t length; } cstring;
+    struct { uint32_t storage; uint16_t width; } integer;
+  };
+} Tuplet;
+#define TupletInteger(_key, _integer) \
+  ((const Tuplet) { .type = TUPLE_INT, .key = _key, .integer = { .storage = _integer, .width = sizeof(_integer) }})
+#define TupletBytes(_key, _data, _length) \
+  ((const Tuplet) { .type = TUPLE_BYTE_ARRAY, .key = _key, .bytes = { .data = _data, .length = _length }})
+
+typedef struct DictionaryIterator DictionaryIterator;
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+} DictionaryResult;
+DictionaryResult dict_write_data(DictionaryIterator *iter, uint32_t key, const uint8_t *data, uint16_t size);
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, uint32_t key, const char *cstring);
+DictionaryResult dict_write_int(DictionaryIterator *iter, uint32_t key, const void *integer, uint8_t width, bool is_signed);
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, uint32_t key, uint8_t value);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, uint32_t key, int32_t value);
+uint32_t dict_write_end(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_INVALID_ARGS = 1 << 7,
+} AppMessageResult;
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+typedef void (*AppSyncTupleChangedCallback)(const uint32_t key, const Tuple *new_tuple,
+                                            const Tuple *old_tuple, void *context);
+typedef void (*AppSyncErrorCallback)(DictionaryResult dict_error, AppMessageResult app_message_error,
+                                     void *context);
+typedef struct {
+  AppSyncTupleChangedCallback changed;
+  AppSyncErrorCallback error;
+  void *context;
+} AppSync;
+void app_sync_init(AppSync *s, uint8_t *buffer, const uint16_t buffer_size,
+                   const Tuplet * const keys_and_initial_values, const uint8_t count,
+                   AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context);
+void app_sync_deinit(AppSync *s);
+
+// Storage
+#define PERSIST_DATA_MAX_LENGTH 256
+bool persist_exists(const uint32_t key);
+int persist_get_size(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+int persist_delete(const uint32_t key);
+
+// Runs the simulated timeline
+void app_event_loop(void);
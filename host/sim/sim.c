@@ -0,0 +1,2064 @@
+/*
+ * sim.c
+ * Headless run of the watchface on a host, for power regressions.
+ *
+ * luna.c is built against sim/pebble.h with its main() renamed to
+ * luna_main(), and the services it uses are simulated here against a
+ * clock owned by the simulator.  app_event_loop() replays a scenario:
+ * time only moves between events, so a day takes well under a second.
+ * Everything the face does that costs power on the watch is counted:
+ *
+ *   wakeups        ticks, timers, messages and focus or battery events
+ *   frames         times the window was drawn
+ *   ephemeris      full moonPosition(), moonPositionAt() or
+ *                  moonPositionFixed() series, and propagator anchors,
+ *                  counted by wrapping them at link time
+ *   steps          moonPropagatorStep() calls, the positions the lunar
+ *                  event search steps to between anchors; with the
+ *                  anchors and its own series they are what a search
+ *                  costs, in soft float where there is no FPU
+ *   tick changes   tick_timer_service subscribe and unsubscribe calls
+ *                  that change what is subscribed
+ *   messages out   app_message_outbox_send calls
+ *   messages in    tuples the phone sends, scripted or answering a
+ *                  request for ephemeris windows as pebble-js-app.js
+ *                  does
+ *   text sets      text_layer_set_text calls, each redraws its layer
+ *   heap peak      most bytes the face had allocated through the SDK,
+ *                  layers, bitmaps and message buffers, or with
+ *                  malloc(), wrapped at link time as the series are
+ *
+ * A scenario is a text file, one command per line, '#' starts a comment:
+ *
+ *   start <unix time>            when the face is started
+ *   duration <seconds>           how long to run
+ *   tz <TZ>                      local time zone, default UTC
+ *   <seconds> location <lon> <lat>   phone sends a location, degrees east
+ *   <seconds> ephemeris <hours>  phone sends windows from the current one
+ *                                on, unasked
+ *   <seconds> focus <0|1>        a notification takes or returns focus
+ *   <seconds> battery <percent> <charging>
+ *   <seconds> restart <away>     the face exits and is launched again
+ *                                after away seconds, keeping storage
+ *   <seconds> frame <name>       the screen is saved as name.ppm
+ *   budget <counter> <maximum> [double|fixed|lean]
+ *                                fail if the run counted more, in
+ *                                either build or only the one named
+ *
+ * Event times are seconds from start.  While the face is out of focus
+ * its window is covered, so dirty layers wait for focus to return.
+ *
+ * The face draws into a 144x168 frame buffer of basalt's 8 bit colours,
+ * with system fonts approximated by one scaled 5x7 face, so frames show
+ * what it drew but not to the pixel what the watch shows.  How many
+ * drawing calls a frame made and how long it took to draw are reported
+ * with the counts.  A frame command looks at the screen without waking
+ * the face, and is seen before anything else due at the same time.
+ *
+ *   sim [-v] [-o dir] [-g dir] scenario
+ *
+ *   -v       logs every wakeup and APP_LOG
+ *   -o dir   writes frames into dir
+ *   -g dir   compares frames with the golden ones in dir, failing the
+ *            run on any pixel that differs; with -o as well, the
+ *            differences are written as name-diff.ppm
+ */
+
+#include <pebble.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "ephemeris.h"
+#include "ephemeris_cache.h"
+#include "ephemeris_feed.h"
+#include "ephemeris_fixed.h"
+#include "ephemeris_propagator.h"
+#include "lunar_events.h"
+#include "trig.h"
+
+#define SCREEN_WIDTH  144
+#define SCREEN_HEIGHT 168
+
+#define MAX_CHILDREN  8
+#define MAX_EVENTS    256
+#define MAX_BUDGETS   16
+#define MAX_PERSIST   32
+
+#if defined(LUNA_LEAN)
+#define SIM_BUILD "lean"
+#elif defined(LUNA_FIXED_POINT)
+#define SIM_BUILD "fixed"
+#else
+#define SIM_BUILD "double"
+#endif
+
+// What an app gets for code, data and heap: aplite's for the lean
+// build, basalt's otherwise
+#ifdef LUNA_LEAN
+#define SIM_APP_MEMORY (24 * 1024)
+#else
+#define SIM_APP_MEMORY (64 * 1024)
+#endif
+
+int luna_main(void);
+
+
+// Counters
+
+typedef enum {
+  COUNT_WAKEUPS,
+  COUNT_FRAMES,
+  COUNT_EPHEMERIS,
+  COUNT_STEPS,
+  COUNT_TICK_CHANGES,
+  COUNT_MESSAGES_OUT,
+  COUNT_TICKS,
+  COUNT_TIMERS,
+  COUNT_MESSAGES_IN,
+  COUNT_DRAW_CALLS,
+  COUNT_TEXT_SETS,
+  COUNT_HEAP_PEAK,
+  COUNTERS
+} Counter;
+
+static const char *s_counter_names[COUNTERS] = {
+  "wakeups", "frames", "ephemeris", "steps", "tick_changes", "messages_out",
+  "ticks", "timers", "messages_in", "draw_calls", "text_sets",
+  "heap_peak",
+};
+
+static unsigned long s_counts[COUNTERS];
+static bool s_verbose;
+
+
+// Clock, milliseconds since the epoch
+
+static int64_t s_clock;
+
+time_t sim_time(time_t *tloc) {
+  time_t t = (time_t)(s_clock / 1000);
+  if (tloc) {
+    *tloc = t;
+  }
+  return t;
+}
+
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  uint16_t ms = (uint16_t)(s_clock % 1000);
+  sim_time(tloc);
+  if (out_ms) {
+    *out_ms = ms;
+  }
+  return ms;
+}
+
+
+void sim_log(int level, const char *fmt, ...) {
+  va_list args;
+
+  if (!s_verbose) {
+    return;
+  }
+  va_start(args, fmt);
+  printf("%10.3f  log  ", (double)(s_clock % 86400000) / 1000.0);
+  vprintf(fmt, args);
+  printf("\n");
+  va_end(args);
+}
+
+
+// Heap, what the face allocates through the SDK or malloc().  free()
+// is wrapped too, so the simulator's own blocks go back through
+// __real_free().
+
+void __real_free(void *p);
+
+typedef struct {
+  size_t size;
+  double align[];
+} Allocation;
+
+static size_t s_heap_used;
+
+static void *sim_alloc(size_t size) {
+  Allocation *a = calloc(1, sizeof(Allocation) + size);
+  a->size = size;
+  s_heap_used += size;
+  if (s_heap_used > s_counts[COUNT_HEAP_PEAK]) {
+    s_counts[COUNT_HEAP_PEAK] = s_heap_used;
+  }
+  return a->align;
+}
+
+
+static void sim_free(void *p) {
+  if (p != NULL) {
+    Allocation *a = (Allocation *)((char *)p - offsetof(Allocation, align));
+    s_heap_used -= a->size;
+    __real_free(a);
+  }
+}
+
+
+void *__wrap_malloc(size_t size) {
+  return sim_alloc(size);
+}
+
+
+void __wrap_free(void *p) {
+  sim_free(p);
+}
+
+
+size_t heap_bytes_used(void) {
+  return s_heap_used;
+}
+
+
+size_t heap_bytes_free(void) {
+  return SIM_APP_MEMORY - s_heap_used;
+}
+
+
+// Geometry and trigonometry
+
+bool grect_equal(const GRect *const r1, const GRect *const r2) {
+  return r1->origin.x == r2->origin.x && r1->origin.y == r2->origin.y &&
+         r1->size.w == r2->size.w && r1->size.h == r2->size.h;
+}
+
+
+int32_t sin_lookup(int32_t angle) {
+  return sinLookup(angle);
+}
+
+
+int32_t cos_lookup(int32_t angle) {
+  return cosLookup(angle);
+}
+
+
+int32_t atan2_lookup(int16_t y, int16_t x) {
+  return atan2Lookup(y, x);
+}
+
+
+// Bitmaps
+
+struct GBitmap {
+  uint8_t *data;
+  uint16_t row_size;
+  GRect bounds;
+  GBitmapFormat format;
+  GColor *palette;
+  bool free_palette;
+};
+
+static int bits_per_pixel(GBitmapFormat format) {
+  switch (format) {
+    case GBitmapFormat1Bit:
+    case GBitmapFormat1BitPalette:
+      return 1;
+    case GBitmapFormat2BitPalette:
+      return 2;
+    case GBitmapFormat4BitPalette:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  GBitmap *bitmap = sim_alloc(sizeof(GBitmap));
+  int bits = bits_per_pixel(format);
+  // Plain 1 bit rows are word aligned, palettized rows byte aligned
+  if (format == GBitmapFormat1Bit) {
+    bitmap->row_size = (uint16_t)((size.w * bits + 31) / 32 * 4);
+  } else {
+    bitmap->row_size = (uint16_t)((size.w * bits + 7) / 8);
+  }
+  bitmap->data = sim_alloc((size_t)bitmap->row_size * size.h);
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->format = format;
+  return bitmap;
+}
+
+
+GBitmap *gbitmap_create_blank_with_palette(GSize size, GBitmapFormat format,
+                                           GColor *palette, bool free_on_destroy) {
+  GBitmap *bitmap = gbitmap_create_blank(size, format);
+  bitmap->palette = palette;
+  bitmap->free_palette = free_on_destroy;
+  return bitmap;
+}
+
+
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds) {
+  bitmap->bounds = bounds;
+}
+
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap != NULL) {
+    if (bitmap->free_palette) {
+      free(bitmap->palette);
+    }
+    sim_free(bitmap->data);
+    sim_free(bitmap);
+  }
+}
+
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->row_size;
+}
+
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+  return bitmap->format;
+}
+
+
+// Graphics, drawn into an 8 bit frame buffer of GColor8 as on basalt.
+// Nothing is antialiased, wide strokes have square ends and rectangle
+// corners are not rounded.  Every drawing call is counted.
+
+struct GContext {
+  GBitmap frame_buffer;
+  bool captured;
+  GPoint offset;          // of the layer being drawn, screen pixels
+  GRect clip;             // what it may draw on, screen pixels
+  GColor stroke_color;
+  GColor fill_color;
+  GColor text_color;
+  uint8_t stroke_width;
+  GCompOp compositing_mode;
+};
+
+static uint8_t s_frame_data[SCREEN_WIDTH * SCREEN_HEIGHT];
+static GContext s_context = {
+  .frame_buffer = {
+    .data = s_frame_data,
+    .row_size = SCREEN_WIDTH,
+    .bounds = {{0, 0}, {SCREEN_WIDTH, SCREEN_HEIGHT}},
+    .format = GBitmapFormat8Bit,
+  },
+  .clip = {{0, 0}, {SCREEN_WIDTH, SCREEN_HEIGHT}},
+};
+
+static void draw_call(void) {
+  s_counts[COUNT_DRAW_CALLS]++;
+}
+
+
+static bool transparent(GColor color) {
+  return (color.argb & 0xC0) == 0;
+}
+
+
+bool gcolor_equal(GColor8 x, GColor8 y) {
+  return x.argb == y.argb;
+}
+
+
+static GRect grect_intersect(GRect a, GRect b) {
+  int x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  int y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  int x1 = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+  int y1 = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+  return GRect(x0, y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0);
+}
+
+
+// The frame buffer byte under a point of the layer being drawn, or
+// NULL outside its clip
+static uint8_t *pixel_at(GContext *ctx, int x, int y) {
+  x += ctx->offset.x;
+  y += ctx->offset.y;
+  if (x < ctx->clip.origin.x || x >= ctx->clip.origin.x + ctx->clip.size.w ||
+      y < ctx->clip.origin.y || y >= ctx->clip.origin.y + ctx->clip.size.h) {
+    return NULL;
+  }
+  return &s_frame_data[y * SCREEN_WIDTH + x];
+}
+
+
+static void plot(GContext *ctx, int x, int y, GColor color) {
+  uint8_t *pixel = pixel_at(ctx, x, y);
+  if (pixel != NULL) {
+    *pixel = color.argb;
+  }
+}
+
+
+// A bitmap pixel onto the frame.  With argb bytes the modes are bit
+// operations, and white and black one bit pixels come out as on aplite.
+static void composite(GContext *ctx, int x, int y, GColor color) {
+  uint8_t *pixel = pixel_at(ctx, x, y);
+  if (pixel == NULL) {
+    return;
+  }
+  switch (ctx->compositing_mode) {
+    case GCompOpAssign:
+      *pixel = color.argb;
+      break;
+    case GCompOpAssignInverted:
+      *pixel = color.argb ^ 0x3F;
+      break;
+    case GCompOpOr:
+      *pixel |= color.argb;
+      break;
+    case GCompOpAnd:
+      *pixel &= color.argb;
+      break;
+    case GCompOpClear:
+      *pixel &= ~color.argb | 0xC0;
+      break;
+    case GCompOpSet:
+      if (!transparent(color)) {
+        *pixel = color.argb;
+      }
+      break;
+  }
+}
+
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t width) {
+  ctx->stroke_width = width > 0 ? width : 1;
+}
+
+
+void graphics_context_set_antialiased(GContext *ctx, bool enable) {}
+
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->compositing_mode = mode;
+}
+
+
+// What each layer starts drawing with, as on the watch
+static void reset_context(GContext *ctx) {
+  ctx->stroke_color = GColorBlack;
+  ctx->fill_color = GColorBlack;
+  ctx->text_color = GColorBlack;
+  ctx->stroke_width = 1;
+  ctx->compositing_mode = GCompOpAssign;
+}
+
+
+static void stroke_point(GContext *ctx, int x, int y) {
+  int from = -(ctx->stroke_width - 1) / 2;
+  for (int dy = from; dy < from + ctx->stroke_width; dy++) {
+    for (int dx = from; dx < from + ctx->stroke_width; dx++) {
+      plot(ctx, x + dx, y + dy, ctx->stroke_color);
+    }
+  }
+}
+
+
+// Bresenham's line
+static void stroke_line(GContext *ctx, GPoint p0, GPoint p1) {
+  int dx = abs(p1.x - p0.x);
+  int dy = -abs(p1.y - p0.y);
+  int sx = p0.x < p1.x ? 1 : -1;
+  int sy = p0.y < p1.y ? 1 : -1;
+  int err = dx + dy;
+  int x = p0.x;
+  int y = p0.y;
+
+  for (;;) {
+    stroke_point(ctx, x, y);
+    if (x == p1.x && y == p1.y) {
+      break;
+    }
+    int e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y += sy;
+    }
+  }
+}
+
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  draw_call();
+  if (!transparent(ctx->stroke_color)) {
+    stroke_line(ctx, p0, p1);
+  }
+}
+
+
+// A pixel is within radius r of the centre when x^2 + y^2 <= r^2 + r,
+// as for the phase sprites in luna.c.  The stroke is the ring between
+// that radius and stroke_width less, centred on the circle.
+void graphics_draw_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  int outer = radius + ctx->stroke_width / 2;
+  int inner = outer - ctx->stroke_width;
+  int most = outer * outer + outer;
+  int least = inner >= 0 ? inner * inner + inner : -1;
+
+  draw_call();
+  if (transparent(ctx->stroke_color)) {
+    return;
+  }
+  for (int y = -outer; y <= outer; y++) {
+    for (int x = -outer; x <= outer; x++) {
+      int d = x * x + y * y;
+      if (d > least && d <= most) {
+        plot(ctx, p.x + x, p.y + y, ctx->stroke_color);
+      }
+    }
+  }
+}
+
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  int most = radius * radius + radius;
+
+  draw_call();
+  if (transparent(ctx->fill_color)) {
+    return;
+  }
+  for (int y = -radius; y <= radius; y++) {
+    for (int x = -radius; x <= radius; x++) {
+      if (x * x + y * y <= most) {
+        plot(ctx, p.x + x, p.y + y, ctx->fill_color);
+      }
+    }
+  }
+}
+
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, int corner_mask) {
+  draw_call();
+  if (transparent(ctx->fill_color)) {
+    return;
+  }
+  for (int y = rect.origin.y; y < rect.origin.y + rect.size.h; y++) {
+    for (int x = rect.origin.x; x < rect.origin.x + rect.size.w; x++) {
+      plot(ctx, x, y, ctx->fill_color);
+    }
+  }
+}
+
+
+static GColor bitmap_pixel(const GBitmap *bitmap, int x, int y) {
+  const uint8_t *row = bitmap->data + y * bitmap->row_size;
+
+  switch (bitmap->format) {
+    case GBitmapFormat1Bit:
+      // Leftmost pixel in the lowest bit
+      return (row[x / 8] >> (x % 8)) & 1 ? GColorWhite : GColorBlack;
+    case GBitmapFormat8Bit:
+    case GBitmapFormat8BitCircular:
+      return (GColor){row[x]};
+    default: {
+      // Palettized, leftmost pixel in the highest bits
+      int bits = bits_per_pixel(bitmap->format);
+      int per_byte = 8 / bits;
+      int index = (row[x / per_byte] >> (8 - bits * (x % per_byte + 1))) & ((1 << bits) - 1);
+      return bitmap->palette ? bitmap->palette[index] : GColorClear;
+    }
+  }
+}
+
+
+// The bitmap's bounds are drawn, tiled if the rect is larger
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  GRect source = bitmap->bounds;
+
+  draw_call();
+  if (source.size.w <= 0 || source.size.h <= 0) {
+    return;
+  }
+  for (int y = 0; y < rect.size.h; y++) {
+    for (int x = 0; x < rect.size.w; x++) {
+      GColor color = bitmap_pixel(bitmap, source.origin.x + x % source.size.w,
+                                  source.origin.y + y % source.size.h);
+      composite(ctx, rect.origin.x + x, rect.origin.y + y, color);
+    }
+  }
+}
+
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  if (ctx->captured) {
+    return NULL;
+  }
+  ctx->captured = true;
+  return &ctx->frame_buffer;
+}
+
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  bool captured = ctx->captured;
+  ctx->captured = false;
+  return captured;
+}
+
+
+struct GPath {
+  GPathInfo info;
+  int32_t rotation;
+  GPoint offset;
+};
+
+GPath *gpath_create(const GPathInfo *init) {
+  GPath *path = sim_alloc(sizeof(GPath));
+  path->info = *init;
+  return path;
+}
+
+
+void gpath_destroy(GPath *path) {
+  sim_free(path);
+}
+
+
+void gpath_rotate_to(GPath *path, int32_t angle) {
+  path->rotation = angle;
+}
+
+
+void gpath_move_to(GPath *path, GPoint point) {
+  path->offset = point;
+}
+
+
+// The path's points turned clockwise on the screen, then moved
+static void path_points(const GPath *path, GPoint *points) {
+  int32_t s = sin_lookup(path->rotation);
+  int32_t c = cos_lookup(path->rotation);
+
+  for (uint32_t i = 0; i < path->info.num_points; i++) {
+    int32_t x = path->info.points[i].x;
+    int32_t y = path->info.points[i].y;
+    points[i].x = (int16_t)((x * c - y * s) / TRIG_MAX_RATIO + path->offset.x);
+    points[i].y = (int16_t)((x * s + y * c) / TRIG_MAX_RATIO + path->offset.y);
+  }
+}
+
+
+// Scanlines through pixel centres, filled between pairs of crossings
+void gpath_draw_filled(GContext *ctx, GPath *path) {
+  int n = (int)path->info.num_points;
+
+  draw_call();
+  if (n < 3 || transparent(ctx->fill_color)) {
+    return;
+  }
+  GPoint points[n];
+  double crossings[n];
+  int top = INT16_MAX;
+  int bottom = INT16_MIN;
+  path_points(path, points);
+  for (int i = 0; i < n; i++) {
+    top = points[i].y < top ? points[i].y : top;
+    bottom = points[i].y > bottom ? points[i].y : bottom;
+  }
+  for (int y = top; y <= bottom; y++) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+      GPoint a = points[i];
+      GPoint b = points[(i + 1) % n];
+      if ((a.y <= y && y < b.y) || (b.y <= y && y < a.y)) {
+        double x = a.x + (double)(y - a.y) * (b.x - a.x) / (b.y - a.y);
+        int j = count++;
+        while (j > 0 && crossings[j - 1] > x) {
+          crossings[j] = crossings[j - 1];
+          j--;
+        }
+        crossings[j] = x;
+      }
+    }
+    for (int i = 0; i + 1 < count; i += 2) {
+      for (int x = (int)ceil(crossings[i]); x <= (int)floor(crossings[i + 1]); x++) {
+        plot(ctx, x, y, ctx->fill_color);
+      }
+    }
+  }
+}
+
+
+void gpath_draw_outline(GContext *ctx, GPath *path) {
+  int n = (int)path->info.num_points;
+
+  draw_call();
+  if (n < 2 || transparent(ctx->stroke_color)) {
+    return;
+  }
+  GPoint points[n];
+  path_points(path, points);
+  for (int i = 0; i < n; i++) {
+    stroke_line(ctx, points[i], points[(i + 1) % n]);
+  }
+}
+
+
+// Fonts, approximated by one 5x7 face scaled to about the height of
+// each system font.  Glyphs are columns, top row in the lowest bit.
+
+struct SimFont {
+  const char *key;
+  int scale;
+  int line_height;
+  bool bold;
+};
+
+static const struct SimFont s_fonts[] = {
+  {FONT_KEY_GOTHIC_14, 1, 14, false},
+  {FONT_KEY_GOTHIC_18, 1, 18, false},
+  {FONT_KEY_GOTHIC_18_BOLD, 1, 18, true},
+  {FONT_KEY_LECO_20_BOLD_NUMBERS, 2, 20, true},
+  {FONT_KEY_LECO_32_BOLD_NUMBERS, 3, 32, true},
+};
+
+#define GLYPH_WIDTH  5
+#define GLYPH_HEIGHT 7
+
+static const uint8_t s_glyphs[][GLYPH_WIDTH] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00},   // space !
+  {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},   // " #
+  {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},   // $ %
+  {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},   // & '
+  {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00},   // ( )
+  {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08},   // * +
+  {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08},   // , -
+  {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},   // . /
+  {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},   // 0 1
+  {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31},   // 2 3
+  {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},   // 4 5
+  {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},   // 6 7
+  {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E},   // 8 9
+  {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},   // : ;
+  {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},   // < =
+  {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},   // > ?
+  {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E},   // @ A
+  {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},   // B C
+  {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41},   // D E
+  {0x7F, 0x09, 0x09, 0x01, 0x01}, {0x3E, 0x41, 0x41, 0x51, 0x32},   // F G
+  {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},   // H I
+  {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},   // J K
+  {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x04, 0x02, 0x7F},   // L M
+  {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},   // N O
+  {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E},   // P Q
+  {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},   // R S
+  {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},   // T U
+  {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F},   // V W
+  {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03},   // X Y
+  {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},   // Z [
+  {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00},   // backslash ]
+  {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},   // ^ _
+  {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},   // ` a
+  {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},   // b c
+  {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18},   // d e
+  {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},   // f g
+  {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00},   // h i
+  {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x7F, 0x10, 0x28, 0x44, 0x00},   // j k
+  {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},   // l m
+  {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},   // n o
+  {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C},   // p q
+  {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},   // r s
+  {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C},   // t u
+  {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},   // v w
+  {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},   // x y
+  {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},   // z {
+  {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00},   // | }
+  {0x08, 0x04, 0x08, 0x10, 0x08},                                   // ~
+};
+
+GFont fonts_get_system_font(const char *font_key) {
+  for (size_t i = 0; i < ARRAY_LENGTH(s_fonts); i++) {
+    if (strcmp(font_key, s_fonts[i].key) == 0) {
+      return &s_fonts[i];
+    }
+  }
+  return &s_fonts[0];
+}
+
+
+static int glyph_advance(GFont font) {
+  return (GLYPH_WIDTH + 1) * font->scale + font->bold;
+}
+
+
+static void draw_glyph(GContext *ctx, GFont font, char c, int left, int top) {
+  if (c < ' ' || c > '~') {
+    c = '?';
+  }
+  const uint8_t *columns = s_glyphs[c - ' '];
+  for (int col = 0; col < GLYPH_WIDTH + font->bold; col++) {
+    // Bold repeats each column one pixel to the right
+    uint8_t bits = (col < GLYPH_WIDTH ? columns[col] : 0) | (col > 0 && font->bold ? columns[col - 1] : 0);
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      if (!(bits & (1 << row))) {
+        continue;
+      }
+      for (int y = 0; y < font->scale; y++) {
+        for (int x = 0; x < font->scale; x++) {
+          plot(ctx, left + col * font->scale + x, top + row * font->scale + y, ctx->text_color);
+        }
+      }
+    }
+  }
+}
+
+
+// Lines end at newlines, and when word wrapping at the last space that
+// fits the box, or mid word if none does.  The box clips the text.
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment, void *layout) {
+  int advance = glyph_advance(font);
+  int fit = (box.size.w + font->scale) / advance;
+  int top = box.origin.y + (font->line_height - GLYPH_HEIGHT * font->scale) * 3 / 4;
+  GRect clip = ctx->clip;
+
+  draw_call();
+  if (transparent(ctx->text_color)) {
+    return;
+  }
+  ctx->clip = grect_intersect(clip, GRect(box.origin.x + ctx->offset.x, box.origin.y + ctx->offset.y,
+                                          box.size.w, box.size.h));
+  while (*text != '\0' && top < box.origin.y + box.size.h) {
+    int length = 0;
+    while (text[length] != '\0' && text[length] != '\n') {
+      length++;
+    }
+    int next = length + (text[length] == '\n');
+    if (length > fit && overflow_mode == GTextOverflowModeWordWrap) {
+      int space = fit;
+      while (space > 0 && text[space] != ' ') {
+        space--;
+      }
+      length = space > 0 ? space : (fit > 0 ? fit : 1);
+      next = length + (text[length] == ' ');
+    }
+    while (length > 0 && text[length - 1] == ' ') {
+      length--;
+    }
+
+    int width = length > 0 ? length * advance - font->scale : 0;
+    int left = box.origin.x;
+    if (alignment == GTextAlignmentCenter) {
+      left += (box.size.w - width) / 2;
+    } else if (alignment == GTextAlignmentRight) {
+      left += box.size.w - width;
+    }
+    for (int i = 0; i < length; i++) {
+      draw_glyph(ctx, font, text[i], left + i * advance, top);
+    }
+    text += next;
+    top += font->line_height;
+  }
+  ctx->clip = clip;
+}
+
+
+// Layers and windows
+
+struct Layer {
+  GRect frame;
+  LayerUpdateProc update_proc;
+  LayerUpdateProc draw;          // the system's own, for text layers
+  Layer *children[MAX_CHILDREN];
+  int child_count;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+  GColor text_color;
+  GColor background_color;
+  GTextAlignment alignment;
+  GTextOverflowMode overflow_mode;
+};
+
+struct BitmapLayer {
+  Layer layer;
+};
+
+struct Window {
+  Layer root;
+  GColor background_color;
+  WindowHandlers handlers;
+  bool loaded;
+};
+
+static Window *s_top_window;
+static bool s_dirty;
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = sim_alloc(sizeof(Layer));
+  layer->frame = frame;
+  return layer;
+}
+
+
+void layer_destroy(Layer *layer) {
+  sim_free(layer);
+}
+
+
+void layer_add_child(Layer *parent, Layer *child) {
+  if (parent->child_count < MAX_CHILDREN) {
+    parent->children[parent->child_count++] = child;
+  }
+}
+
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+
+void layer_mark_dirty(Layer *layer) {
+  s_dirty = true;
+}
+
+
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+
+static void text_layer_draw(Layer *layer, GContext *ctx) {
+  TextLayer *text_layer = (TextLayer *)layer;
+  GRect bounds = layer_get_bounds(layer);
+
+  if (!transparent(text_layer->background_color)) {
+    graphics_context_set_fill_color(ctx, text_layer->background_color);
+    graphics_fill_rect(ctx, bounds, 0, 0);
+  }
+  if (text_layer->text != NULL) {
+    graphics_context_set_text_color(ctx, text_layer->text_color);
+    graphics_draw_text(ctx, text_layer->text, text_layer->font, bounds,
+                       text_layer->overflow_mode, text_layer->alignment, NULL);
+  }
+}
+
+
+// Styled as the SDK's defaults
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = sim_alloc(sizeof(TextLayer));
+  text_layer->layer.frame = frame;
+  text_layer->layer.draw = text_layer_draw;
+  text_layer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+  text_layer->text_color = GColorBlack;
+  text_layer->background_color = GColorWhite;
+  text_layer->alignment = GTextAlignmentLeft;
+  text_layer->overflow_mode = GTextOverflowModeWordWrap;
+  return text_layer;
+}
+
+
+void text_layer_destroy(TextLayer *text_layer) {
+  sim_free(text_layer);
+}
+
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+
+// Text layers redraw themselves when their text is set, even to the
+// same string
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  s_counts[COUNT_TEXT_SETS]++;
+  text_layer->text = text;
+  s_dirty = true;
+}
+
+
+// As do their styles
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+  s_dirty = true;
+}
+
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+  s_dirty = true;
+}
+
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background_color = color;
+  s_dirty = true;
+}
+
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment alignment) {
+  text_layer->alignment = alignment;
+  s_dirty = true;
+}
+
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode mode) {
+  text_layer->overflow_mode = mode;
+  s_dirty = true;
+}
+
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = sim_alloc(sizeof(BitmapLayer));
+  bitmap_layer->layer.frame = frame;
+  return bitmap_layer;
+}
+
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  sim_free(bitmap_layer);
+}
+
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *)&bitmap_layer->layer;
+}
+
+
+Window *window_create(void) {
+  Window *window = sim_alloc(sizeof(Window));
+  window->root.frame = GRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  window->background_color = GColorWhite;
+  return window;
+}
+
+
+void window_destroy(Window *window) {
+  if (window->loaded && window->handlers.unload) {
+    window->handlers.unload(window);
+  }
+  if (s_top_window == window) {
+    s_top_window = NULL;
+  }
+  sim_free(window);
+}
+
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+
+void window_set_background_color(Window *window, GColor color) {
+  window->background_color = color;
+  s_dirty = true;
+}
+
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *)&window->root;
+}
+
+
+void window_stack_push(Window *window, bool animated) {
+  s_top_window = window;
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load) {
+      window->handlers.load(window);
+    }
+  }
+  s_dirty = true;
+}
+
+
+// Each layer draws in its own coordinates, clipped to its frame and
+// its parent's
+static void render_layer(Layer *layer, GPoint origin) {
+  GRect clip = s_context.clip;
+
+  origin = GPoint(origin.x + layer->frame.origin.x, origin.y + layer->frame.origin.y);
+  s_context.offset = origin;
+  s_context.clip = grect_intersect(clip, GRect(origin.x, origin.y, layer->frame.size.w, layer->frame.size.h));
+  if (layer->draw) {
+    reset_context(&s_context);
+    layer->draw(layer, &s_context);
+  }
+  if (layer->update_proc) {
+    reset_context(&s_context);
+    layer->update_proc(layer, &s_context);
+  }
+  for (int i = 0; i < layer->child_count; i++) {
+    render_layer(layer->children[i], origin);
+  }
+  s_context.clip = clip;
+}
+
+
+// Services
+
+static TimeUnits s_tick_units;
+static TickHandler s_tick_handler;
+static time_t s_last_tick;
+static AppFocusHandler s_focus_handler;
+static BatteryStateHandler s_battery_handler;
+static BatteryChargeState s_battery = {80, false, false};
+static bool s_in_focus = true;
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  if (tick_units != s_tick_units || handler != s_tick_handler) {
+    s_counts[COUNT_TICK_CHANGES]++;
+  }
+  s_tick_units = tick_units;
+  s_tick_handler = handler;
+  s_last_tick = (time_t)(s_clock / 1000);
+}
+
+
+void tick_timer_service_unsubscribe(void) {
+  if (s_tick_handler != NULL) {
+    s_counts[COUNT_TICK_CHANGES]++;
+  }
+  s_tick_units = 0;
+  s_tick_handler = NULL;
+}
+
+
+struct AppTimer {
+  int64_t due;
+  AppTimerCallback callback;
+  void *data;
+  AppTimer *next;
+};
+
+static AppTimer *s_timers;
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  AppTimer *timer = sim_alloc(sizeof(AppTimer));
+  timer->due = s_clock + timeout_ms;
+  timer->callback = callback;
+  timer->data = callback_data;
+  timer->next = s_timers;
+  s_timers = timer;
+  return timer;
+}
+
+
+static bool unlink_timer(AppTimer *timer) {
+  for (AppTimer **p = &s_timers; *p; p = &(*p)->next) {
+    if (*p == timer) {
+      *p = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms) {
+  for (AppTimer *t = s_timers; t; t = t->next) {
+    if (t == timer) {
+      t->due = s_clock + new_timeout_ms;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void app_timer_cancel(AppTimer *timer) {
+  if (unlink_timer(timer)) {
+    sim_free(timer);
+  }
+}
+
+
+void app_focus_service_subscribe(AppFocusHandler handler) {
+  s_focus_handler = handler;
+}
+
+
+void app_focus_service_unsubscribe(void) {
+  s_focus_handler = NULL;
+}
+
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+  s_battery_handler = handler;
+}
+
+
+void battery_state_service_unsubscribe(void) {
+  s_battery_handler = NULL;
+}
+
+
+BatteryChargeState battery_state_service_peek(void) {
+  return s_battery;
+}
+
+
+// Dictionaries and AppMessage.  Outgoing dictionaries are built as on
+// the watch and only read back by the phone, see phone_answer().
+// Writes past the outbox size given to app_message_open() fail as they
+// would on the watch.
+
+struct DictionaryIterator {
+  uint8_t buffer[256];
+  uint16_t used;
+};
+
+static DictionaryIterator s_outbox;
+static uint32_t s_outbox_size;
+
+// A count byte, then a 7 byte header and the value per tuple.  The
+// header is the key, a type byte the sim leaves 0 and the size.
+static DictionaryResult dict_write(DictionaryIterator *iter, uint32_t key, const void *data, uint16_t size) {
+  if (iter->used + 7 + size > sizeof(iter->buffer) || 1 + iter->used + 7 + size > s_outbox_size) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  memcpy(iter->buffer + iter->used, &key, 4);
+  iter->buffer[iter->used + 4] = 0;
+  memcpy(iter->buffer + iter->used + 5, &size, 2);
+  memcpy(iter->buffer + iter->used + 7, data, size);
+  iter->used += 7 + size;
+  return DICT_OK;
+}
+
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, uint32_t key, const uint8_t *data, uint16_t size) {
+  return dict_write(iter, key, data, size);
+}
+
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, uint32_t key, const char *cstring) {
+  return dict_write(iter, key, cstring, (uint16_t)strlen(cstring) + 1);
+}
+
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, uint32_t key, const void *integer, uint8_t width, bool is_signed) {
+  return dict_write(iter, key, integer, width);
+}
+
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, uint32_t key, uint8_t value) {
+  return dict_write(iter, key, &value, 1);
+}
+
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, uint32_t key, int32_t value) {
+  return dict_write(iter, key, &value, 4);
+}
+
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  return iter->used;
+}
+
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  return NULL;
+}
+
+
+// The buffers come out of the app's heap, as on the watch
+static void *s_message_buffers;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  sim_free(s_message_buffers);
+  s_message_buffers = sim_alloc(size_inbound + size_outbound);
+  s_outbox_size = size_outbound;
+  return APP_MSG_OK;
+}
+
+
+uint32_t app_message_inbox_size_maximum(void) {
+  return 8200;
+}
+
+
+uint32_t app_message_outbox_size_maximum(void) {
+  return 8200;
+}
+
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  s_outbox.used = 0;
+  *iterator = &s_outbox;
+  return APP_MSG_OK;
+}
+
+
+static bool outbox_find_int32(uint32_t key, int32_t *value) {
+  for (uint16_t at = 0; at + 7 <= s_outbox.used; ) {
+    uint32_t tuple_key;
+    uint16_t size;
+    memcpy(&tuple_key, s_outbox.buffer + at, 4);
+    memcpy(&size, s_outbox.buffer + at + 5, 2);
+    if (tuple_key == key && size == 4) {
+      memcpy(value, s_outbox.buffer + at + 7, 4);
+      return true;
+    }
+    at += 7 + size;
+  }
+  return false;
+}
+
+
+// The phone, answering a request for windows as pebble-js-app.js does,
+// PHONE_DELAY after it is sent
+#define PHONE_FEED_REFRESH (4 * 60 * 60)     // FEED_REFRESH there
+#define PHONE_DELAY        1000              // ms
+
+static int64_t s_phone_due = INT64_MAX;
+static time_t s_phone_held;                  // KEY_EPHEMERIS asked with
+
+AppMessageResult app_message_outbox_send(void) {
+  int32_t held;
+
+  s_counts[COUNT_MESSAGES_OUT]++;
+  if (s_verbose) {
+    printf("%10.3f  send %u bytes\n", (double)(s_clock % 86400000) / 1000.0, s_outbox.used);
+  }
+  if (outbox_find_int32(3, &held) && held - s_clock / 1000 < PHONE_FEED_REFRESH) {
+    s_phone_held = held;
+    s_phone_due = s_clock + PHONE_DELAY;
+  }
+  return APP_MSG_OK;
+}
+
+
+static AppSync *s_sync;
+
+void app_sync_init(AppSync *s, uint8_t *buffer, const uint16_t buffer_size,
+                   const Tuplet * const keys_and_initial_values, const uint8_t count,
+                   AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context) {
+  s->changed = tuple_changed_callback;
+  s->error = error_callback;
+  s->context = context;
+  s_sync = s;
+
+  // Like the SDK, report the initial values as changes
+  for (int i = 0; i < count; i++) {
+    const Tuplet *initial = &keys_and_initial_values[i];
+    struct { Tuple tuple; uint8_t value[PERSIST_DATA_MAX_LENGTH]; } t = {{initial->key, initial->type}};
+    if (initial->type == TUPLE_BYTE_ARRAY) {
+      t.tuple.length = initial->bytes.length;
+      memcpy(t.tuple.value->data, initial->bytes.data, initial->bytes.length);
+    } else {
+      t.tuple.length = 4;
+      t.tuple.value->int32 = (int32_t)initial->integer.storage;
+    }
+    s->changed(t.tuple.key, &t.tuple, NULL, context);
+  }
+}
+
+
+void app_sync_deinit(AppSync *s) {
+  s_sync = NULL;
+}
+
+
+static void sync_receive(uint32_t key, int32_t value) {
+  struct { Tuple tuple; int32_t value; } t = {{key, TUPLE_INT, 4}};
+
+  if (s_sync == NULL) {
+    return;
+  }
+  t.tuple.value->int32 = value;
+  s_sync->changed(key, &t.tuple, NULL, s_sync->context);
+}
+
+
+static void sync_receive_bytes(uint32_t key, const uint8_t *data, uint16_t length) {
+  struct { Tuple tuple; uint8_t value[PERSIST_DATA_MAX_LENGTH]; } t = {{key, TUPLE_BYTE_ARRAY, length}};
+
+  if (s_sync == NULL) {
+    return;
+  }
+  memcpy(t.tuple.value->data, data, length);
+  s_sync->changed(key, &t.tuple, NULL, s_sync->context);
+}
+
+
+// Storage, kept in memory for the run
+
+typedef struct {
+  bool used;
+  uint32_t key;
+  int size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistEntry;
+
+static PersistEntry s_persist[MAX_PERSIST];
+
+static PersistEntry *persist_find(uint32_t key) {
+  for (int i = 0; i < MAX_PERSIST; i++) {
+    if (s_persist[i].used && s_persist[i].key == key) {
+      return &s_persist[i];
+    }
+  }
+  return NULL;
+}
+
+
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) != NULL;
+}
+
+
+int persist_get_size(const uint32_t key) {
+  PersistEntry *entry = persist_find(key);
+  return entry ? entry->size : -1;
+}
+
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  PersistEntry *entry = persist_find(key);
+  if (entry == NULL) {
+    return -1;
+  }
+  int size = (size_t)entry->size < buffer_size ? entry->size : (int)buffer_size;
+  memcpy(buffer, entry->data, size);
+  return size;
+}
+
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  PersistEntry *entry = persist_find(key);
+  int length = size < PERSIST_DATA_MAX_LENGTH ? (int)size : PERSIST_DATA_MAX_LENGTH;
+
+  for (int i = 0; entry == NULL && i < MAX_PERSIST; i++) {
+    if (!s_persist[i].used) {
+      entry = &s_persist[i];
+    }
+  }
+  if (entry == NULL) {
+    return -1;
+  }
+  entry->used = true;
+  entry->key = key;
+  entry->size = length;
+  memcpy(entry->data, data, length);
+  return length;
+}
+
+
+int persist_delete(const uint32_t key) {
+  PersistEntry *entry = persist_find(key);
+  if (entry == NULL) {
+    return -1;
+  }
+  entry->used = false;
+  return 0;
+}
+
+
+// Ephemeris evaluations, through -Wl,--wrap.  The phone's own are not
+// the watch's cost.
+
+static bool s_on_phone;
+
+void __real_moonPosition(double T, MoonPosition *pos);
+void __real_moonPositionAt(const Epoch *epoch, MoonPosition *pos);
+void __real_moonPositionFixed(time_t t, MoonPositionFixed *pos);
+void __real_moonPropagatorStart(MoonPropagator *p, time_t t, int32_t step);
+void __real_moonPropagatorStep(MoonPropagator *p);
+
+void __wrap_moonPosition(double T, MoonPosition *pos) {
+  s_counts[COUNT_EPHEMERIS] += !s_on_phone;
+  __real_moonPosition(T, pos);
+}
+
+
+void __wrap_moonPositionAt(const Epoch *epoch, MoonPosition *pos) {
+  s_counts[COUNT_EPHEMERIS] += !s_on_phone;
+  __real_moonPositionAt(epoch, pos);
+}
+
+
+void __wrap_moonPositionFixed(time_t t, MoonPositionFixed *pos) {
+  s_counts[COUNT_EPHEMERIS]++;
+  __real_moonPositionFixed(t, pos);
+}
+
+
+void __wrap_moonPropagatorStart(MoonPropagator *p, time_t t, int32_t step) {
+  s_counts[COUNT_EPHEMERIS]++;
+  __real_moonPropagatorStart(p, t, step);
+}
+
+
+void __wrap_moonPropagatorStep(MoonPropagator *p) {
+  s_counts[COUNT_STEPS]++;
+  __real_moonPropagatorStep(p);
+}
+
+
+// Scenario
+
+typedef enum {
+  EVENT_LOCATION,
+  EVENT_FOCUS,
+  EVENT_BATTERY,
+  EVENT_RESTART,
+  EVENT_EPHEMERIS,
+  EVENT_FRAME,
+} EventType;
+
+typedef struct {
+  int64_t at;            // ms since the epoch
+  EventType type;
+  double a, b;
+  char name[32];         // of a frame
+} ScenarioEvent;
+
+typedef struct {
+  Counter counter;
+  unsigned long maximum;
+} Budget;
+
+static const char *s_scenario_name;
+static time_t s_start;
+static long s_duration = 86400;
+static ScenarioEvent s_events[MAX_EVENTS];
+static int s_event_count;
+static Budget s_budgets[MAX_BUDGETS];
+static int s_budget_count;
+static int s_next_event;
+static int64_t s_relaunch = -1;      // ms since the epoch, or -1 to run on
+
+static int find_counter(const char *name) {
+  for (int i = 0; i < COUNTERS; i++) {
+    if (strcmp(name, s_counter_names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+static bool load_scenario(const char *path) {
+  char line[256];
+  int number = 0;
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    char word[32], name[64], build[16] = SIM_BUILD;
+    double at, a, b = 0;
+    int counter;
+    unsigned long maximum;
+
+    number++;
+    char *comment = strchr(line, '#');
+    if (comment) {
+      *comment = '\0';
+    }
+    if (sscanf(line, " %31s", word) != 1) {
+      continue;
+    }
+    if (sscanf(line, " start %ld", &s_start) == 1 ||
+        sscanf(line, " duration %ld", &s_duration) == 1) {
+      continue;
+    }
+    if (sscanf(line, " tz %63s", name) == 1) {
+      setenv("TZ", name, 1);
+      continue;
+    }
+    if (sscanf(line, " budget %63s %lu %15s", name, &maximum, build) >= 2 &&
+        (counter = find_counter(name)) >= 0 && s_budget_count < MAX_BUDGETS) {
+      if (strcmp(build, SIM_BUILD) == 0) {
+        s_budgets[s_budget_count++] = (Budget){counter, maximum};
+      }
+      continue;
+    }
+    if (sscanf(line, " %lf frame %31s", &at, name) == 2 && s_event_count < MAX_EVENTS) {
+      ScenarioEvent *e = &s_events[s_event_count++];
+      e->at = (int64_t)(at * 1000.0);
+      e->type = EVENT_FRAME;
+      strcpy(e->name, name);
+      continue;
+    }
+    if (sscanf(line, " %lf %31s %lf %lf", &at, word, &a, &b) >= 3 && s_event_count < MAX_EVENTS) {
+      ScenarioEvent *e = &s_events[s_event_count];
+      e->at = (int64_t)(at * 1000.0);
+      e->a = a;
+      e->b = b;
+      if (strcmp(word, "location") == 0) {
+        e->type = EVENT_LOCATION;
+      } else if (strcmp(word, "focus") == 0) {
+        e->type = EVENT_FOCUS;
+      } else if (strcmp(word, "battery") == 0) {
+        e->type = EVENT_BATTERY;
+      } else if (strcmp(word, "restart") == 0) {
+        e->type = EVENT_RESTART;
+      } else if (strcmp(word, "ephemeris") == 0) {
+        e->type = EVENT_EPHEMERIS;
+      } else {
+        goto bad;
+      }
+      s_event_count++;
+      continue;
+    }
+  bad:
+    fprintf(stderr, "%s:%d: cannot parse: %s", path, number, line);
+    fclose(f);
+    return false;
+  }
+  fclose(f);
+
+  // Keep events in time order, stable for equal times
+  for (int i = 1; i < s_event_count; i++) {
+    ScenarioEvent e = s_events[i];
+    int j = i;
+    while (j > 0 && s_events[j - 1].at > e.at) {
+      s_events[j] = s_events[j - 1];
+      j--;
+    }
+    s_events[j] = e;
+  }
+  return true;
+}
+
+
+// Event loop
+
+static void trace(const char *what) {
+  if (s_verbose) {
+    printf("%10.3f  %s\n", (double)(s_clock % 86400000) / 1000.0, what);
+  }
+}
+
+
+// Next boundary of the finest subscribed unit after the last tick, ms
+// since the epoch.  Other events landing on a boundary do not hide it.
+static int64_t next_tick(void) {
+  time_t now = s_last_tick;
+
+  if (s_tick_handler == NULL) {
+    return INT64_MAX;
+  }
+  if (s_tick_units & SECOND_UNIT) {
+    return (int64_t)(now + 1) * 1000;
+  }
+  struct tm local = *localtime(&now);
+  local.tm_sec = 0;
+  if (s_tick_units & MINUTE_UNIT) {
+    local.tm_min++;
+  } else {
+    local.tm_min = 0;
+    if (s_tick_units & HOUR_UNIT) {
+      local.tm_hour++;
+    } else {
+      local.tm_hour = 0;
+      local.tm_mday++;
+    }
+  }
+  local.tm_isdst = -1;
+  return (int64_t)mktime(&local) * 1000;
+}
+
+
+static TimeUnits units_changed(time_t before, time_t after) {
+  struct tm a = *localtime(&before);
+  struct tm b = *localtime(&after);
+  TimeUnits units = SECOND_UNIT;
+
+  if (a.tm_min != b.tm_min || after - before >= 60) units |= MINUTE_UNIT;
+  if (a.tm_hour != b.tm_hour || after - before >= 3600) units |= HOUR_UNIT;
+  if (a.tm_yday != b.tm_yday || a.tm_year != b.tm_year) units |= DAY_UNIT;
+  if (a.tm_mon != b.tm_mon || a.tm_year != b.tm_year) units |= MONTH_UNIT;
+  if (a.tm_year != b.tm_year) units |= YEAR_UNIT;
+  return units;
+}
+
+
+static AppTimer *earliest_timer(void) {
+  AppTimer *first = NULL;
+  for (AppTimer *t = s_timers; t; t = t->next) {
+    if (first == NULL || t->due < first->due) {
+      first = t;
+    }
+  }
+  return first;
+}
+
+
+// As packLocation() in pebble-js-app.js
+static int32_t pack_location(double east, double north) {
+  int16_t x = (int16_t)lround(east * LUNAR_LOCATION_SCALE);
+  int16_t y = (int16_t)lround(north * LUNAR_LOCATION_SCALE);
+  return (int32_t)(((uint32_t)(uint16_t)y << 16) | (uint16_t)x);
+}
+
+
+static uint8_t *put_int32(uint8_t *p, int32_t value) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (uint32_t)value >> (8 * i);
+  }
+  return p + 4;
+}
+
+
+// count windows from first as sendFeed() in pebble-js-app.js, fitting
+// with ephemeris_cache.c, one chunk per message
+static void send_feed(time_t first, int count) {
+  static const double units[EPH_CACHE_QUANTITIES] = {
+    [EPH_CACHE_LONGITUDE] = EPH_FEED_ANGLE_UNITS,
+    [EPH_CACHE_RANGE] = EPH_FEED_RANGE_UNITS,
+    [EPH_CACHE_MOON_RA] = EPH_FEED_ANGLE_UNITS,
+    [EPH_CACHE_SUN_RA] = EPH_FEED_ANGLE_UNITS,
+  };
+  EphemerisCache cache;
+  CachedEphemeris unused;
+
+  if (count > EPH_FEED_WINDOWS) {
+    count = EPH_FEED_WINDOWS;
+  }
+  s_on_phone = true;
+  ephemerisCacheInit(&cache);
+  for (int i = 0; i < count; i++) {
+    uint8_t chunk[EPH_FEED_CHUNK_SIZE] = {EPH_FEED_VERSION, i, count, 0};
+    uint8_t *p = put_int32(chunk + 4, (int32_t)(first + i * EPH_CACHE_WINDOW));
+    ephemerisCacheGet(&cache, first + i * EPH_CACHE_WINDOW, &unused);
+    for (int q = 0; q < EPH_CACHE_QUANTITIES; q++) {
+      for (int j = 0; j < EPH_CACHE_TERMS; j++) {
+        p = put_int32(p, (int32_t)lround(cache.coefficients[q][j] * units[q]));
+      }
+    }
+    s_counts[COUNT_MESSAGES_IN]++;
+    sync_receive_bytes(3, chunk, sizeof(chunk));
+  }
+  s_on_phone = false;
+}
+
+
+// The windows the watch does not hold, from the end of those it does,
+// or the one holding now, to a day of them from now
+static void phone_answer(void) {
+  time_t now = (time_t)(s_clock / 1000);
+  time_t current = now - now % EPH_CACHE_WINDOW;
+  time_t first = s_phone_held > current ? s_phone_held : current;
+
+  s_phone_due = INT64_MAX;
+  send_feed(first, (int)((current + EPH_FEED_WINDOWS * EPH_CACHE_WINDOW - first) / EPH_CACHE_WINDOW));
+}
+
+
+// Frames, as binary PPM
+
+#define FRAME_PIXELS (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+static const char *s_frames_out;         // -o, where frames are written
+static const char *s_frames_golden;      // -g, what they are compared with
+static int s_frames_failed;
+
+static bool write_ppm(const char *path, const uint8_t *rgb) {
+  FILE *f = fopen(path, "wb");
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+  fwrite(rgb, 3, FRAME_PIXELS, f);
+  return fclose(f) == 0;
+}
+
+
+static bool read_ppm(const char *path, uint8_t *rgb) {
+  int width, height, maximum;
+  FILE *f = fopen(path, "rb");
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  bool ok = fscanf(f, "P6 %d %d %d", &width, &height, &maximum) == 3 && fgetc(f) != EOF &&
+            width == SCREEN_WIDTH && height == SCREEN_HEIGHT && maximum == 255 &&
+            fread(rgb, 3, FRAME_PIXELS, f) == FRAME_PIXELS;
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "%s: not a %dx%d PPM\n", path, SCREEN_WIDTH, SCREEN_HEIGHT);
+  }
+  return ok;
+}
+
+
+// The screen as it is, nothing drawn for it.  A frame that differs from
+// its golden one fails the run, and with -o its differing pixels are
+// written in red over the golden frame dimmed.
+static void run_frame(const char *name) {
+  static uint8_t rgb[FRAME_PIXELS * 3];
+  static uint8_t golden[FRAME_PIXELS * 3];
+  char path[512];
+  int differing = 0;
+
+  for (int i = 0; i < FRAME_PIXELS; i++) {
+    uint8_t argb = s_frame_data[i];
+    rgb[3 * i] = ((argb >> 4) & 3) * 85;
+    rgb[3 * i + 1] = ((argb >> 2) & 3) * 85;
+    rgb[3 * i + 2] = (argb & 3) * 85;
+  }
+  if (s_frames_out != NULL) {
+    snprintf(path, sizeof(path), "%s/%s.ppm", s_frames_out, name);
+    s_frames_failed += !write_ppm(path, rgb);
+  }
+  if (s_frames_golden == NULL) {
+    printf("%10.3f  frame %s\n", (double)(s_clock % 86400000) / 1000.0, name);
+    return;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s.ppm", s_frames_golden, name);
+  if (!read_ppm(path, golden)) {
+    s_frames_failed++;
+    return;
+  }
+  for (int i = 0; i < FRAME_PIXELS; i++) {
+    differing += memcmp(rgb + 3 * i, golden + 3 * i, 3) != 0;
+  }
+  printf("%10.3f  frame %s: %d pixels differ%s\n", (double)(s_clock % 86400000) / 1000.0,
+         name, differing, differing ? "  FAIL" : "");
+  if (differing == 0) {
+    return;
+  }
+  s_frames_failed++;
+  if (s_frames_out != NULL) {
+    for (int i = 0; i < FRAME_PIXELS; i++) {
+      bool same = memcmp(rgb + 3 * i, golden + 3 * i, 3) == 0;
+      for (int c = 0; c < 3; c++) {
+        rgb[3 * i + c] = same ? golden[3 * i + c] / 3 : (c == 0) * 255;
+      }
+    }
+    snprintf(path, sizeof(path), "%s/%s-diff.ppm", s_frames_out, name);
+    write_ppm(path, rgb);
+  }
+}
+
+
+static void run_scenario_event(const ScenarioEvent *e) {
+  switch (e->type) {
+    case EVENT_LOCATION:
+      // pebble-js-app.js sends degrees east and north
+      s_counts[COUNT_MESSAGES_IN]++;
+      trace("location");
+      sync_receive(0, pack_location(e->a, e->b));
+      break;
+    case EVENT_FOCUS:
+      s_in_focus = e->a != 0;
+      trace(s_in_focus ? "focus in" : "focus out");
+      if (s_focus_handler) {
+        s_focus_handler(s_in_focus);
+      }
+      break;
+    case EVENT_BATTERY:
+      s_battery.charge_percent = (uint8_t)e->a;
+      s_battery.is_charging = e->b != 0;
+      s_battery.is_plugged = e->b != 0;
+      trace("battery");
+      if (s_battery_handler) {
+        s_battery_handler(s_battery);
+      }
+      break;
+    case EVENT_RESTART:
+      // app_event_loop() returns and main() launches the face again
+      trace("exit");
+      s_relaunch = s_clock + (int64_t)(e->a * 1000.0);
+      break;
+    case EVENT_EPHEMERIS: {
+      time_t now = (time_t)(s_clock / 1000);
+      trace("ephemeris");
+      send_feed(now - now % EPH_CACHE_WINDOW, (int)(e->a * 3600 / EPH_CACHE_WINDOW));
+      break;
+    }
+    case EVENT_FRAME:
+      run_frame(e->name);
+      break;
+  }
+}
+
+
+static int64_t s_render_ns;
+
+static int64_t monotonic_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+// The whole window is drawn again, over its background colour, as the
+// watch does.  Layers marked dirty while drawing are drawn in the same
+// pass.
+static void render(void) {
+  if (s_dirty && s_in_focus && s_top_window != NULL) {
+    int64_t begin = monotonic_ns();
+    memset(s_frame_data, s_top_window->background_color.argb, sizeof(s_frame_data));
+    s_context.clip = s_context.frame_buffer.bounds;
+    render_layer(&s_top_window->root, GPoint(0, 0));
+    s_dirty = false;
+    s_render_ns += monotonic_ns() - begin;
+    s_counts[COUNT_FRAMES]++;
+  }
+}
+
+
+void app_event_loop(void) {
+  int64_t end = ((int64_t)s_start + s_duration) * 1000;
+
+  render();
+  for (;;) {
+    int64_t tick = next_tick();
+    AppTimer *timer = earliest_timer();
+    int64_t timer_due = timer ? timer->due : INT64_MAX;
+    int64_t event_due = s_next_event < s_event_count
+                        ? (int64_t)s_start * 1000 + s_events[s_next_event].at : INT64_MAX;
+    int64_t due = tick < timer_due ? tick : timer_due;
+    due = s_phone_due < due ? s_phone_due : due;
+    due = event_due < due ? event_due : due;
+
+    if (due >= end) {
+      s_clock = end;
+      break;
+    }
+    s_clock = due;
+    if (due == event_due && s_events[s_next_event].type == EVENT_FRAME) {
+      // Looking at the screen wakes nothing
+      run_scenario_event(&s_events[s_next_event++]);
+      continue;
+    }
+    s_counts[COUNT_WAKEUPS]++;
+
+    if (due == event_due) {
+      run_scenario_event(&s_events[s_next_event++]);
+      if (s_relaunch >= 0) {
+        return;
+      }
+    } else if (due == s_phone_due) {
+      trace("phone");
+      phone_answer();
+    } else if (due == timer_due) {
+      s_counts[COUNT_TIMERS]++;
+      trace("timer");
+      unlink_timer(timer);
+      timer->callback(timer->data);
+      sim_free(timer);
+    } else {
+      time_t now = (time_t)(s_clock / 1000);
+      struct tm local = *localtime(&now);
+      s_counts[COUNT_TICKS]++;
+      trace("tick");
+      s_tick_handler(&local, units_changed(s_last_tick, now));
+      s_last_tick = now;
+    }
+    render();
+  }
+}
+
+
+// Between runs of the face: what the system frees when an app exits
+// goes, storage stays.  Scenario events while it is away are dropped.
+static void relaunch(void) {
+  while (s_timers != NULL) {
+    app_timer_cancel(s_timers);
+  }
+  s_battery_handler = NULL;
+  s_sync = NULL;
+  sim_free(s_message_buffers);
+  s_message_buffers = NULL;
+  s_phone_due = INT64_MAX;
+  s_clock = s_relaunch;
+  s_relaunch = -1;
+  while (s_next_event < s_event_count &&
+         (int64_t)s_start * 1000 + s_events[s_next_event].at < s_clock) {
+    s_next_event++;
+  }
+  trace("launch");
+}
+
+
+int main(int argc, char **argv) {
+  int failed = 0;
+
+  setenv("TZ", "UTC", 1);
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) {
+      s_verbose = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      s_frames_out = argv[++i];
+    } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+      s_frames_golden = argv[++i];
+    } else {
+      s_scenario_name = argv[i];
+    }
+  }
+  if (s_scenario_name == NULL) {
+    fprintf(stderr, "usage: %s [-v] [-o dir] [-g dir] scenario\n", argv[0]);
+    return 2;
+  }
+  if (!load_scenario(s_scenario_name)) {
+    return 2;
+  }
+  tzset();
+  s_clock = (int64_t)s_start * 1000;
+
+  luna_main();
+  while (s_relaunch >= 0 && s_relaunch < ((int64_t)s_start + s_duration) * 1000) {
+    relaunch();
+    luna_main();
+  }
+
+  printf("%s, %s build: %ld s from %ld\n", s_scenario_name, SIM_BUILD, s_duration, (long)s_start);
+  for (int i = 0; i < COUNTERS; i++) {
+    printf("  %-14s %8lu", s_counter_names[i], s_counts[i]);
+    for (int b = 0; b < s_budget_count; b++) {
+      if (s_budgets[b].counter == (Counter)i) {
+        bool over = s_counts[i] > s_budgets[b].maximum;
+        printf("   budget %lu%s", s_budgets[b].maximum, over ? "  OVER" : "");
+        failed |= over;
+      }
+    }
+    printf("\n");
+  }
+  if (s_counts[COUNT_FRAMES] > 0) {
+    printf("  %.1f draw calls and %.1f us a frame\n",
+           (double)s_counts[COUNT_DRAW_CALLS] / s_counts[COUNT_FRAMES],
+           s_render_ns / 1000.0 / s_counts[COUNT_FRAMES]);
+  }
+  return failed || s_frames_failed > 0;
+}
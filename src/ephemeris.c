@@ -0,0 +1,279 @@
+/*
+ * ephemeris.c
+ * Position of the moon and sun, after Meeus - Astronomical Algorithms.
+ * Kept free of pebble.h so it can be built and profiled on a host.
+ */
+
+#include "ephemeris.h"
+#include "lunar_terms.h"
+
+
+// Calculate Julian Date from a time struct
+// Meeus - Astronomical Algorithms - formula 7.1
+double DateToJD(struct tm *t) {
+  int M = t->tm_mon + 1 > 2 ? t->tm_mon + 1 : t->tm_mon + 13;
+  int Y = t->tm_mon + 1 > 2 ? t->tm_year + 1900 : t->tm_year + 1899;
+  double D = t->tm_mday + t->tm_hour/24.0 + t->tm_min/1440.0 + t->tm_sec/86400.0;
+  int B = 2 - (int)Y/100 + (int)Y/400;
+
+  return (int) (365.25*(Y + 4716)) + (int) (30.6001*(M + 1)) + D + B - 1524.5;
+}
+
+
+// Calculate time T, measured in Julian centuries from the 
+// epoch J2000.0 (JDE 2451545.0)   
+// Meeus - Astronomical Algorithms - formula 22.1
+double JDtoT(double *JD) {
+  return (double)(*JD - 2451545.0)/36525.0;
+}
+
+
+// Calculate the sun's mean longitude, measured in degrees [Lo]
+// Meeus - Astronomical Algorithms - formula 25.2
+static double sunMeanLongitude(const Epoch *epoch) {
+  double daily = 36000.76983 / 36525.0;
+  return 280.46646 
+         + normDegrees(daily * epoch->day) + daily * epoch->fraction
+         + 0.0003032 * epoch->T * epoch->T;
+}
+
+
+// Calculate the sun's equation of center, measured in degrees [C].
+// sin(2M) and sin(3M) follow from the one sine and cosine of M.
+// Meeus - Astronomical Algorithms - chapter 25
+static double sunEquationCenter(const Epoch *epoch) {
+  double T = epoch->T;
+  double s,c;
+  sincosx(epoch->M, &s, &c);
+  return (1.914602 - 0.004817 * T - 0.000014 * T * T) * s
+         + (0.019993 - 0.000101 * T) * 2.0 * s * c
+         + 0.000289 * s * (3.0 - 4.0 * s * s);
+}
+
+
+// Calculate the sun's true geometric longitude, measured in degrees
+// Meeus - Astronomical Algorithms - chapter 25
+double sunLongitudeAt(const Epoch *epoch) {
+  return normDegrees(sunMeanLongitude(epoch) + sunEquationCenter(epoch));
+}
+
+
+double sunLongitude(double T) {
+  Epoch epoch;
+  epochFromT(&epoch, T);
+  return sunLongitudeAt(&epoch);
+}
+
+
+double sigmaMoonLongitude(double T) {
+  //T = -0.077221081451; //debug value
+  double sigmaLongitude = 0.0;
+  double A1 = radians(119.75 + 131.849 * T);
+  double A2 = radians(53.09 +479264.290 * T);
+  
+  const LunarSeries *series = &lunarLongitudeSeries;
+  int terms = lunarTiers[lunarPrecision].longitude;
+  Epoch epoch;
+  epochFromT(&epoch, T);
+  const double *Epow = epoch.Epow;
+  double L  = epoch.L;
+  double D  = epoch.D;
+  double M  = epoch.M;
+  double Mm = epoch.Mm;
+  double F  = epoch.F;
+  
+  for(int term=0;term < terms;term++){
+    sigmaLongitude += series->sine[term] * Epow[series->E[term]] *
+                       sinx(series->D[term] * D +
+                            series->M[term] * M +
+                            series->Mm[term] * Mm +
+                            series->F[term] * F);
+  }
+
+  sigmaLongitude += 3958.0 * sinx(A1);
+  sigmaLongitude += 1962.0 * sinx(L - F);
+  sigmaLongitude +=  318.0 * sinx(A2);
+
+  return normDegrees(degrees(L) + sigmaLongitude / 1000000.0); 
+}
+
+
+double sigmaMoonRange(double T) {
+  //T = -0.077221081451; //debug value
+  double sigmaRange = 0.0;
+  
+  const LunarSeries *series = &lunarRangeSeries;
+  int terms = lunarTiers[lunarPrecision].range;
+  Epoch epoch;
+  epochFromT(&epoch, T);
+  const double *Epow = epoch.Epow;
+
+  double D  = epoch.D;
+  double M  = epoch.M;
+  double Mm = epoch.Mm;
+  double F  = epoch.F;
+  
+  for(int term=0;term < terms;term++){
+    sigmaRange += series->cosine[term] * Epow[series->E[term]] *
+                       cosx(series->D[term] * D +
+                            series->M[term] * M +
+                            series->Mm[term] * Mm +
+                            series->F[term] * F);
+  }
+  
+  return 0.62137119 * (385000.56 + (sigmaRange / 1000.0)); 
+}
+
+
+// Longitude, latitude and range of the moon in a single pass.
+// The fundamental arguments and powers of E come from the epoch, each
+// table 47.A term gets its sine and cosine from one sincosx() call
+// (longitude and range share the argument), and the table 47.B
+// latitude terms follow using the same arguments.
+// The rates are the same sums differentiated term by term: a term
+// a sin(x) moves at a cos(x) dx/dt and b cos(x) at -b sin(x) dx/dt,
+// so they take the other half of each sincosx() and the daily motion
+// of its argument.  E and the additive terms change them by less than
+// 0.0001 degrees a day and are taken as constant.
+// Meeus - Astronomical Algorithms - chapter 47
+void moonPositionAt(const Epoch *epoch, MoonPosition *pos) {
+  double sigmaLongitude = 0.0;
+  double sigmaLatitude = 0.0;
+  double sigmaRange = 0.0;
+  double rateLongitude = 0.0;
+  double rateRange = 0.0;
+  double s,c;
+
+  double T  = epoch->T;
+  const double *Epow = epoch->Epow;
+  double L  = epoch->L;
+  double D  = epoch->D;
+  double M  = epoch->M;
+  double Mm = epoch->Mm;
+  double F  = epoch->F;
+  double A1 = radians(a1a + a1b * T);
+  double A2 = radians(a2a + a2b * T);
+  double A3 = radians(a3a + a3b * T);
+
+  const LunarTier *tier = &lunarTiers[lunarPrecision];
+  const LunarSeries *series;
+  if (lunarTierComplete(tier)) {
+    series = &lunarLongitudeRangeSeries;
+    for(int term=0;term < series->count;term++){
+      double e = Epow[series->E[term]];
+      double rate = lunarTermRate(series, term);
+      sincosx(series->D[term] * D + series->M[term] * M + series->Mm[term] * Mm + series->F[term] * F, &s, &c);
+      sigmaLongitude += series->sine[term] * e * s;
+      sigmaRange     += series->cosine[term] * e * c;
+      rateLongitude  += series->sine[term] * e * c * rate;
+      rateRange      -= series->cosine[term] * e * s * rate;
+    }
+  } else {
+    // Truncated: each sum runs down its own table as far as the tier says
+    series = &lunarLongitudeSeries;
+    for(int term=0;term < tier->longitude;term++){
+      double e = Epow[series->E[term]];
+      double rate = lunarTermRate(series, term);
+      sincosx(series->D[term] * D + series->M[term] * M + series->Mm[term] * Mm + series->F[term] * F, &s, &c);
+      sigmaLongitude += series->sine[term] * e * s;
+      rateLongitude  += series->sine[term] * e * c * rate;
+    }
+    series = &lunarRangeSeries;
+    for(int term=0;term < tier->range;term++){
+      double e = Epow[series->E[term]];
+      double rate = lunarTermRate(series, term);
+      sincosx(series->D[term] * D + series->M[term] * M + series->Mm[term] * Mm + series->F[term] * F, &s, &c);
+      sigmaRange += series->cosine[term] * e * c;
+      rateRange  -= series->cosine[term] * e * s * rate;
+    }
+  }
+
+  series = &lunarLatitudeSeries;
+  for(int term=0;term < tier->latitude;term++){
+    double e = Epow[series->E[term]];
+    sigmaLatitude += series->sine[term] * e *
+                     sinx(series->D[term] * D + series->M[term] * M + series->Mm[term] * Mm + series->F[term] * F);
+  }
+
+  // Additive terms for Venus, Jupiter and the flattening of the earth
+  sigmaLongitude += 3958.0 * sinx(A1)
+                  + 1962.0 * sinx(L - F)
+                  +  318.0 * sinx(A2);
+  sigmaLatitude  += -2235.0 * sinx(L)
+                  +   382.0 * sinx(A3)
+                  +   175.0 * sinx(A1 - F)
+                  +   175.0 * sinx(A1 + F)
+                  +   127.0 * sinx(L - Mm)
+                  -   115.0 * sinx(L + Mm);
+
+  pos->longitude = normDegrees(degrees(L) + sigmaLongitude / 1000000.0);
+  pos->latitude  = sigmaLatitude / 1000000.0;
+  pos->range     = 0.62137119 * (385000.56 + (sigmaRange / 1000.0));
+  pos->longitudeRate = LUNAR_L_RATE + rateLongitude / 1000000.0;
+  pos->rangeRate     = 0.62137119 * rateRange / 1000.0;
+}
+
+
+void moonPosition(double T, MoonPosition *pos) {
+  Epoch epoch;
+  epochFromT(&epoch, T);
+  moonPositionAt(&epoch, pos);
+}
+
+
+// cos(obliquityE)
+static const double cosObliquityE = 0.917482062146321;
+
+// Right ascension of ecliptic longitude L, latitude ignored, degrees
+static double eclipticRA(double L) {
+  double s,c;
+  sincosx(radians(L), &s, &c);
+  return normDegrees(degrees(atan2x(s * cosObliquityE, c)));
+}
+
+
+double moonRA(double L){
+  return eclipticRA(L);
+}
+
+double moonOrbitalSpeed(double Range){
+  Range = Range * 1609.344;  // convert miles to meters
+  float moonMu = 398600000000000.8000;
+  double moonSemiMajor = 384400000.0;
+  return 3600.0 * (sqrtx(moonMu * ((2.0 / Range) - (1.0 / moonSemiMajor)))) / 1609.344;
+}
+
+
+// Low precision apparent right ascension, the mean anomaly g is the
+// epoch's M.  sin(2g) follows from the one sine and cosine of g.
+double sunRAAt(const Epoch *epoch) {
+  double s,c;
+  double L = 280.461 + normDegrees(0.9856474 * epoch->day) + 0.9856474 * epoch->fraction;
+  sincosx(epoch->M, &s, &c);
+  double lambda = L + 1.915 * s + 0.020 * 2.0 * s * c;
+
+  return eclipticRA(lambda);
+}
+
+
+double sunRA(double T){ 
+  //T = -0.024012092;
+  Epoch epoch;
+  epochFromT(&epoch, T);
+  return sunRAAt(&epoch);
+}
+
+
+// Greenwich mean sidereal time in degrees.  The polynomial is for
+// T at 0h UT, so the time of day is taken back out of T before the
+// sidereal rotation since midnight is added.
+// Meeus - Astronomical Algorithms - formula 12.3
+double greenwichSiderealTime(double T, struct tm *t) {
+  double offset = (double)(t->tm_hour * 3600 + t->tm_min * 60 + t->tm_sec); 
+  
+  T = T - offset / (86400.0 * 36525.0);
+  offset = 360.0 * offset / 86400.0;
+  return normDegrees(100.46061837 + (36000.770053608 * T) 
+         + (0.000387933 * T * T) - (T * T * T / 38710000.0)
+         + 1.00273790935 * offset);
+}
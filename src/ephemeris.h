@@ -0,0 +1,58 @@
+#pragma once
+/*
+ * ephemeris.h
+ * Lunar and solar position routines used by the Luna watchface.
+ *
+ * Nothing in here depends on pebble.h, so the same source builds into
+ * the watch app (through wscript) and natively on a host (see host/).
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include "epoch.h"
+#include "fastmath.h"
+#include "trig.h"
+
+// adjustment arguments in degrees
+// a1 = venus
+// a2 = jupiter
+static const double a1a = 119.75;
+static const double a1b = 131.849;
+static const double a2a = 53.09;
+static const double a2b = 479264.290;
+static const double a3a = 313.45;
+static const double a3b = 481266.484;
+
+static const double obliquityE = 23.4392911;
+
+// Geocentric ecliptic position of the moon.
+typedef struct {
+  double longitude;   // degrees, [0, 360)
+  double latitude;    // degrees
+  double range;       // miles, center to center
+  double longitudeRate;   // degrees per day
+  double rangeRate;       // miles per day
+} MoonPosition;
+
+
+// Time
+double DateToJD(struct tm *t);
+double JDtoT(double *JD);
+
+// Moon.  The T forms build an Epoch for the one call; callers that
+// have one should pass it.
+double sigmaMoonLongitude(double T);
+double sigmaMoonRange(double T);
+void moonPosition(double T, MoonPosition *pos);
+void moonPositionAt(const Epoch *epoch, MoonPosition *pos);
+double moonRA(double L);
+double moonOrbitalSpeed(double Range);
+
+// Sun
+double sunLongitude(double T);
+double sunLongitudeAt(const Epoch *epoch);
+double sunRA(double T);
+double sunRAAt(const Epoch *epoch);
+
+// Earth
+double greenwichSiderealTime(double T, struct tm *t);
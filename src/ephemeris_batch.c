@@ -0,0 +1,199 @@
+/*
+ * ephemeris_batch.c
+ * Batch evaluation of the moon's position, see ephemeris_batch.h.
+ */
+
+#include "ephemeris_batch.h"
+#include "ephemeris.h"
+#include "lunar_terms.h"
+
+#if defined(__SSE2__) || defined(__AVX__) || defined(__ARM_NEON)
+
+// Vector kernel.  Everything in the inner loops is straight-line
+// arithmetic with selects instead of branches, so that the compiler
+// can run one lane per instant.
+
+// Adding and subtracting 1.5 * 2^52 rounds to the nearest integer.
+#define ROUND_MAGIC 6755399441055744.0
+
+static inline double roundNearest(double x) {
+  return (x + ROUND_MAGIC) - ROUND_MAGIC;
+}
+
+
+// Degrees to radians in [-PI, PI].
+static inline double reduceDegrees(double d) {
+  return (d - 360.0 * roundNearest(d / 360.0)) * (M_PI / 180.0);
+}
+
+
+// sincosx() without the switch: the quadrant is kept as a double
+// and selects between the two kernels.
+static inline void sincosLane(double x, double *s, double *c) {
+  double k = roundNearest(x * (2.0 / M_PI));
+  double r = x - k * (M_PI / 2.0);
+  double r2 = r * r;
+  double sr = sinKernel(r, r2);
+  double cr = cosKernel(r2);
+  double quadrant = k - 4.0 * roundNearest((k - 1.5) * 0.25);   // 0..3
+  double sq = (quadrant == 1.0 || quadrant == 3.0) ? cr : sr;
+  double cq = (quadrant == 1.0 || quadrant == 3.0) ? sr : cr;
+
+  *s = (quadrant >= 2.0) ? -sq : sq;
+  *c = (quadrant == 1.0 || quadrant == 2.0) ? -cq : cq;
+}
+
+
+// atan2x() with selects, in degrees, [0, 360).
+static inline double atan2Lane(double y, double x) {
+  double ax = x < 0 ? -x : x;
+  double ay = y < 0 ? -y : y;
+  int steep = ay > ax;
+  double a = steep ? ax / ay : ay / ax;
+  int turn = a > TAN_PI_8;
+  a = turn ? (a - 1.0) / (a + 1.0) : a;
+  double r = atanKernel(a, a * a) + (turn ? M_PI / 4.0 : 0.0);
+
+  r = steep ? M_PI / 2.0 - r : r;
+  r = x < 0 ? M_PI - r : r;
+  r = y < 0 ? 2.0 * M_PI - r : r;
+  return r * (180.0 / M_PI);
+}
+
+
+// A series of table 47.A as doubles.  GCC sinks the int to double
+// conversion of a coefficient into the loop that uses it, where it
+// cannot be vectorised.  A missing sine or cosine column is zeros.
+typedef struct {
+  const LunarSeries *series;
+  double sine[LUNAR_TERMS];
+  double cosine[LUNAR_TERMS];
+  double mult[LUNAR_TERMS][4];
+} BatchSeries;
+
+// The combined table for complete tiers, and the two sorted ones that
+// truncated tiers run down as moonPosition() does
+static BatchSeries s_longitudeRange = { &lunarLongitudeRangeSeries };
+static BatchSeries s_longitude = { &lunarLongitudeSeries };
+static BatchSeries s_range = { &lunarRangeSeries };
+static int s_tables_ready;
+
+static void makeTable(BatchSeries *table) {
+  const LunarSeries *series = table->series;
+  for (int term = 0; term < series->count; term++) {
+    table->sine[term] = series->sine ? series->sine[term] : 0.0;
+    table->cosine[term] = series->cosine ? series->cosine[term] : 0.0;
+    table->mult[term][0] = series->D[term];
+    table->mult[term][1] = series->M[term];
+    table->mult[term][2] = series->Mm[term];
+    table->mult[term][3] = series->F[term];
+  }
+}
+
+
+static void makeTables(void) {
+  makeTable(&s_longitudeRange);
+  makeTable(&s_longitude);
+  makeTable(&s_range);
+  s_tables_ready = 1;
+}
+
+
+// The first terms of table, one term at a time across all instants
+static void sumSeries(const BatchSeries *table, int terms, double E[3][EPH_BATCH_BLOCK],
+                      const double *restrict D, const double *restrict M,
+                      const double *restrict Mm, const double *restrict F,
+                      double *restrict sigmaLongitude, double *restrict sigmaRange, int n) {
+  for (int term = 0; term < terms; term++) {
+    const double *arg = table->mult[term];
+    const double *e = E[table->series->E[term]];
+    double d = arg[0], m = arg[1], mm = arg[2], f = arg[3];
+    double cl = table->sine[term];
+    double cr = table->cosine[term];
+
+    for (int i = 0; i < n; i++) {
+      double s,c;
+      sincosLane(d * D[i] + m * M[i] + mm * Mm[i] + f * F[i], &s, &c);
+      sigmaLongitude[i] += cl * e[i] * s;
+      sigmaRange[i]     += cr * e[i] * c;
+    }
+  }
+}
+
+
+static void moonBlock(const double *restrict T, double *restrict longitude,
+                      double *restrict range, double *restrict ra, int n) {
+  double L[EPH_BATCH_BLOCK], D[EPH_BATCH_BLOCK], M[EPH_BATCH_BLOCK];
+  double Mm[EPH_BATCH_BLOCK], F[EPH_BATCH_BLOCK];
+  double E[3][EPH_BATCH_BLOCK];     // E^0, E^1, E^2
+  double sigmaLongitude[EPH_BATCH_BLOCK], sigmaRange[EPH_BATCH_BLOCK];
+  double cosObliquity,sinObliquity;
+  const LunarTier *tier = &lunarTiers[lunarPrecision];
+
+  sincosx(radians(obliquityE), &sinObliquity, &cosObliquity);
+
+  for (int i = 0; i < n; i++) {
+    L[i]  = moonMeanLongitude(T[i]);
+    D[i]  = reduceDegrees(moonMeanElongation(T[i]));
+    M[i]  = reduceDegrees(sunMeanAnomaly(T[i]));
+    Mm[i] = reduceDegrees(moonMeanAnomaly(T[i]));
+    F[i]  = reduceDegrees(moonArgLatitude(T[i]));
+    E[0][i] = 1.0;
+    E[1][i] = Eccentricity(T[i]);
+    E[2][i] = E[1][i] * E[1][i];
+    sigmaLongitude[i] = 0.0;
+    sigmaRange[i] = 0.0;
+  }
+
+  // The terms of the tier, as moonPosition() sums them
+  if (lunarTierComplete(tier)) {
+    sumSeries(&s_longitudeRange, s_longitudeRange.series->count, E, D, M, Mm, F,
+              sigmaLongitude, sigmaRange, n);
+  } else {
+    sumSeries(&s_longitude, tier->longitude, E, D, M, Mm, F, sigmaLongitude, sigmaRange, n);
+    sumSeries(&s_range, tier->range, E, D, M, Mm, F, sigmaLongitude, sigmaRange, n);
+  }
+
+  for (int i = 0; i < n; i++) {
+    double s1,s2,s3,c,lambda,sl,cl;
+    sincosLane(reduceDegrees(a1a + a1b * T[i]), &s1, &c);
+    sincosLane(reduceDegrees(L[i]) - F[i], &s2, &c);
+    sincosLane(reduceDegrees(a2a + a2b * T[i]), &s3, &c);
+    lambda = L[i] + (sigmaLongitude[i] + 3958.0 * s1 + 1962.0 * s2 + 318.0 * s3) / 1000000.0;
+
+    longitude[i] = lambda - 360.0 * roundNearest(lambda / 360.0 - 0.5);
+    range[i] = 0.62137119 * (385000.56 + (sigmaRange[i] / 1000.0));
+
+    sincosLane(reduceDegrees(lambda), &sl, &cl);
+    ra[i] = atan2Lane(sl * cosObliquity, cl);
+  }
+}
+
+
+void moonPositionBatch(const double *T, double *longitude, double *range,
+                       double *ra, int count) {
+  if (!s_tables_ready) {
+    makeTables();
+  }
+  for (int start = 0; start < count; start += EPH_BATCH_BLOCK) {
+    int n = count - start < EPH_BATCH_BLOCK ? count - start : EPH_BATCH_BLOCK;
+    moonBlock(T + start, longitude + start, range + start, ra + start, n);
+  }
+}
+
+#else
+
+// Scalar fallback, reusing the code the face already links.
+void moonPositionBatch(const double *T, double *longitude, double *range,
+                       double *ra, int count) {
+  MoonPosition pos;
+
+  for (int i = 0; i < count; i++) {
+    moonPosition(T[i], &pos);
+    longitude[i] = pos.longitude;
+    range[i] = pos.range;
+    ra[i] = moonRA(pos.longitude);
+  }
+}
+
+#endif
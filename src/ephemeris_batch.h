@@ -0,0 +1,21 @@
+#pragma once
+/*
+ * ephemeris_batch.h
+ * Moon position for many instants in one call, for searches, trails
+ * and time-lapse.
+ *
+ * Inputs and outputs are separate arrays (struct of arrays).  On hosts
+ * with SIMD the series are evaluated term by term across a block of
+ * instants so that the compiler vectorises the inner loops; elsewhere
+ * (the watch) each instant goes through moonPosition() and moonRA().
+ * Both sum the terms of the tier in lunarPrecision; host/batch_check
+ * compares them in every tier.
+ */
+
+// Instants handled together by the vector kernel.
+#define EPH_BATCH_BLOCK 32
+
+// T in Julian centuries (see JDtoT()).  longitude and ra in degrees
+// [0, 360), range in miles, as moonPosition() and moonRA() return.
+void moonPositionBatch(const double *T, double *longitude, double *range,
+                       double *ra, int count);
@@ -0,0 +1,128 @@
+/*
+ * ephemeris_cache.c
+ * Chebyshev fit and evaluation for the ephemeris cache, see
+ * ephemeris_cache.h.
+ * Numerical Recipes - section 5.8, Chebyshev Approximation
+ */
+
+#include "ephemeris_cache.h"
+#include "ephemeris.h"
+
+
+// Julian centuries since J2000.0, as DateToJD() and JDtoT() give.
+static double unixToT(double t) {
+  return (t - EPOCH_J2000_UNIX) / 86400.0 / 36525.0;
+}
+
+
+// Make a row of angles continuous so that it can be fitted.
+static void unwrapDegrees(double *row) {
+  for (int k = 1; k < EPH_CACHE_TERMS; k++) {
+    while (row[k] - row[k - 1] > 180.0) {
+      row[k] -= 360.0;
+    }
+    while (row[k] - row[k - 1] < -180.0) {
+      row[k] += 360.0;
+    }
+  }
+}
+
+
+static void fitWindow(EphemerisCache *cache, time_t start) {
+  double samples[EPH_CACHE_QUANTITIES][EPH_CACHE_TERMS];
+  double half = EPH_CACHE_WINDOW / 2.0;
+  double s,c;
+  MoonPosition moon;
+  Epoch epoch;
+
+  // Evaluate everything at the Chebyshev nodes of the window
+  for (int k = 0; k < EPH_CACHE_TERMS; k++) {
+    sincosx(M_PI * (k + 0.5) / EPH_CACHE_TERMS, &s, &c);
+    epochFromT(&epoch, unixToT(start + half + half * c));
+    moonPositionAt(&epoch, &moon);
+    samples[EPH_CACHE_LONGITUDE][k] = moon.longitude;
+    samples[EPH_CACHE_RANGE][k] = moon.range;
+    samples[EPH_CACHE_MOON_RA][k] = moonRA(moon.longitude);
+    samples[EPH_CACHE_SUN_RA][k] = sunRAAt(&epoch);
+  }
+  unwrapDegrees(samples[EPH_CACHE_LONGITUDE]);
+  unwrapDegrees(samples[EPH_CACHE_MOON_RA]);
+  unwrapDegrees(samples[EPH_CACHE_SUN_RA]);
+
+  for (int q = 0; q < EPH_CACHE_QUANTITIES; q++) {
+    for (int j = 0; j < EPH_CACHE_TERMS; j++) {
+      double sum = 0.0;
+      for (int k = 0; k < EPH_CACHE_TERMS; k++) {
+        sincosx(M_PI * j * (k + 0.5) / EPH_CACHE_TERMS, &s, &c);
+        sum += samples[q][k] * c;
+      }
+      cache->coefficients[q][j] = 2.0 * sum / EPH_CACHE_TERMS;
+    }
+  }
+
+  cache->start = start;
+  cache->valid = true;
+  cache->fits++;
+}
+
+
+// Clenshaw's recurrence, x in [-1, 1].
+static double evaluate(const double *c, double x) {
+  double b1 = 0.0;
+  double b2 = 0.0;
+
+  for (int j = EPH_CACHE_TERMS - 1; j > 0; j--) {
+    double b0 = 2.0 * x * b1 - b2 + c[j];
+    b2 = b1;
+    b1 = b0;
+  }
+  return x * b1 - b2 + 0.5 * c[0];
+}
+
+
+// The derivative of the same sum, d/dx.  T_j'(x) = j U_j-1(x), and
+// Clenshaw's recurrence for a sum of U_k leaves it in b0.
+static double evaluateDerivative(const double *c, double x) {
+  double b1 = 0.0;
+  double b2 = 0.0;
+
+  for (int j = EPH_CACHE_TERMS - 1; j > 0; j--) {
+    double b0 = 2.0 * x * b1 - b2 + j * c[j];
+    b2 = b1;
+    b1 = b0;
+  }
+  return b1;
+}
+
+
+void ephemerisCacheInit(EphemerisCache *cache) {
+  cache->valid = false;
+  cache->start = 0;
+  cache->fits = 0;
+}
+
+
+bool ephemerisCacheCovers(const EphemerisCache *cache, time_t t) {
+  return cache->valid && t >= cache->start && t < cache->start + EPH_CACHE_WINDOW;
+}
+
+
+void ephemerisCacheGet(EphemerisCache *cache, time_t t, CachedEphemeris *out) {
+  if (!ephemerisCacheCovers(cache, t)) {
+    // Windows are aligned so that neighbouring ticks share them
+    fitWindow(cache, t - (t % EPH_CACHE_WINDOW + EPH_CACHE_WINDOW) % EPH_CACHE_WINDOW);
+  }
+
+  double half = EPH_CACHE_WINDOW / 2.0;
+  double x = ((double)(t - cache->start) - half) / half;
+
+  out->longitude = normDegrees(evaluate(cache->coefficients[EPH_CACHE_LONGITUDE], x));
+  out->range = evaluate(cache->coefficients[EPH_CACHE_RANGE], x);
+  out->moonRA = normDegrees(evaluate(cache->coefficients[EPH_CACHE_MOON_RA], x));
+  out->sunRA = normDegrees(evaluate(cache->coefficients[EPH_CACHE_SUN_RA], x));
+
+  // x runs over the window in half of it
+  double perDay = 86400.0 / half;
+  out->longitudeRate = evaluateDerivative(cache->coefficients[EPH_CACHE_LONGITUDE], x) * perDay;
+  out->rangeRate = evaluateDerivative(cache->coefficients[EPH_CACHE_RANGE], x) * perDay;
+}
@@ -0,0 +1,49 @@
+#pragma once
+/*
+ * ephemeris_cache.h
+ * Chebyshev approximation of the slowly changing ephemeris values.
+ *
+ * The moon's longitude, range and right ascension (and the sun's right
+ * ascension) are fitted over a window of EPH_CACHE_WINDOW seconds from
+ * EPH_CACHE_TERMS full evaluations.  Any time inside the window is then
+ * answered with a Clenshaw sum of EPH_CACHE_TERMS multiply-adds per
+ * value, and the longitude and range rates with one more each, from
+ * the derivative of the fitted polynomial.  A time outside the window,
+ * whether it expired or the clock jumped, refits the cache first.
+ */
+
+#include <stdbool.h>
+#include <time.h>
+
+#define EPH_CACHE_WINDOW (4 * 60 * 60)
+#define EPH_CACHE_TERMS  8
+
+enum {
+  EPH_CACHE_LONGITUDE,
+  EPH_CACHE_RANGE,
+  EPH_CACHE_MOON_RA,
+  EPH_CACHE_SUN_RA,
+  EPH_CACHE_QUANTITIES
+};
+
+typedef struct {
+  bool valid;
+  time_t start;          // window is [start, start + EPH_CACHE_WINDOW)
+  unsigned int fits;     // number of refits so far
+  double coefficients[EPH_CACHE_QUANTITIES][EPH_CACHE_TERMS];
+} EphemerisCache;
+
+typedef struct {
+  double longitude;      // degrees, [0, 360)
+  double range;          // miles
+  double moonRA;         // degrees, [0, 360)
+  double sunRA;          // degrees, [0, 360)
+  double longitudeRate;  // degrees per day
+  double rangeRate;      // miles per day
+} CachedEphemeris;
+
+void ephemerisCacheInit(EphemerisCache *cache);
+void ephemerisCacheGet(EphemerisCache *cache, time_t t, CachedEphemeris *out);
+
+// Whether ephemerisCacheGet() can answer for t without a refit.
+bool ephemerisCacheCovers(const EphemerisCache *cache, time_t t);
@@ -0,0 +1,147 @@
+/*
+ * ephemeris_feed.c
+ * Windows of Chebyshev coefficients from the phone, see
+ * ephemeris_feed.h.
+ * Numerical Recipes - section 5.8, Chebyshev Approximation
+ */
+
+#include "ephemeris_feed.h"
+#include "trig.h"
+
+// Fraction bits of x in the integer Clenshaw sum
+#define FEED_X_BITS 24
+
+
+static int32_t getInt32(const uint8_t *p) {
+  return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+
+static const EphemerisFeedWindow *covering(const EphemerisFeed *feed, time_t t) {
+  for (int i = 0; i < EPH_FEED_WINDOWS; i++) {
+    const EphemerisFeedWindow *w = &feed->windows[i];
+    if (w->start != 0 && t >= w->start && t < (time_t)w->start + EPH_CACHE_WINDOW) {
+      return w;
+    }
+  }
+  return NULL;
+}
+
+
+void ephemerisFeedInit(EphemerisFeed *feed) {
+  for (int i = 0; i < EPH_FEED_WINDOWS; i++) {
+    feed->windows[i].start = 0;
+  }
+  feed->chunks = 0;
+}
+
+
+bool ephemerisFeedReceive(EphemerisFeed *feed, const uint8_t *chunk, uint16_t length) {
+  if (length != EPH_FEED_CHUNK_SIZE || chunk[0] != EPH_FEED_VERSION ||
+      chunk[1] >= EPH_FEED_WINDOWS || chunk[2] > EPH_FEED_WINDOWS) {
+    return false;
+  }
+
+  // Each window has the slot of its start, so a day of them fills every
+  // slot once and a new one replaces the one a day older
+  int32_t start = getInt32(chunk + 4);
+  EphemerisFeedWindow *w = &feed->windows[((uint32_t)start / EPH_CACHE_WINDOW) % EPH_FEED_WINDOWS];
+  const uint8_t *p = chunk + 4;
+  w->start = start;
+  for (int q = 0; q < EPH_CACHE_QUANTITIES; q++) {
+    for (int j = 0; j < EPH_CACHE_TERMS; j++) {
+      p += 4;
+      w->coefficients[q][j] = getInt32(p);
+    }
+  }
+  feed->chunks++;
+  return true;
+}
+
+
+time_t ephemerisFeedEnd(const EphemerisFeed *feed) {
+  time_t end = 0;
+  for (int i = 0; i < EPH_FEED_WINDOWS; i++) {
+    time_t start = feed->windows[i].start;
+    if (start != 0 && start + EPH_CACHE_WINDOW > end) {
+      end = start + EPH_CACHE_WINDOW;
+    }
+  }
+  return end;
+}
+
+
+bool ephemerisFeedLoad(const EphemerisFeed *feed, time_t t, EphemerisCache *cache) {
+  const EphemerisFeedWindow *w = covering(feed, t);
+  if (w == NULL) {
+    return false;
+  }
+
+  for (int j = 0; j < EPH_CACHE_TERMS; j++) {
+    cache->coefficients[EPH_CACHE_LONGITUDE][j] =
+      (double)w->coefficients[EPH_CACHE_LONGITUDE][j] / EPH_FEED_ANGLE_UNITS;
+    cache->coefficients[EPH_CACHE_RANGE][j] =
+      (double)w->coefficients[EPH_CACHE_RANGE][j] / EPH_FEED_RANGE_UNITS;
+    cache->coefficients[EPH_CACHE_MOON_RA][j] =
+      (double)w->coefficients[EPH_CACHE_MOON_RA][j] / EPH_FEED_ANGLE_UNITS;
+    cache->coefficients[EPH_CACHE_SUN_RA][j] =
+      (double)w->coefficients[EPH_CACHE_SUN_RA][j] / EPH_FEED_ANGLE_UNITS;
+  }
+  cache->start = w->start;
+  cache->valid = true;
+  return true;
+}
+
+
+// Clenshaw's recurrence as in ephemeris_cache.c, x in [-1, 1] with
+// FEED_X_BITS fraction bits, result in the coefficients' units.
+static int64_t evaluateFixed(const int32_t *c, int64_t x) {
+  int64_t b1 = 0;
+  int64_t b2 = 0;
+
+  for (int j = EPH_CACHE_TERMS - 1; j > 0; j--) {
+    int64_t b0 = ((2 * x * b1) >> FEED_X_BITS) - b2 + c[j];
+    b2 = b1;
+    b1 = b0;
+  }
+  return ((x * b1) >> FEED_X_BITS) - b2 + c[0] / 2;
+}
+
+
+// Its derivative, d/dx, as evaluateDerivative() in ephemeris_cache.c
+static int64_t evaluateFixedDerivative(const int32_t *c, int64_t x) {
+  int64_t b1 = 0;
+  int64_t b2 = 0;
+
+  for (int j = EPH_CACHE_TERMS - 1; j > 0; j--) {
+    int64_t b0 = ((2 * x * b1) >> FEED_X_BITS) - b2 + (int64_t)j * c[j];
+    b2 = b1;
+    b1 = b0;
+  }
+  return b1;
+}
+
+
+static int32_t angleFixed(int64_t value) {
+  return (int32_t)((value * EPH_TRIG_MAX_ANGLE / (360LL * EPH_FEED_ANGLE_UNITS)) &
+                   (EPH_TRIG_MAX_ANGLE - 1));
+}
+
+
+bool ephemerisFeedGetFixed(const EphemerisFeed *feed, time_t t, FeedEphemerisFixed *out) {
+  const EphemerisFeedWindow *w = covering(feed, t);
+  if (w == NULL) {
+    return false;
+  }
+
+  int64_t x = (((int64_t)(t - w->start) * 2 - EPH_CACHE_WINDOW) << FEED_X_BITS) / EPH_CACHE_WINDOW;
+
+  out->moonRA = angleFixed(evaluateFixed(w->coefficients[EPH_CACHE_MOON_RA], x));
+  out->sunRA = angleFixed(evaluateFixed(w->coefficients[EPH_CACHE_SUN_RA], x));
+  out->range = (int32_t)(evaluateFixed(w->coefficients[EPH_CACHE_RANGE], x) * 1609344 /
+                         (1000LL * EPH_FEED_RANGE_UNITS));
+  // x moves 2 / EPH_CACHE_WINDOW a second
+  out->rangeRate = (int32_t)(evaluateFixedDerivative(w->coefficients[EPH_CACHE_RANGE], x) *
+                             1609344 * 2 * 86400 / (1000LL * EPH_FEED_RANGE_UNITS * EPH_CACHE_WINDOW));
+  return true;
+}
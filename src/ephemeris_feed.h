@@ -0,0 +1,67 @@
+#pragma once
+/*
+ * ephemeris_feed.h
+ * Ephemeris windows computed on the phone.
+ *
+ * pebble-js-app.js fits the same Chebyshev windows as ephemeris_cache.h,
+ * aligned to EPH_CACHE_WINDOW, from the end of those the watch holds, or
+ * the one holding now, to EPH_FEED_WINDOWS of them from now, and sends
+ * one window per AppMessage.  Coefficients travel as int32 in
+ * fixed units: angles in EPH_FEED_ANGLE_UNITS per degree, the range in
+ * EPH_FEED_RANGE_UNITS per mile.  A window covering the time asked for
+ * stands in for the series; without one the watch computes as before.
+ *
+ * The double build copies a window into its EphemerisCache, so frames
+ * go through ephemerisCacheGet() as usual and never refit.  The fixed
+ * build sums the window in integers with ephemerisFeedGetFixed().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "ephemeris_cache.h"
+
+// 24 hours of windows
+#define EPH_FEED_WINDOWS (24 * 60 * 60 / EPH_CACHE_WINDOW)
+
+#define EPH_FEED_VERSION     1
+#define EPH_FEED_ANGLE_UNITS 1000000
+#define EPH_FEED_RANGE_UNITS 1000
+
+// Chunk layout, little endian: version, index, count and a zero byte,
+// then the window's start and its coefficients as int32, in the order
+// of EphemerisCache.coefficients
+#define EPH_FEED_CHUNK_SIZE (4 + 4 + 4 * EPH_CACHE_QUANTITIES * EPH_CACHE_TERMS)
+
+// One window as received, also the layout it is saved in
+typedef struct {
+  int32_t start;         // 0 if the slot is empty
+  int32_t coefficients[EPH_CACHE_QUANTITIES][EPH_CACHE_TERMS];
+} EphemerisFeedWindow;
+
+typedef struct {
+  EphemerisFeedWindow windows[EPH_FEED_WINDOWS];
+  unsigned int chunks;   // received so far
+} EphemerisFeed;
+
+typedef struct {
+  int32_t moonRA;        // [0, EPH_TRIG_MAX_ANGLE)
+  int32_t sunRA;         // [0, EPH_TRIG_MAX_ANGLE)
+  int32_t range;         // meters
+  int32_t rangeRate;     // meters per day
+} FeedEphemerisFixed;
+
+void ephemerisFeedInit(EphemerisFeed *feed);
+
+// Stores a chunk as sent by pebble-js-app.js.  Returns false if it is
+// not one, as for the zeroed initial value AppSync reports.
+bool ephemerisFeedReceive(EphemerisFeed *feed, const uint8_t *chunk, uint16_t length);
+
+// End of the last window held, 0 if there is none.
+time_t ephemerisFeedEnd(const EphemerisFeed *feed);
+
+// Puts the window covering t into cache.  Returns false if none does.
+bool ephemerisFeedLoad(const EphemerisFeed *feed, time_t t, EphemerisCache *cache);
+
+// Values at t in integers.  Returns false if no window covers t.
+bool ephemerisFeedGetFixed(const EphemerisFeed *feed, time_t t, FeedEphemerisFixed *out);
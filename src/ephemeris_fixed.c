@@ -0,0 +1,246 @@
+/*
+ * ephemeris_fixed.c
+ * The routines of ephemeris.c in integer arithmetic, see
+ * ephemeris_fixed.h.
+ *
+ * Every fundamental argument is carried as a 32 bit binary angle
+ * (2^32 to the turn), so the integer multiples in the term tables
+ * wrap around the circle for free.  Angles are rounded to
+ * EPH_TRIG_MAX_ANGLE units only where they go into a table lookup.
+ * Series sums are kept in 64 bits: coefficient * E^n (Q16) * sin (Q16).
+ */
+
+#include "ephemeris_fixed.h"
+#include "lunar_terms.h"
+
+#define J2000_UNIX      946728000     // 2000-01-01 12:00 UTC, JD 2451545.0
+#define SECONDS_PER_DAY 86400
+#define TURN48          281474976710656.0
+#define TURN32          4294967296.0
+
+// Constants in the fixed point scales used below.
+#define COS_OBLIQUITY   60127         // cos(23.4392911 deg), Q16
+#define UDEG_TO_ANGLE   781875        // 1e-6 deg in 2^-32 turns, Q16
+#define E_PER_DAY       19389214      // 0.002516 / 36525 days, Q48
+#define SUN_CENTER_1    22846840      // 1.915 deg in 2^-32 turns
+#define SUN_CENTER_2    238609        // 0.020 deg in 2^-32 turns
+#define MEAN_DISTANCE   385000560     // meters
+
+// An angle polynomial a + b * T + c * T^2, in degrees and Julian
+// centuries, in the form evaluated by fixedAngle().
+typedef struct {
+  uint64_t base;       // 2^-48 turn
+  uint64_t perDay;     // 2^-48 turn, whole turns removed
+  uint64_t perSecond;  // 2^-48 turn
+  int32_t perT2;       // 2^-32 turn
+} FixedArgument;
+
+// Folded into integers by the compiler, nothing here runs on the watch.
+#define FIXED_ARG(a, b, c) { \
+  (uint64_t)((a) / 360.0 * TURN48), \
+  (uint64_t)(((b) / 36525.0 / 360.0 \
+              - (int64_t)((b) / 36525.0 / 360.0)) * TURN48), \
+  (uint64_t)((b) / 36525.0 / SECONDS_PER_DAY / 360.0 * TURN48), \
+  (int32_t)((c) / 360.0 * TURN32) }
+
+// Meeus - Astronomical Algorithms - formulae 47.1 to 47.5
+static const FixedArgument moonMeanLongitudeArg  = FIXED_ARG(218.3164477, 481267.88123421, -0.0015786);
+static const FixedArgument moonMeanElongationArg = FIXED_ARG(297.8501921, 445267.1114034,  -0.0018819);
+static const FixedArgument sunMeanAnomalyArg     = FIXED_ARG(357.5291092, 35999.0502909,   -0.0001536);
+static const FixedArgument moonMeanAnomalyArg    = FIXED_ARG(134.9633964, 477198.8675055,   0.0087414);
+static const FixedArgument moonArgLatitudeArg    = FIXED_ARG(93.2720950,  483202.0175233,  -0.0036539);
+
+// Daily motions of D, M, M' and F in radians, Q16, for the rates
+#define FIXED_RATE(degrees) ((int32_t)((degrees) * 3.14159265358979 / 180.0 * 65536.0 + 0.5))
+static const int32_t rateD  = FIXED_RATE(LUNAR_D_RATE);
+static const int32_t rateM  = FIXED_RATE(LUNAR_M_RATE);
+static const int32_t rateMm = FIXED_RATE(LUNAR_MM_RATE);
+static const int32_t rateF  = FIXED_RATE(LUNAR_F_RATE);
+#define L_RATE_UDEG     ((int64_t)(LUNAR_L_RATE * 1000000.0 + 0.5))
+
+// Venus, Jupiter and flattening arguments A1, A2, A3
+static const FixedArgument adjustment1 = FIXED_ARG(119.75, 131.849,    0.0);
+static const FixedArgument adjustment2 = FIXED_ARG(53.09,  479264.290, 0.0);
+static const FixedArgument adjustment3 = FIXED_ARG(313.45, 481266.484, 0.0);
+
+// Low precision solar longitude, as sunRA() in ephemeris.c
+static const FixedArgument sunMeanLongitude = FIXED_ARG(280.461, 0.9856474 * 36525.0, 0.0);
+
+// Meeus - Astronomical Algorithms - formula 12.4
+static const FixedArgument siderealTime = FIXED_ARG(280.46061837, 360.98564736629 * 36525.0, 0.000387933);
+
+
+typedef struct {
+  int32_t days;        // whole days since J2000.0
+  int32_t seconds;     // [0, 86400)
+  int32_t T2;          // T * T, Q16
+} FixedEpoch;
+
+
+static void fixedEpoch(time_t t, FixedEpoch *epoch) {
+  int32_t s = (int32_t)(t - J2000_UNIX);
+
+  epoch->days = s / SECONDS_PER_DAY;
+  epoch->seconds = s % SECONDS_PER_DAY;
+  if (epoch->seconds < 0) {
+    epoch->seconds += SECONDS_PER_DAY;
+    epoch->days -= 1;
+  }
+  epoch->T2 = (int32_t)((((int64_t)epoch->days * epoch->days) << 16)
+                        / (36525LL * 36525LL));
+}
+
+
+// Unsigned arithmetic wraps modulo 2^64, a whole number of turns.
+static uint32_t fixedAngle(const FixedArgument *a, const FixedEpoch *epoch) {
+  uint64_t p = a->base
+               + a->perDay * (uint64_t)(int64_t)epoch->days
+               + a->perSecond * (uint64_t)epoch->seconds;
+  return (uint32_t)(p >> 16) + (uint32_t)(((int64_t)a->perT2 * epoch->T2) >> 16);
+}
+
+
+// Round a binary angle to EPH_TRIG_MAX_ANGLE units.
+static int32_t trigAngle(uint32_t a) {
+  return (int32_t)(((a + 0x8000) >> 16) & (EPH_TRIG_MAX_ANGLE - 1));
+}
+
+
+// Sum of 1e-6 degree coefficients (scaled by 2^32) to a binary angle.
+static int32_t sumToAngle(int64_t sum) {
+  return (int32_t)(((sum >> 16) * UDEG_TO_ANGLE) >> 32);
+}
+
+
+// Daily motion of a term's argument, radians Q16
+static int32_t termRate(const LunarSeries *series, int term) {
+  return series->D[term] * rateD + series->M[term] * rateM +
+         series->Mm[term] * rateMm + series->F[term] * rateF;
+}
+
+
+// A coefficient times E^n times a Q16 sine or cosine and a Q16 rate,
+// Q32 like the sums.  The coefficient and E are taken to whole units
+// first so the product stays within 64 bits.
+static int64_t rateTerm(int32_t coefficient, int64_t e, int32_t trig, int32_t rate) {
+  return (((int64_t)coefficient * e) >> 16) * trig * rate;
+}
+
+
+static int64_t additive(int32_t coefficient, uint32_t a) {
+  return (int64_t)coefficient * 0x10000 * sinLookup(trigAngle(a));
+}
+
+
+// The rates differentiate the sums term by term, as moonPositionAt()
+// does, from the other half of each sine and cosine pair.
+void moonPositionFixed(time_t t, MoonPositionFixed *pos) {
+  FixedEpoch epoch;
+  int64_t sigmaLongitude = 0;
+  int64_t sigmaLatitude = 0;
+  int64_t sigmaRange = 0;
+  int64_t rateLongitude = 0;
+  int64_t rateRange = 0;
+
+  fixedEpoch(t, &epoch);
+
+  int32_t E = 0x10000 - (int32_t)(((int64_t)epoch.days * E_PER_DAY) >> 32);
+  int32_t Epow[3] = { 0x10000, E, (int32_t)(((int64_t)E * E) >> 16) };
+  uint32_t L  = fixedAngle(&moonMeanLongitudeArg, &epoch);
+  uint32_t D  = fixedAngle(&moonMeanElongationArg, &epoch);
+  uint32_t M  = fixedAngle(&sunMeanAnomalyArg, &epoch);
+  uint32_t Mm = fixedAngle(&moonMeanAnomalyArg, &epoch);
+  uint32_t F  = fixedAngle(&moonArgLatitudeArg, &epoch);
+  uint32_t A1 = fixedAngle(&adjustment1, &epoch);
+  uint32_t A2 = fixedAngle(&adjustment2, &epoch);
+  uint32_t A3 = fixedAngle(&adjustment3, &epoch);
+
+  const LunarTier *tier = &lunarTiers[lunarPrecision];
+  const LunarSeries *series;
+  if (lunarTierComplete(tier)) {
+    series = &lunarLongitudeRangeSeries;
+    for(int term=0;term < series->count;term++){
+      int64_t e = Epow[series->E[term]];
+      int32_t angle = trigAngle(series->D[term] * D + series->M[term] * M +
+                                series->Mm[term] * Mm + series->F[term] * F);
+      int32_t s = sinLookup(angle);
+      int32_t c = cosLookup(angle);
+      int32_t rate = termRate(series, term);
+      sigmaLongitude += series->sine[term] * e * s;
+      sigmaRange     += series->cosine[term] * e * c;
+      rateLongitude  += rateTerm(series->sine[term], e, c, rate);
+      rateRange      -= rateTerm(series->cosine[term], e, s, rate);
+    }
+  } else {
+    series = &lunarLongitudeSeries;
+    for(int term=0;term < tier->longitude;term++){
+      int64_t e = Epow[series->E[term]];
+      int32_t angle = trigAngle(series->D[term] * D + series->M[term] * M +
+                                series->Mm[term] * Mm + series->F[term] * F);
+      sigmaLongitude += series->sine[term] * e * sinLookup(angle);
+      rateLongitude  += rateTerm(series->sine[term], e, cosLookup(angle), termRate(series, term));
+    }
+    series = &lunarRangeSeries;
+    for(int term=0;term < tier->range;term++){
+      int64_t e = Epow[series->E[term]];
+      int32_t angle = trigAngle(series->D[term] * D + series->M[term] * M +
+                                series->Mm[term] * Mm + series->F[term] * F);
+      sigmaRange += series->cosine[term] * e * cosLookup(angle);
+      rateRange  -= rateTerm(series->cosine[term], e, sinLookup(angle), termRate(series, term));
+    }
+  }
+
+  series = &lunarLatitudeSeries;
+  for(int term=0;term < tier->latitude;term++){
+    int64_t e = Epow[series->E[term]];
+    int32_t angle = trigAngle(series->D[term] * D + series->M[term] * M +
+                              series->Mm[term] * Mm + series->F[term] * F);
+    sigmaLatitude += series->sine[term] * e * sinLookup(angle);
+  }
+
+  // Additive terms for Venus, Jupiter and the flattening of the earth
+  sigmaLongitude += additive(3958, A1) + additive(1962, L - F) + additive(318, A2);
+  sigmaLatitude  += additive(-2235, L) + additive(382, A3)
+                  + additive(175, A1 - F) + additive(175, A1 + F)
+                  + additive(127, L - Mm) + additive(-115, L + Mm);
+
+  pos->longitude = trigAngle(L + (uint32_t)sumToAngle(sigmaLongitude));
+  pos->latitude  = (sumToAngle(sigmaLatitude) + 0x8000) >> 16;
+  pos->range     = MEAN_DISTANCE + (int32_t)(sigmaRange >> 32);
+  pos->longitudeRate = (int32_t)(((L_RATE_UDEG + (rateLongitude >> 32)) * UDEG_TO_ANGLE) >> 32);
+  pos->rangeRate     = (int32_t)(rateRange >> 32);
+}
+
+
+// Right ascension of a point on the ecliptic, ignoring latitude.
+static int32_t eclipticRA(int32_t longitude) {
+  int32_t y = (int32_t)(((int64_t)sinLookup(longitude) * COS_OBLIQUITY) >> 16);
+  int32_t x = cosLookup(longitude);
+  return atan2Lookup(y, x);
+}
+
+
+int32_t moonRAFixed(int32_t longitude) {
+  return eclipticRA(longitude);
+}
+
+
+int32_t sunRAFixed(time_t t) {
+  FixedEpoch epoch;
+
+  fixedEpoch(t, &epoch);
+  uint32_t L = fixedAngle(&sunMeanLongitude, &epoch);
+  uint32_t g = fixedAngle(&sunMeanAnomalyArg, &epoch);
+  uint32_t lambda = L
+    + (uint32_t)(((int64_t)SUN_CENTER_1 * sinLookup(trigAngle(g))) >> 16)
+    + (uint32_t)(((int64_t)SUN_CENTER_2 * sinLookup(trigAngle(2 * g))) >> 16);
+  return eclipticRA(trigAngle(lambda));
+}
+
+
+int32_t greenwichSiderealTimeFixed(time_t t) {
+  FixedEpoch epoch;
+
+  fixedEpoch(t, &epoch);
+  return trigAngle(fixedAngle(&siderealTime, &epoch));
+}
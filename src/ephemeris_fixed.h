@@ -0,0 +1,38 @@
+#pragma once
+/*
+ * ephemeris_fixed.h
+ * Integer-only version of the ephemeris for watches without an FPU
+ * (aplite, diorite).  Built into the face in place of the double
+ * routines when LUNA_FIXED_POINT is defined, see wscript.
+ *
+ * Angles are in EPH_TRIG_MAX_ANGLE units throughout, the same units
+ * as the SDK's sin_lookup()/cos_lookup()/atan2_lookup().  Against the
+ * double path the angles stay within EPH_FIXED_MAX_ERROR_ARCMIN and the
+ * range within EPH_FIXED_MAX_ERROR_KM, and their rates within the same
+ * a day; host/fixed_check verifies that.
+ * Most of the right ascension difference is atan2Lookup() here, whose
+ * result is a whole EPH_TRIG_MAX_ANGLE unit (a third of an arcminute)
+ * read off an interpolated table.  The double path's sincosx() and
+ * atan2x() stay within 0.001" of the reference.
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include "trig.h"
+
+#define EPH_FIXED_MAX_ERROR_ARCMIN 3
+#define EPH_FIXED_MAX_ERROR_KM     2
+
+// Geocentric ecliptic position of the moon.
+typedef struct {
+  int32_t longitude;  // [0, EPH_TRIG_MAX_ANGLE)
+  int32_t latitude;   // signed, EPH_TRIG_MAX_ANGLE units
+  int32_t range;      // meters, center to center
+  int32_t longitudeRate;  // EPH_TRIG_MAX_ANGLE units per day
+  int32_t rangeRate;      // meters per day
+} MoonPositionFixed;
+
+void moonPositionFixed(time_t t, MoonPositionFixed *pos);
+int32_t moonRAFixed(int32_t longitude);
+int32_t sunRAFixed(time_t t);
+int32_t greenwichSiderealTimeFixed(time_t t);
@@ -0,0 +1,159 @@
+/*
+ * ephemeris_propagator.c
+ * Stepping the periodic terms by rotation, see ephemeris_propagator.h.
+ * Meeus - Astronomical Algorithms - chapter 47
+ */
+
+#include "ephemeris_propagator.h"
+
+// Where each group of terms starts in the arrays
+#define LATITUDE LUNAR_TERMS
+#define ADDITIVE (2 * LUNAR_TERMS)
+
+
+// Julian centuries since J2000.0, as DateToJD() and JDtoT() give.
+static double unixToT(double t) {
+  return (t - EPOCH_J2000_UNIX) / 86400.0 / 36525.0;
+}
+
+
+static double seriesArgument(const LunarSeries *series, int term,
+                             double D, double M, double Mm, double F) {
+  return series->D[term] * D + series->M[term] * M + series->Mm[term] * Mm + series->F[term] * F;
+}
+
+
+// Every term's argument at t, radians
+static void arguments(time_t t, int latitudeTerms, double *arg) {
+  Epoch epoch;
+  epochFromTime(&epoch, t);
+
+  double T  = epoch.T;
+  double L  = epoch.L;
+  double D  = epoch.D;
+  double M  = epoch.M;
+  double Mm = epoch.Mm;
+  double F  = epoch.F;
+  double A1 = radians(a1a + a1b * T);
+  double A2 = radians(a2a + a2b * T);
+  double A3 = radians(a3a + a3b * T);
+
+  for (int term = 0; term < LUNAR_TERMS; term++) {
+    arg[term] = seriesArgument(&lunarLongitudeRangeSeries, term, D, M, Mm, F);
+  }
+  for (int term = 0; term < latitudeTerms; term++) {
+    arg[LATITUDE + term] = seriesArgument(&lunarLatitudeSeries, term, D, M, Mm, F);
+  }
+
+  // Additive terms for Venus, Jupiter and the flattening of the earth,
+  // in the order moonPropagatorPosition() sums them
+  arg[ADDITIVE + 0] = A1;
+  arg[ADDITIVE + 1] = L - F;
+  arg[ADDITIVE + 2] = A2;
+  arg[ADDITIVE + 3] = L;
+  arg[ADDITIVE + 4] = A3;
+  arg[ADDITIVE + 5] = A1 - F;
+  arg[ADDITIVE + 6] = A1 + F;
+  arg[ADDITIVE + 7] = L - Mm;
+  arg[ADDITIVE + 8] = L + Mm;
+}
+
+
+static int used(const MoonPropagator *p, int term) {
+  return term < LATITUDE || term >= ADDITIVE || term - LATITUDE < p->latitudeTerms;
+}
+
+
+// The exact pairs at p->when, and each term's turn over the next step
+// taken from the arguments at both ends of it.
+static void anchor(MoonPropagator *p) {
+  double now[EPH_PROPAGATOR_TERMS];
+  double next[EPH_PROPAGATOR_TERMS];
+
+  p->latitudeTerms = lunarTiers[lunarPrecision].latitude;
+  arguments(p->when, p->latitudeTerms, now);
+  arguments(p->when + p->step, p->latitudeTerms, next);
+  for (int term = 0; term < EPH_PROPAGATOR_TERMS; term++) {
+    if (used(p, term)) {
+      sincosx(now[term], &p->sine[term], &p->cosine[term]);
+      sincosx(next[term] - now[term], &p->stepSine[term], &p->stepCosine[term]);
+    }
+  }
+  p->steps = 0;
+  p->anchors++;
+}
+
+
+void moonPropagatorStart(MoonPropagator *p, time_t t, int32_t step) {
+  p->when = t;
+  p->step = step;
+  p->anchors = 0;
+  anchor(p);
+}
+
+
+void moonPropagatorStep(MoonPropagator *p) {
+  p->when += p->step;
+  if (++p->steps >= EPH_PROPAGATOR_ANCHOR) {
+    anchor(p);
+    return;
+  }
+
+  for (int term = 0; term < EPH_PROPAGATOR_TERMS; term++) {
+    if (used(p, term)) {
+      double s = p->sine[term];
+      double c = p->cosine[term];
+      p->sine[term]   = s * p->stepCosine[term] + c * p->stepSine[term];
+      p->cosine[term] = c * p->stepCosine[term] - s * p->stepSine[term];
+    }
+  }
+}
+
+
+void moonPropagatorPosition(const MoonPropagator *p, MoonPosition *pos) {
+  const LunarSeries *series;
+  const double *s = p->sine;
+  const double *c = p->cosine;
+  double T = unixToT(p->when);
+  double sigmaLongitude = 0.0;
+  double sigmaLatitude = 0.0;
+  double sigmaRange = 0.0;
+  double rateLongitude = 0.0;
+  double rateRange = 0.0;
+
+  double E  = Eccentricity(T);
+  double Epow[3] = { 1.0, E, E * E };
+
+  series = &lunarLongitudeRangeSeries;
+  for (int term = 0; term < LUNAR_TERMS; term++) {
+    double e = Epow[series->E[term]];
+    double rate = lunarTermRate(series, term);
+    sigmaLongitude += series->sine[term] * e * s[term];
+    sigmaRange     += series->cosine[term] * e * c[term];
+    rateLongitude  += series->sine[term] * e * c[term] * rate;
+    rateRange      -= series->cosine[term] * e * s[term] * rate;
+  }
+
+  series = &lunarLatitudeSeries;
+  for (int term = 0; term < p->latitudeTerms; term++) {
+    double e = Epow[series->E[term]];
+    sigmaLatitude += series->sine[term] * e * s[LATITUDE + term];
+  }
+
+  s += ADDITIVE;
+  sigmaLongitude += 3958.0 * s[0]
+                  + 1962.0 * s[1]
+                  +  318.0 * s[2];
+  sigmaLatitude  += -2235.0 * s[3]
+                  +   382.0 * s[4]
+                  +   175.0 * s[5]
+                  +   175.0 * s[6]
+                  +   127.0 * s[7]
+                  -   115.0 * s[8];
+
+  pos->longitude = normDegrees(moonMeanLongitude(T) + sigmaLongitude / 1000000.0);
+  pos->latitude  = sigmaLatitude / 1000000.0;
+  pos->range     = 0.62137119 * (385000.56 + (sigmaRange / 1000.0));
+  pos->longitudeRate = LUNAR_L_RATE + rateLongitude / 1000000.0;
+  pos->rangeRate     = 0.62137119 * rateRange / 1000.0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+/*
+ * ephemeris_propagator.h
+ * The moon's position at evenly spaced instants without re-evaluating
+ * the series.
+ *
+ * Every periodic term of Meeus chapter 47 is an angle that turns at an
+ * almost constant rate.  The propagator keeps each term's sine and
+ * cosine, and the sine and cosine of how far it turns in one step, so
+ * moving on a step is one complex multiply per term and no sine or
+ * cosine is called.  Every EPH_PROPAGATOR_ANCHOR steps it is anchored
+ * again to the exact series, which bounds the drift of the rotations
+ * and of the rates themselves (the polynomials in T are not linear).
+ *
+ * Longitude and range always use all of table 47.A, latitude the terms
+ * of the built-in tier, so with a complete tier the positions match
+ * moonPosition(); host/propagator_check measures how closely.
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include "ephemeris.h"
+#include "lunar_terms.h"
+
+// Steps between exact evaluations
+#define EPH_PROPAGATOR_ANCHOR 32
+
+// Table 47.A, table 47.B and the nine additive arguments
+#define EPH_PROPAGATOR_TERMS (2 * LUNAR_TERMS + 9)
+
+typedef struct {
+  time_t when;                 // instant of the pairs below
+  int32_t step;                // seconds
+  int steps;                   // since the last anchor
+  int latitudeTerms;           // of table 47.B in use
+  unsigned int anchors;        // exact evaluations so far
+  double sine[EPH_PROPAGATOR_TERMS];
+  double cosine[EPH_PROPAGATOR_TERMS];
+  double stepSine[EPH_PROPAGATOR_TERMS];
+  double stepCosine[EPH_PROPAGATOR_TERMS];
+} MoonPropagator;
+
+// Anchors at t, then moonPropagatorStep() moves on step seconds at a time.
+void moonPropagatorStart(MoonPropagator *p, time_t t, int32_t step);
+void moonPropagatorStep(MoonPropagator *p);
+
+// Position at p->when, as moonPosition() gives it.
+void moonPropagatorPosition(const MoonPropagator *p, MoonPosition *pos);
@@ -0,0 +1,85 @@
+/*
+ * epoch.c
+ * Fundamental arguments and sidereal time for one instant, see epoch.h.
+ * Meeus - Astronomical Algorithms - chapters 12 and 47
+ */
+
+#include "epoch.h"
+#include "fastmath.h"
+#include "lunar_terms.h"
+
+#define DAYS_PER_CENTURY 36525.0
+
+
+// A polynomial in T, degrees, as in lunar_terms.h but with the linear
+// term applied to days.  Only the terms past it are evaluated in T.
+typedef struct {
+  double constant;
+  double daily;          // the coefficient of T over DAYS_PER_CENTURY
+  double T2, T3, T4;     // coefficients of T^2, T^3 and T^4
+} Argument;
+
+// Meeus - Astronomical Algorithms - formulae 47.1 to 47.5
+static const Argument s_moonMeanLongitude = { 218.3164477, LUNAR_L_RATE, -0.0015786, 1.0 / 538841.0, -1.0 / 65194000.0 };
+static const Argument s_moonMeanElongation = { 297.8501921, LUNAR_D_RATE, -0.0018819, 1.0 / 544868.0, -1.0 / 113065000.0 };
+static const Argument s_sunMeanAnomaly = { 357.5291092, LUNAR_M_RATE, -0.0001536, 1.0 / 24490000.0, 0.0 };
+static const Argument s_moonMeanAnomaly = { 134.9633964, LUNAR_MM_RATE, 0.0087414, 1.0 / 69699.0, -1.0 / 14712000.0 };
+static const Argument s_moonArgLatitude = { 93.2720950, LUNAR_F_RATE, -0.0036539, -1.0 / 3526000.0, 1.0 / 863310000.0 };
+
+// Meeus - Astronomical Algorithms - formula 12.4, without the whole
+// turn a day, which fill() adds for the fraction only
+static const Argument s_siderealTime = { 280.46061837, 0.98564736629, 0.000387933, -1.0 / 38710000.0, 0.0 };
+
+
+// Degrees, within a turn or so of [0, 360)
+static double argument(const Epoch *epoch, const Argument *a) {
+  double T = epoch->T;
+
+  return a->constant + normDegrees(a->daily * epoch->day) + a->daily * epoch->fraction
+         + T * T * (a->T2 + T * (a->T3 + T * a->T4));
+}
+
+
+static void fill(Epoch *epoch) {
+  epoch->T = (epoch->day + epoch->fraction) / DAYS_PER_CENTURY;
+  epoch->L  = radians(argument(epoch, &s_moonMeanLongitude));
+  epoch->D  = radians(argument(epoch, &s_moonMeanElongation));
+  epoch->M  = radians(argument(epoch, &s_sunMeanAnomaly));
+  epoch->Mm = radians(argument(epoch, &s_moonMeanAnomaly));
+  epoch->F  = radians(argument(epoch, &s_moonArgLatitude));
+
+  double E = Eccentricity(epoch->T);
+  epoch->Epow[0] = 1.0;
+  epoch->Epow[1] = E;
+  epoch->Epow[2] = E * E;
+
+  epoch->gst = normDegrees(argument(epoch, &s_siderealTime) + 360.0 * epoch->fraction);
+}
+
+
+void epochFromTime(Epoch *epoch, time_t t) {
+  int64_t seconds = (int64_t)t - EPOCH_J2000_UNIX;
+  int64_t day = seconds / 86400;
+  int64_t second = seconds % 86400;
+
+  if (second < 0) {
+    second += 86400;
+    day--;
+  }
+  epoch->day = (int32_t)day;
+  epoch->fraction = second / 86400.0;
+  fill(epoch);
+}
+
+
+void epochFromT(Epoch *epoch, double T) {
+  double days = T * DAYS_PER_CENTURY;
+  int32_t day = (int32_t)days;
+
+  if (day > days) {
+    day--;
+  }
+  epoch->day = day;
+  epoch->fraction = days - day;
+  fill(epoch);
+}
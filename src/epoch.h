@@ -0,0 +1,38 @@
+#pragma once
+/*
+ * epoch.h
+ * Everything the ephemeris needs to know about one instant.
+ *
+ * A frame, a cache fit or a search step builds one Epoch straight from
+ * its time_t and hands it to every routine it calls.  It replaces
+ * gmtime(), DateToJD() and JDtoT() at each of those, and each routine
+ * evaluating the fundamental arguments and sidereal time on its own.
+ * Time is held as whole days since J2000.0 plus the fraction of a day.
+ * The daily motions are reduced over the whole days, where whole turns
+ * drop out, and then the fraction adds a small angle, so no argument
+ * is formed from hundreds of thousands of degrees.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#define EPOCH_J2000_UNIX 946728000     // 2000-01-01 12:00 UTC, JD 2451545.0
+
+typedef struct {
+  int32_t day;           // whole days since J2000.0
+  double fraction;       // of a day since then, [0, 1)
+  double T;              // Julian centuries since J2000.0
+  // Meeus - Astronomical Algorithms - formulae 47.1 to 47.5, radians
+  double L;              // moon's mean longitude
+  double D;              // moon's mean elongation
+  double M;              // sun's mean anomaly
+  double Mm;             // moon's mean anomaly
+  double F;              // moon's argument of latitude
+  double Epow[3];        // 1, E and E * E, formula 47.6
+  double gst;            // Greenwich mean sidereal time, degrees
+} Epoch;
+
+void epochFromTime(Epoch *epoch, time_t t);
+
+// For callers that only have T, Julian centuries since J2000.0.
+void epochFromT(Epoch *epoch, double T);
@@ -0,0 +1,121 @@
+/*
+ * fastmath.c
+ * Range reduction and the fast trigonometry, see fastmath.h.
+ */
+
+#include "fastmath.h"
+
+// PI/2 split so that k * PIO2_HI is exact for |k| < 2^20 (Cody-Waite)
+#define PIO2_HI 1.5707963267341256
+#define PIO2_LO 6.0771005065061922e-11
+
+
+// Square root by Newton's method, seeded from the exponent: halving
+// the bit pattern of a float halves its exponent, which puts the first
+// guess within 4 %, and three steps take that to float precision.
+float sqrtx(const float num) {
+  union { float f; uint32_t i; } seed;
+
+  if (num <= 0.0f) {
+    return 0.0f;
+  }
+  seed.f = num;
+  seed.i = 0x1fbd1df5 + (seed.i >> 1);
+
+  float answer = seed.f;
+  answer = 0.5f * (answer + num / answer);
+  answer = 0.5f * (answer + num / answer);
+  answer = 0.5f * (answer + num / answer);
+  return answer;
+}
+
+
+double degrees(double d) {
+  return d * (180.0 / M_PI);
+}
+
+
+// d in degrees to radians, [0, 2 PI)
+double radians(double d) {
+  return normDegrees(d) * (M_PI / 180.0);
+}
+
+
+// [0, 360)
+double normDegrees(double d) {
+  d -= 360.0 * (int32_t)(d / 360.0);
+  return d < 0 ? d + 360.0 : d;
+}
+
+
+// [0, 2 PI)
+double normRadians(double d) {
+  d -= (2.0 * M_PI) * (int32_t)(d / (2.0 * M_PI));
+  return d < 0 ? d + 2.0 * M_PI : d;
+}
+
+
+// Sine and cosine of d (radians) from a single range reduction.
+// d is folded about the nearest multiple of PI/2 into [-PI/4, PI/4],
+// both kernels are evaluated there and the pair is then rotated back
+// by the quadrant.
+void sincosx(double d, double *s, double *c) {
+  double q = d * (2.0 / M_PI);
+  int32_t quadrant = (int32_t)(q < 0 ? q - 0.5 : q + 0.5);
+  double r = (d - quadrant * PIO2_HI) - quadrant * PIO2_LO;
+  double r2 = r * r;
+  double sr = sinKernel(r, r2);
+  double cr = cosKernel(r2);
+
+  switch (quadrant & 3) {
+    case 0: *s =  sr; *c =  cr; break;
+    case 1: *s =  cr; *c = -sr; break;
+    case 2: *s = -sr; *c = -cr; break;
+    default: *s = -cr; *c =  sr; break;
+  }
+}
+
+
+double sinx(double d) {
+  double s,c;
+  sincosx(d, &s, &c);
+  return s;
+}
+
+
+double cosx(double d) {
+  double s,c;
+  sincosx(d, &s, &c);
+  return c;
+}
+
+
+// Angle of (x, y) in radians, (-PI, PI] like atan2().  The pair is
+// folded into the first octant, and a ratio above tan(PI/8) is turned
+// back by PI/4 before the kernel.
+double atan2x(double y, double x) {
+  double ax = x < 0 ? -x : x;
+  double ay = y < 0 ? -y : y;
+  double lo = ay < ax ? ay : ax;
+  double hi = ay < ax ? ax : ay;
+  double a,r;
+
+  if (hi == 0.0) {
+    return 0.0;
+  }
+  a = lo / hi;
+  if (a > TAN_PI_8) {
+    a = (a - 1.0) / (a + 1.0);
+    r = M_PI / 4.0 + atanKernel(a, a * a);
+  } else {
+    r = atanKernel(a, a * a);
+  }
+
+  if (ay > ax) {
+    r = M_PI / 2.0 - r;
+  }
+  if (x < 0) {
+    r = M_PI - r;
+  }
+  return y < 0 ? -r : r;
+}
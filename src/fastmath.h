@@ -0,0 +1,50 @@
+#pragma once
+/*
+ * fastmath.h
+ * Floating point sine, cosine, arctangent and square root for the
+ * ephemeris, without libm.
+ *
+ * Angles are reduced to a quarter turn about the nearest multiple of
+ * PI/2 (or, for the arctangent, to an octant and then about tan(PI/8))
+ * and evaluated there with minimax polynomials; the coefficients come
+ * from tools/minimax.py.  The kernels are inline so that the batch
+ * code can use them in its vector lanes.
+ */
+
+#include <stdint.h>
+
+#ifndef M_PI
+  #define M_PI 3.1415926535897932384626433832795
+#endif
+
+// sin(r), |r| <= PI/4, |error| < 1.3e-9
+static inline double sinKernel(double r, double r2) {
+  return r * (0.99999998617934205 + r2 * (-0.16666636754299513
+           + r2 * (0.0083315846064880468 + r2 * -0.00019462116998329436)));
+}
+
+// cos(r), |r| <= PI/4, |error| < 5e-11
+static inline double cosKernel(double r2) {
+  return 0.99999999995260047 + r2 * (-0.49999999615433827
+           + r2 * (0.041666616739237876 + r2 * (-0.0013886619211006162
+           + r2 * 2.4379929432848316e-05)));
+}
+
+// atan(a), |a| <= tan(PI/8), |error| < 1.2e-10
+#define TAN_PI_8 0.41421356237309505
+
+static inline double atanKernel(double a, double a2) {
+  return a * (0.99999999627054481 + a2 * (-0.33333271105696211
+           + a2 * (0.19997023126305161 + a2 * (-0.14224160570780572
+           + a2 * (0.10480594848784247 + a2 * -0.058377884585161043)))));
+}
+
+double sinx(double d);
+double cosx(double d);
+void sincosx(double d, double *s, double *c);
+double atan2x(double y, double x);
+float sqrtx(const float num);
+double degrees(double d);
+double radians(double d);
+double normDegrees(double d);
+double normRadians(double d);
@@ -0,0 +1,71 @@
+/*
+ * format.c
+ * Integer formatters, see format.h.
+ */
+
+#include "format.h"
+
+
+static char *digits(char *str, uint32_t value) {
+  char reversed[10];
+  int n = 0;
+
+  do {
+    reversed[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (n > 0) {
+    *str++ = reversed[--n];
+  }
+  *str = '\0';
+  return str;
+}
+
+
+char *formatInt(char *str, int32_t value) {
+  if (value < 0) {
+    *str++ = '-';
+    return digits(str, -(uint32_t)value);
+  }
+  return digits(str, value);
+}
+
+
+char *formatTenths(char *str, int32_t tenths) {
+  uint32_t magnitude = tenths < 0 ? -(uint32_t)tenths : (uint32_t)tenths;
+
+  if (tenths < 0) {
+    *str++ = '-';
+  }
+  str = digits(str, magnitude / 10);
+  *str++ = '.';
+  *str++ = '0' + magnitude % 10;
+  *str = '\0';
+  return str;
+}
+
+
+char *formatClock(char *str, int32_t minutes) {
+  minutes %= 24 * 60;
+  if (minutes < 0) {
+    minutes += 24 * 60;
+  }
+  int hours = minutes / 60;
+  minutes %= 60;
+  *str++ = '0' + hours / 10;
+  *str++ = '0' + hours % 10;
+  *str++ = ':';
+  *str++ = '0' + minutes / 10;
+  *str++ = '0' + minutes % 10;
+  *str = '\0';
+  return str;
+}
+
+
+char *formatText(char *str, const char *text) {
+  while (*text) {
+    *str++ = *text++;
+  }
+  *str = '\0';
+  return str;
+}
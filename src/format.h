@@ -0,0 +1,25 @@
+#pragma once
+/*
+ * format.h
+ * Integer formatters for the face's text.
+ *
+ * Each writes at str and returns the end of what it wrote, with a
+ * terminating '\0' there, so that a line is built by chaining calls.
+ * Values are integers or fixed point, nothing goes through snprintf()
+ * or floating point.  Fractions are truncated towards zero, the steps
+ * secondsUntilChange() in schedule.h predicts.
+ */
+
+#include <stdint.h>
+
+// Decimal, "-" for negative values.
+char *formatInt(char *str, int32_t value);
+
+// Tenths as "12.3" or "-0.4".
+char *formatTenths(char *str, int32_t tenths);
+
+// A clock time as "07:05", minutes past midnight taken mod 24 hours.
+char *formatClock(char *str, int32_t minutes);
+
+// Copies text.
+char *formatText(char *str, const char *text);
@@ -6,759 +6,566 @@
 #include <pebble.h>
 #include <math.h>
 #include "luna.h"
+#include "ephemeris.h"
+#include "ephemeris_fixed.h"
+#include "ephemeris_cache.h"
+#include "ephemeris_feed.h"
+#include "format.h"
+#include "lunar_events.h"
+#include "profile.h"
+#include "schedule.h"
 
-int initialized = 0;  
-int updateCount = 0;
-float updateDivision;
 
 static Window *s_main_window;
-static BitmapLayer *s_canvas_layer;
-static TextLayer *s_text_layer;
-static TextLayer *s_text2_layer;
-static TextLayer *s_text3_layer;
-static TextLayer *s_text4_layer;
-static TextLayer *s_text5_layer;
-static TextLayer *s_battery_layer;
-struct tm *pt;
-time_t then;
-
-static GPath *s_luna_path;
-
-double moonRange;
-
-
-enum LocationKey {
-  KEY_LONGITUDE = 0x0,         // TUPLE_FLOAT
-  KEY_LATITUDE = 0x1,          // TUPLE_FLOAT
+static Layer *s_canvas_layer;
+static Layer *s_info_layer;
+
+// A string and where and how info_update_proc() draws it.  Only the
+// strings and the battery's colour change after main_window_load(), and
+// the info layer is only marked dirty when one does.
+typedef struct {
+  GRect box;
+  GFont font;
+  GColor color;
+  GTextAlignment alignment;
+  char text[24];
+} TextField;
+
+typedef enum {
+  FIELD_MOON_TIME,
+  FIELD_ORBIT,
+  FIELD_EVENTS,
+  FIELD_CLOCK,
+  FIELD_SPEED,
+  FIELD_BATTERY,
+  FIELDS
+} Field;
+
+static TextField s_fields[FIELDS];
+
+static GBitmap *s_phase_atlas;
+static GBitmap *s_background;
+static GRect s_background_bounds;
+static AppTimer *s_redraw_timer;
+
+// A change due this close to the minute tick waits for it, seconds
+#define REDRAW_SLACK 3
+
+// After launch the saved events are drawn first and searched again
+// this long after, milliseconds
+#define REFINE_DELAY 100
+
+// moonPositionFixed() ranges are in metres
+#define MILES_PER_METRE 0.00062137119
+
+static EphemerisCache s_ephemeris_cache;
+static EphemerisFeed s_feed;
+static unsigned int s_feed_saved;     // s_feed.chunks when last saved
+static time_t s_feed_requested;
+static LunarEvents s_lunar_events;
+static AppTimer *s_refine_timer;
+static bool s_refine_pending;
+
+
+// KEY_LOCATION is one int32 each way: longitude east in the low half
+// and latitude north in the high half, both int16 in
+// 1/LUNAR_LOCATION_SCALE degrees, as packLocation() in
+// pebble-js-app.js.  A request carries the location shown, or
+// LOCATION_UNKNOWN, and the phone only answers if its fix differs at
+// that resolution.  When the windows held run out within FEED_REFRESH
+// it also carries ephemerisFeedEnd() as KEY_EPHEMERIS, and the phone
+// answers with a chunk per window from there to a day ahead, under the
+// same key.  The phone uses the same FEED_REFRESH.
+enum MessageKey {
+  KEY_LOCATION = 0x0,          // TUPLE_INT
+  KEY_EPHEMERIS = 0x3,         // TUPLE_INT out, TUPLE_BYTE_ARRAY in
 };
 
-int32_t userLongitude,userLatitude = 0;
-
-  
-static AppSync s_sync;
-static uint8_t s_sync_buffer[64];
-
-// The following arguments are multiples of the
-// D  M  M' and F values.  
-// D = Mean elongation of the moon.
-// M = Mean anomaly of the sun.
-// M'= Mean anomaly of the moon.
-// F = Moon's argument of latitude.
-//
-// The following sixty terms all relate to periodic 
-// factors that affect the longitude and altitude
-// of the moon.  Some are quite small effects, such
-// as influence from the moons of Jupiter.  Other are
-// large.  I plan to update each term with its origin
-// soon.  The coefficients in the second array are 
-// values expressed in degrees multiplied by 1million.
-//
-// These terms are summed for latitude and altitude (or range)
-// and are of the formulae:
-//
-// coeff[i] * sin(D*arg[i][0] + M*arg[i][1] + M'*arg[i][2] 
-//                + F*arg[i][3]) = ∑longitude
-// coeff[i] * cos(D*arg[i][0] + M*arg[i][1] + M'*arg[i][2] 
-//                + F*arg[i][3]) = ∑range
-// 
-// Additionally, the coeffcient must be multiplied by the 
-// value E^n where n is the absolute value of the M multiplier.
-// E = 1 - 0.002516 * T - 0.0000074 * T * T
-// This is because the mean anomaly of the sun is variable and 
-// currently decreasing.
-
-static const int argMult1 [60][4] = {
-      { 0, 0, 1, 0},
-      { 2, 0,-1, 0},
-      { 2, 0, 0, 0},
-      { 0, 0, 2, 0},
-      { 0, 1, 0, 0},
-      { 0, 0, 0, 2},
-      { 2, 0,-2, 0},
-      { 2,-1,-1, 0},
-      { 2, 0, 1, 0},
-      { 2,-1, 0, 0},
-      { 0, 1,-1, 0},
-      { 1, 0, 0, 0},
-      { 0, 1, 1, 0},
-      { 2, 0, 0,-2},
-      { 0, 0, 1, 0},
-      { 0, 0, 1, 0},
-      { 4, 0,-1, 0},
-      { 0, 0, 3, 0},
-      { 4, 0,-2, 0},
-      { 2, 1,-1, 0},
-      { 2, 1, 0, 0},
-      { 1, 0,-1, 0},
-      { 1, 1, 0, 0},
-      { 2,-1, 1, 0},
-      { 2, 0, 2, 0},
-      { 4, 0, 0, 0},
-      { 2, 0,-3, 0},
-      { 0, 1,-2, 0},
-      { 2, 0,-1, 2},
-      { 2,-1,-2, 0},
-      { 1, 0, 1, 0},
-      { 2,-2, 0, 0},
-      { 0, 1, 2, 0},
-      { 0, 2, 0, 0},
-      { 2,-2,-1, 0},
-      { 2, 0, 1,-2},
-      { 2, 0, 0, 2},
-      { 4,-1,-1, 0},
-      { 0, 0, 2, 2},
-      { 3, 0,-1, 0},
-      { 2, 1, 1, 0},
-      { 4,-1,-2, 0},
-      { 0, 2,-1, 0},
-      { 2, 2,-1, 0},
-      { 2, 1,-2, 0},
-      { 2,-1, 0,-2},
-      { 4, 0, 1, 0},
-      { 0, 0, 4, 0},
-      { 4,-1, 0, 0},
-      { 1, 0,-2, 0},
-      { 2,-1, 0,-2},
-      { 0, 0, 2,-2},
-      { 1, 1, 1, 0},
-      { 3, 0,-2, 0},
-      { 4, 0,-3, 0},
-      { 2,-1, 2, 0},
-      { 0, 2, 1, 0},
-      { 1, 1,-1, 0},
-      { 2, 0, 3, 0},
-      { 2, 0,-1,-2}
-}; 
-
-static const signed long coefficientSin1 [60] =
- { 6288774, 1274027,  658314,  213618, -185116,
-   -114332,   58793,   57066,   53322,   45758,
-    -40923,  -34720,  -30383,   15327,  -12528,
-     10980,   10675,   10034,    8548,   -7888,
-     -6766,   -5163,    4987,    4036,    3994,
-      3861,    3665,   -2689,   -2602,    2390,
-     -2348,    2236,   -2120,   -2069,    2048,
-     -1773,   -1595,    1215,   -1110,    -892,
-      -810,     759,    -713,    -700,     691,
-       596,     549,     537,     520,    -487,
-      -399,    -381,     351,    -340,     330,
-       327,    -323,     299,     294,       0  };
-
-static const signed long coefficientCos1 [60] =
-{-20905355,-3699111,-2955968, -569925,   48888,
-     -3149,  246158, -152138, -170733, -204586,
-   -129620,  108743,  104755,   10321,       0,
-     79661,  -34782,  -23210,  -21636,   24208,
-     30824,   -8379,  -16675,  -12831,  -10445,
-    -11650,   14403,   -7003,       0,   10056,
-      6322,   -9884,    5751,       0,   -4950,
-      4131,       0,   -3958,       0,    3258,
-      2616,   -1897,   -2117,    2354,       0,
-         0,   -1423,   -1117,   -1571,   -1739,
-         0,   -4421,       0,       0,       0,
-         0,    1165,       0,       0,    8752};
-
-static double sunMeanAnomaly(double T);
-static void requestLocation(void);
-static void handle_second_tick(struct tm *tick_time, TimeUnits units_changed);
-static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed);
-
-// AppSync 
-
-
-static void sync_error_callback(DictionaryResult dict_error, AppMessageResult app_message_error, void *context) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "App Message Sync Error: %d", app_message_error);
-}
-
-
-static void sync_tuple_changed_callback(const uint32_t key, const Tuple* new_tuple, const Tuple* old_tuple, void* context) {
-  switch (key) {
-    case KEY_LONGITUDE:
-      userLongitude = -1 * new_tuple->value->int32;
-      if (userLongitude < 0) {
-        userLongitude = 360 + userLongitude;
-      }
-      break;
-    case KEY_LATITUDE:
-      userLatitude = new_tuple->value->int32;
-      break;
-  }
-  initialized = 0;
-  updateCount = 0;
-  tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
-  //layer_mark_dirty(window_get_root_layer(s_main_window));
-}
- 
-
-// Utility functions
+#define LOCATION_UNKNOWN INT32_MIN
 
+// Dictionaries are a count byte, then a 7 byte header and the value
+// per tuple.  Both keys come in one at a time, and AppSync keeps both.
+#define INBOX_SIZE (1 + 7 + EPH_FEED_CHUNK_SIZE)
+#define SYNC_SIZE (1 + 7 + 4 + 7 + EPH_FEED_CHUNK_SIZE)
+#define REQUEST_SIZE (1 + 2 * (7 + 4))
 
-static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
-  //updateDivision = 60.0;
-  layer_mark_dirty(window_get_root_layer(s_main_window));
-}
+#ifdef LUNA_PROFILE
+#define OUTBOX_SIZE PROFILE_MESSAGE_SIZE
+#else
+#define OUTBOX_SIZE REQUEST_SIZE
+#endif
 
-static void handle_second_tick(struct tm *tick_time, TimeUnits units_changed) {
-    layer_mark_dirty(window_get_root_layer(s_main_window));
-}
+// Windows are asked for once those held run out this soon, and no more
+// often than this, seconds.  FEED_REFRESH in pebble-js-app.js matches.
+#define FEED_REFRESH (4 * 60 * 60)
 
+// A request that fails, usually because the phone's side has not
+// started yet, is sent again this much later, milliseconds
+#define REQUEST_RETRY_DELAY 5000
+#define REQUEST_RETRIES 3
 
-static void battery_handler(BatteryChargeState new_state) {
-  // Write to buffer and display
-  static char s_battery_buffer[32];
-  if (new_state.is_charging) {
-    text_layer_set_text_color(s_battery_layer, GColorCeleste);
-  } else {
-    text_layer_set_text_color(s_battery_layer, GColorVividCerulean);
-  }
-  snprintf(s_battery_buffer, sizeof(s_battery_buffer), "%d%%", new_state.charge_percent);
-  text_layer_set_text(s_battery_layer, s_battery_buffer);
-}
+// 1/LUNAR_LOCATION_SCALE degrees, longitude west in [0, 360 degrees)
+int32_t userLongitude,userLatitude = 0;
 
+// Whether userLongitude and userLatitude came from the phone, now or
+// on an earlier launch
+static bool s_located;
 
-static void focus_handler(bool in_focus) {
-  if (in_focus) {
-  }
-  else {  
-    initialized = 0;
-    updateCount = 0;
-    tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
-  }
-}
 
+// Saved in deinit() and read back in init(), so that a launch draws
+// from where the last run left off instead of from nothing.  A persist
+// value holds at most PERSIST_DATA_MAX_LENGTH bytes, which the cache's
+// coefficients fill on their own, so they have a key of their own.
+enum SavedKey {
+  KEY_SAVED_STATE = 0x10,
+  KEY_SAVED_EVENTS = 0x11,
+  KEY_SAVED_CACHE = 0x12,
+  KEY_SAVED_FEED = 0x13,         // and on, one per EphemerisFeedWindow
+};
 
-// No floating point support in text_layer_set_text()?!?  Fuck it...
-void ftoa(char* str, double val, int precision) {
-  int currentDigit = 0;
-  //  start with positive/negative
-  if (val < 0) {
-    *(str++) = '-';
-    val = -val;
-  }
-  //  integer value
-  snprintf(str, 12, "%d", (int) val);
-  str += strlen(str);
-  val -= (int) val;
-  //  decimals
-  if ((precision > 0) && (val >= .00001)) {
-    //  add period
-    *(str++) = '.';
-    //  loop through precision
-    for (int i = 0;  i < precision;  i++)
-      if (val > 0) {
-        val *= 10;
-        currentDigit = (int) (val + ((i == precision - 1) ? .5 : 0));
-        *(str++) = '0' + ((currentDigit > 9) ? 9 : currentDigit);
-        val -= (int) val;
-      } else
-        break;
-  }
-  //  terminate
-  *str = '\0';
-}
+// Bump when SavedState, LunarEvents, EphemerisCache or EphemerisFeed
+// change layout
+#define SAVED_VERSION 5
 
+typedef struct {
+  uint8_t version;
+  bool located;
+  int32_t longitude;             // as userLongitude
+  int32_t latitude;
+  bool cacheValid;               // KEY_SAVED_CACHE holds the window
+  time_t cacheStart;
+} SavedState;
 
-float sqrtx(const float num) {
-  const uint MAX_STEPS = 40;
-  const float MAX_ERROR = 0.001;
   
-  float answer = num;
-  float ans_sqr = answer * answer;
-  uint step = 0;
-  while((ans_sqr - num > MAX_ERROR) && (step++ < MAX_STEPS)) {
-    answer = (answer + (num / answer)) / 2;
-    ans_sqr = answer * answer;
-  }
-  return answer;
-}
-
-
-void moonTime(char* str, double val) {
-  val = val * 24.0 / 360.0;
-  int hours = (int)val;
+static AppSync s_sync;
+static uint8_t s_sync_buffer[SYNC_SIZE];
+static AppTimer *s_request_timer;
+static int s_request_retries;
 
-  int minutes = (int)(60.0 * (val - hours));
-  
+static void requestLocation(void);
+static void sendRequest(void);
+static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed);
 
-  hours = hours + 12;
-  if (hours > 23) {
-    hours = hours - 24;
-  }  
-  if (minutes < 10) {
-    snprintf(str, 24, "%02d:0%d", hours, minutes);
-  } else {
-    snprintf(str, 24, "%02d:%2d", hours, minutes);
-  }
-  
-}
+// AppSync 
 
 
-static double degrees(double d) {
-  return (d * 360.0 / (2.0 * M_PI));
+static void handle_request_timer(void *data) {
+  s_request_timer = NULL;
+  sendRequest();
 }
 
 
-static double radians(double d) {
-  int multiple = (int)(d / 360.0);
-  if (d < 0) {
-    return (d + 360.0 - (360.0 * multiple)) * 2.0 * M_PI / 360.0;
-  } else {
-    return (d - (360.0 *multiple)) * 2.0 * M_PI / 360.0;
+static void sync_error_callback(DictionaryResult dict_error, AppMessageResult app_message_error, void *context) {
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "App Message Sync Error: %d", app_message_error);
+  if ((app_message_error == APP_MSG_SEND_TIMEOUT || app_message_error == APP_MSG_SEND_REJECTED ||
+       app_message_error == APP_MSG_NOT_CONNECTED) &&
+      s_request_timer == NULL && s_request_retries < REQUEST_RETRIES) {
+    s_request_retries++;
+    s_request_timer = app_timer_register(REQUEST_RETRY_DELAY, handle_request_timer, NULL);
   }
 }
 
 
-static double normDegrees(double d) {
-  int multiple = (int)(d / 360.0);
-  if (d < 0){
-    return d + 360.0 - (360.0 * multiple);
-  } else {
-    return d - (360.0 * multiple);
+static int32_t pack_location(void) {
+  int32_t east = -userLongitude;
+  if (east <= -180 * LUNAR_LOCATION_SCALE) {
+    east += 360 * LUNAR_LOCATION_SCALE;
   }
+  return (int32_t)(((uint32_t)(uint16_t)userLatitude << 16) | (uint16_t)east);
 }
 
 
-static double normRadians(double d) {
-  int multiple = (int)(d / (2.0 * M_PI));
-  if (d < 0){
-    return d + (2.0 * M_PI) - ((2.0 * M_PI) * multiple);
-  } else {
-    return d - ((2.0 * M_PI) * multiple);
+static void unpack_location(int32_t packed) {
+  userLongitude = -(int16_t)(packed & 0xffff);
+  if (userLongitude < 0) {
+    userLongitude += 360 * LUNAR_LOCATION_SCALE;
   }
+  userLatitude = (int16_t)((uint32_t)packed >> 16);
 }
 
 
-static double powa(double base, int power){
-  double x=1;
-  for(int i = 1;i<=power;i++){
-    x *= base;
+static void sync_tuple_changed_callback(const uint32_t key, const Tuple* new_tuple, const Tuple* old_tuple, void* context) {
+  switch (key) {
+    case KEY_LOCATION:
+      unpack_location(new_tuple->value->int32);
+      s_located = true;
+      break;
+    case KEY_EPHEMERIS:
+      // Only used from the next window on, nothing to redraw
+      ephemerisFeedReceive(&s_feed, new_tuple->value->data, new_tuple->length);
+      return;
   }
-  return x;
+  layer_mark_dirty(window_get_root_layer(s_main_window));
 }
+ 
 
+// Utility functions
 
-static long facta(int n){
-  double x=1;
-  for(int i = 1;i<=n;i++){
-    x *= i;
-  }
-  return x;
-}
 
+static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
+  time_t now = time(NULL);
 
-double fabs(double d) {
-  if (d > -d){
-    return d;
-  } else {
-    return -d;
+  // Only once the phone has shown it sends windows
+  if (s_feed.chunks > 0 && ephemerisFeedEnd(&s_feed) - now < FEED_REFRESH &&
+      now - s_feed_requested >= FEED_REFRESH) {
+    requestLocation();
   }
+  layer_mark_dirty(window_get_root_layer(s_main_window));
 }
 
 
-static double sinx(double d) {
-  d = normDegrees(d);
-  int mult = 1;
-  if (d > M_PI){
-    d = d - M_PI;
-    mult = -1;
-  }
-  int iteration;
-  double x = 0.0;
-  double y = 0.0;
-  for (iteration=0;iteration < 6;iteration++) {
-    x = (double)(powa(-1.0,iteration) * powa(d, 2*iteration + 1) / (double)facta(2*iteration + 1));
-    y += x;
-    if (fabs(x) < 0.0000001) {
-      break;
-    }
-  }  
-  return (double)mult * y;
-}
-
-
-static double cosx(double d) {
-  d = normDegrees(d);
-  int mult = 1;
-  if (d > M_PI) {
-    d = d - M_PI;
-    mult = -1;
-  }
-  int iteration;
-  double x = 0.0;
-  double y = 0.0;
-  for (iteration=0;iteration < 6;iteration++) {
-    x = (double)(powa(-1.0,iteration) * powa(d, 2*iteration) / (double)facta(2*iteration));
-    y += x;
-    if (fabs(x) < 0.000001) {
-      break;
-    }
-  }  
-  return (double)mult * y;
+static void handle_redraw_timer(void *data) {
+  s_redraw_timer = NULL;
+  layer_mark_dirty(window_get_root_layer(s_main_window));
 }
 
 
-// Calculate Julian Date from a time struct
-// Meeus - Astronomical Algorithms - formula 7.1
-static double DateToJD(struct tm *t) {
-  int M = t->tm_mon + 1 > 2 ? t->tm_mon + 1 : t->tm_mon + 13;
-  int Y = t->tm_mon + 1 > 2 ? t->tm_year + 1900 : t->tm_year + 1899;
-  double D = t->tm_mday + t->tm_hour/24.0 + t->tm_min/1440.0 + t->tm_sec/86400.0;
-  int B = 2 - (int)Y/100 + (int)Y/400;
+// The clock text changes on the minute, so the minute tick always
+// runs.  Anything due sooner than that gets a timer of its own.
+static void schedule_redraw(const FrameState *frame, int second) {
+  double wait = secondsUntilChange(frame);
+  int untilTick = 60 - second;
 
-  return (int) (365.25*(Y + 4716)) + (int) (30.6001*(M + 1)) + D + B - 1524.5;
+  if (s_redraw_timer != NULL) {
+    app_timer_cancel(s_redraw_timer);
+    s_redraw_timer = NULL;
+  }
+  if (wait < untilTick - REDRAW_SLACK) {
+    // Frames are drawn for whole seconds, so wake in the second after
+    // the change or the frame still shows the old one
+    s_redraw_timer = app_timer_register(((uint32_t)wait + 1) * 1000, handle_redraw_timer, NULL);
+  }
 }
 
 
-// Calculate time T, measured in Julian centuries from the 
-// epoch J2000.0 (JDE 2451545.0)   
-// Meeus - Astronomical Algorithms - formula 22.1
-static double JDtoT(double *JD) {
-  return (double)(*JD - 2451545.0)/36525.0;
+// The frame is right once it is drawn for a known location with the
+// events searched for that location.
+static bool frame_correct(void) {
+  return s_located && !s_refine_pending;
 }
 
 
-// Calculate the sun's mean longitude, measured in degrees [Lo]
-// Meeus - Astronomical Algorithms - formula 25.2
-static double sunMeanLongitude(double T) {
-  return 280.46646 
-         + 36000.76983 * T 
-         + 0.0003032 * T * T;
+static void handle_refine_timer(void *data) {
+  s_refine_timer = NULL;
+  s_refine_pending = false;
+  if (lunarEventsUpdate(&s_lunar_events, time(NULL), userLatitude, userLongitude)) {
+    layer_mark_dirty(window_get_root_layer(s_main_window));
+  } else if (frame_correct()) {
+    // The saved events still hold, so the frame on screen was right
+    PROFILE_FRAME_CORRECT();
+  }
 }
 
 
-// Calculate the sun's equation of center, measured in degrees [L']
-// Meeus - Astronomical Algorithms - formula 47.1
-static double sunEquationCenter(double T) {
-  return degrees((1.914602 - 0.004817 * T - 0.000014 * T * T)
-         * sinx(radians(sunMeanAnomaly(T)))
-         + (0.019993 - 0.000101 * T)
-         * sinx(radians(2.0 * sunMeanAnomaly(T)))
-         + 0.000289 * sinx(radians(3.0 * sunMeanAnomaly(T))));
-}
-
+static void text_field_init(Field id, GRect box, const char *font_key, GColor color,
+                            GTextAlignment alignment, const char *text) {
+  TextField *field = &s_fields[id];
 
-// Calculate the moon's mean longitude, measured in degrees [L']
-// Meeus - Astronomical Algorithms - formula 47.1
-static double moonMeanLongitude(double T) {
-  return 218.3164477 
-         + 481267.88123421 * T 
-         - 0.0015786 * T * T 
-         + T * T * T/538841.0 
-         - T * T * T * T/65194000.0;
+  field->box = box;
+  field->font = fonts_get_system_font(font_key);
+  field->color = color;
+  field->alignment = alignment;
+  strcpy(field->text, text);
 }
 
 
-// Calculate the moon's mean elongation, measured in degrees [D]
-// Meeus - Astronomical Algorithms - formula 47.2
-static double moonMeanElongation(double T) {
-  return 297.8501921 
-         + 445267.1114034 * T 
-         - 0.0018819 * T * T 
-         + T * T * T/544868.0 
-         - T * T * T * T/113065000.0;
-}
-
+static void text_field_set(Field id, const char *text) {
+  TextField *field = &s_fields[id];
 
-// Calculate the sun's mean anomaly, measured in degrees [M]
-// Meeus - Astronomical Algorithms - formula 47.3
-static double sunMeanAnomaly(double T) {
-  return 357.5291092
-         + 35999.0502909 * T 
-         - 0.0001536 * T * T 
-         + T * T * T / 24490000.0;
+  if (strcmp(field->text, text) != 0) {
+    strcpy(field->text, text);
+    layer_mark_dirty(s_info_layer);
+  }
 }
 
 
-// Calculate the moon's mean anomaly, measured in degrees [M']
-// Meeus - Astronomical Algorithms - formula 47.4
-static double moonMeanAnomaly(double T) {
-  return 134.9633964
-         + 477198.8675055 * T 
-         + 0.0087414 * T * T 
-         + T * T * T / 69699.0
-         - T * T * T * T / 14712000.0;
+static void battery_handler(BatteryChargeState new_state) {
+  TextField *field = &s_fields[FIELD_BATTERY];
+  GColor color = new_state.is_charging ? PBL_IF_COLOR_ELSE(GColorCeleste, GColorWhite)
+                                       : PBL_IF_COLOR_ELSE(GColorVividCerulean, GColorWhite);
+  char text[8];
+
+  if (!gcolor_equal(field->color, color)) {
+    field->color = color;
+    layer_mark_dirty(s_info_layer);
+  }
+  formatText(formatInt(text, new_state.charge_percent), "%");
+  text_field_set(FIELD_BATTERY, text);
 }
 
 
-// Calculate the moon's argument of latitude, measured in degrees [F]
-// Meeus - Astronomical Algorithms - formula 47.5
-static double moonArgLatitude(double T) {
-  return 93.2720950
-         + 483202.0175233 * T 
-         - 0.0036539 * T * T 
-         + T * T * T/3526000.0
-         + T * T * T * T/863310000.0;
+static void focus_handler(bool in_focus) {
+  if (in_focus) {
+    layer_mark_dirty(window_get_root_layer(s_main_window));
+  }
 }
 
 
-static double Eccentricity(double T) {
-  return 1.0 - 0.002516 * T - 0.0000074 * T * T;
+// Local time of an event, or dashes if there is none.
+static char *eventTime(char *str, time_t when) {
+  if (when == 0) {
+    return formatText(str, "--:--");
+  }
+  struct tm *t = localtime(&when);
+  return formatClock(str, t->tm_hour * 60 + t->tm_min);
 }
 
 
-static double sigmaMoonLongitude(double T) {
-  //T = -0.077221081451; //debug value
-  double sigmaLongitude = 0.0;
-  double A1 = radians(119.75 + 131.849 * T);
-  double A2 = radians(53.09 +479264.290 * T);
-  
-  double E  = Eccentricity(T);
-  double L  = moonMeanLongitude(T);
-  double D  = moonMeanElongation(T);
-  double M  = sunMeanAnomaly(T);
-  double Mm = moonMeanAnomaly(T);
-  double F  = moonArgLatitude(T);
+// The moon's orbit and the hash marks at the quarters.
+static void draw_background(GContext *ctx, GRect bounds, int moonOrbitRadius, int hashLength) {
+  // Get the center of the screen (non full-screen)
+  GPoint center = GPoint(bounds.size.w / 2, (bounds.size.h / 2));
   
-  for(int term=0;term < 60;term++){
-    sigmaLongitude += coefficientSin1[term] * powa(E,(int)fabs(argMult1[term][1])) *
-                       sinx(radians((double)argMult1[term][0] * D +
-                                    (double)argMult1[term][1] * M +
-                                    (double)argMult1[term][2] * Mm +
-                                    (double)argMult1[term][3] * F));
-  }
-
-  sigmaLongitude += radians(3958.0 * sinx(A1));
-  sigmaLongitude += radians(1962.0 * sinx(radians(L - F)));
-  sigmaLongitude += radians( 318.0 * sinx(A2));
-
-  return normDegrees(L + sigmaLongitude / 1000000.0); 
+  // Draw the moon's orbit
+  graphics_context_set_stroke_width(ctx,2);
+  graphics_context_set_stroke_color(ctx, PBL_IF_COLOR_ELSE(GColorTiffanyBlue, GColorWhite));
+  graphics_draw_circle(ctx, center, moonOrbitRadius);
+  graphics_context_set_stroke_color(ctx, PBL_IF_COLOR_ELSE(GColorDarkGray, GColorWhite));
+  graphics_context_set_stroke_width(ctx,1);
+  graphics_draw_line(ctx, GPoint((bounds.size.w/2) - hashLength - moonOrbitRadius ,(bounds.size.h/2)), 
+                          GPoint((bounds.size.w/2) + hashLength - moonOrbitRadius ,(bounds.size.h/2)));
+  graphics_draw_line(ctx, GPoint((bounds.size.w/2) - hashLength + moonOrbitRadius ,(bounds.size.h/2)), 
+                          GPoint((bounds.size.w/2) + hashLength + moonOrbitRadius ,(bounds.size.h/2)));
+  graphics_draw_line(ctx, GPoint((bounds.size.w/2) ,(bounds.size.h/2) - hashLength - moonOrbitRadius), 
+                          GPoint((bounds.size.w/2) ,(bounds.size.h/2) + hashLength - moonOrbitRadius));
+  graphics_draw_line(ctx, GPoint((bounds.size.w/2) ,(bounds.size.h/2) - hashLength + moonOrbitRadius), 
+                          GPoint((bounds.size.w/2) ,(bounds.size.h/2) + hashLength + moonOrbitRadius)); 
 }
 
 
-static double sigmaMoonRange(double T) {
-  //T = -0.077221081451; //debug value
-  double sigmaRange = 0.0;
-  
-  double E  = Eccentricity(T);
-
-  double D  = moonMeanElongation(T);
-  double M  = sunMeanAnomaly(T);
-  double Mm = moonMeanAnomaly(T);
-  double F  = moonArgLatitude(T);
-  
-  for(int term=0;term < 60;term++){
-    sigmaRange += coefficientCos1[term] * powa(E,(int)fabs(argMult1[term][1])) *
-                       cosx(radians((double)argMult1[term][0] * D +
-                                    (double)argMult1[term][1] * M +
-                                    (double)argMult1[term][2] * Mm +
-                                    (double)argMult1[term][3] * F));
+#ifndef LUNA_LEAN
+// Keeps a copy of what has been drawn so far.  The canvas is the first
+// layer in the window and covers it, so its bounds are screen pixels.
+static void capture_background(GContext *ctx, GRect bounds) {
+  if (s_background != NULL) {
+    gbitmap_destroy(s_background);
+    s_background = NULL;
   }
   
-  return 0.62137119 * (385000.56 + (sigmaRange / 1000.0)); 
-}
-
-
-static double moonRA(double L){
-  int y,x;
-  float g;
-  y = (int16_t)(10000 * sinx(radians(L)) * cosx(radians(obliquityE)));
-  x = (int16_t)(10000 * cosx(radians(L)));
-  g = atan2_lookup(y,x);
-  g = 360.0 * g / TRIG_MAX_ANGLE;
-  return g;
-}
-
-static double moonOrbitalSpeed(double Range){
-  Range = Range * 1609.344;  // convert miles to meters
-  float moonMu = 398600000000000.8000;
-  double moonSemiMajor = 384400000.0;
-  return 3600.0 * (sqrtx(moonMu * ((2.0 / Range) - (1.0 / moonSemiMajor)))) / 1609.344;
+  GBitmap *frame = graphics_capture_frame_buffer(ctx);
+  if (frame == NULL) {
+    return;
+  }
+  GBitmapFormat format = gbitmap_get_format(frame);
+  // Round screens have rows of varying length, just redraw there
+  if (format != GBitmapFormat8BitCircular) {
+    s_background = gbitmap_create_blank(bounds.size, format);
+  }
+  if (s_background != NULL) {
+    uint8_t *src = gbitmap_get_data(frame);
+    uint8_t *dst = gbitmap_get_data(s_background);
+    uint16_t src_stride = gbitmap_get_bytes_per_row(frame);
+    uint16_t dst_stride = gbitmap_get_bytes_per_row(s_background);
+    uint16_t length = src_stride < dst_stride ? src_stride : dst_stride;
+    for (int y = 0; y < bounds.size.h; y++) {
+      memcpy(dst + y * dst_stride, src + (bounds.origin.y + y) * src_stride, length);
+    }
+    s_background_bounds = bounds;
+  }
+  graphics_release_frame_buffer(ctx, frame);
 }
+#endif
 
 
-static double sunRA(double T){ 
-  //T = -0.024012092;
-  float x,y;
-  float d = T * 36525.0;
-  float L = 280.461 + 0.9856474 * d;
-  float g = sunMeanAnomaly(T);
-  float lambda = L + 1.915 * sinx(radians(g)) + 0.020 * sinx(radians(2*g));
-  y = cosx(radians(obliquityE)) * sinx(radians(lambda));
-  x = cosx(radians(lambda));
+// Windows from the phone when they cover t, else the watch's own series
+#ifdef LUNA_FIXED_POINT
+static void fixed_ephemeris(time_t t, FeedEphemerisFixed *out) {
+  MoonPositionFixed moonFixed;
 
-  g = atan2_lookup((int16_t)(10000 * y),(int16_t)(10000 * x));
-  g = 360.0 * g / TRIG_MAX_ANGLE;
-  
-  return g;
-}
-
-
-static double greenwichSiderealTime(double T, struct tm *t) {
-  double offset = (double)(t->tm_hour * 3600 + t->tm_min * 60 + t->tm_sec); 
-  
-  offset = 360.0 * offset / 86400.0;
-  return normDegrees(100.46061837 + (36000.770053608 * T) 
-         + (0.000387933 * T * T) - (T * T * T / 38710000.0)
-         + 1.00273790935 * offset);
+  if (ephemerisFeedGetFixed(&s_feed, t, out)) {
+    return;
+  }
+  moonPositionFixed(t, &moonFixed);
+  out->moonRA = moonRAFixed(moonFixed.longitude);
+  out->sunRA = sunRAFixed(t);
+  out->range = moonFixed.range;
+  out->rangeRate = moonFixed.rangeRate;
+}
+#else
+static void cached_ephemeris(time_t t, CachedEphemeris *out) {
+  if (!ephemerisCacheCovers(&s_ephemeris_cache, t)) {
+    ephemerisFeedLoad(&s_feed, t, &s_ephemeris_cache);
+  }
+  ephemerisCacheGet(&s_ephemeris_cache, t, out);
 }
+#endif
 
 
 static void canvas_update_proc(Layer *this_layer, GContext *ctx) {
+  PROFILE_BEGIN(PROFILE_FRAME);
   time_t now = time(NULL);
-  struct tm *t = gmtime(&now);
-  struct tm *lt = localtime(&now);
-    
-  double JD = DateToJD(t);
-  double T = JDtoT(&JD);
-  
-  //T = -0.077221081451;
-  
-  static char buf[24] = "";
-  static char buf2[32] = "";
-  static char buf3[24] = "";
-  static char buf4[24] = "";
-  static char buf5[12] = "";
-  static char buf6[16] = "";
+#ifndef LUNA_FIXED_POINT
+  // T, the arguments and sidereal time for this tick, straight from now
+  Epoch epoch;
+  epochFromTime(&epoch, now);
+#endif
+  struct tm local = *localtime(&now);
+  struct tm *lt = &local;
+  
+  char text[24];
+  char *end;
+  int32_t moonMinutes;
   
   int moonOrbitRadius = 56;
   int hashLength = 3;
   
-  double moonLongitude;
+#ifdef LUNA_FIXED_POINT
+  FeedEphemerisFixed fixed;
+  int32_t siderealAngle;
+  int32_t moonAngle;
+  int32_t sunAngle;
+#else
+  CachedEphemeris cached;
   double moonRightAscension;
+  double sunRightAscension;
+#endif
   double moonHourAngle;
   double moonAltitude;
   double moonDoppler = 0;
   double moonSpeed;
   
-  double sunRightAscension;
   double sunHourAngle;
   
-  double elapsedTime = difftime(now,then);
-  
   float moonX,moonY;
   int pointX,pointY;
   
   
-  if (elapsedTime < 1.0) {
-    elapsedTime = 1.0;
-  }
-  
-  
 
   
   
   
   GRect bounds = layer_get_bounds(this_layer);
   
-  // Get the center of the screen (non full-screen)
-  GPoint center = GPoint(bounds.size.w / 2, (bounds.size.h / 2));
-  
-  // Draw the moon's orbit
-  graphics_context_set_stroke_width(ctx,2);
-  graphics_context_set_stroke_color(ctx, GColorTiffanyBlue);
-  graphics_draw_circle(ctx, center, moonOrbitRadius);
-  graphics_context_set_stroke_color(ctx, GColorDarkGray);
-  graphics_context_set_stroke_width(ctx,1);
-  graphics_draw_line(ctx, GPoint((bounds.size.w/2) - hashLength - moonOrbitRadius ,(bounds.size.h/2)), 
-                          GPoint((bounds.size.w/2) + hashLength - moonOrbitRadius ,(bounds.size.h/2)));
-  graphics_draw_line(ctx, GPoint((bounds.size.w/2) - hashLength + moonOrbitRadius ,(bounds.size.h/2)), 
-                          GPoint((bounds.size.w/2) + hashLength + moonOrbitRadius ,(bounds.size.h/2)));
-  graphics_draw_line(ctx, GPoint((bounds.size.w/2) ,(bounds.size.h/2) - hashLength - moonOrbitRadius), 
-                          GPoint((bounds.size.w/2) ,(bounds.size.h/2) + hashLength - moonOrbitRadius));
-  graphics_draw_line(ctx, GPoint((bounds.size.w/2) ,(bounds.size.h/2) - hashLength + moonOrbitRadius), 
-                          GPoint((bounds.size.w/2) ,(bounds.size.h/2) + hashLength + moonOrbitRadius)); 
+  // The orbit never changes, draw it once and reuse the pixels
+  PROFILE_BEGIN(PROFILE_DRAWING);
+  if (s_background != NULL && grect_equal(&bounds, &s_background_bounds)) {
+    graphics_draw_bitmap_in_rect(ctx, s_background, bounds);
+  } else {
+    draw_background(ctx, bounds, moonOrbitRadius, hashLength);
+#ifndef LUNA_LEAN
+    capture_background(ctx, bounds);
+#endif
+  }
+  PROFILE_END(PROFILE_DRAWING);
   
   // Draw the moon
-  moonLongitude = sigmaMoonLongitude(T);
-  moonAltitude = sigmaMoonRange(T);
-  moonDoppler = 3600.0 * (moonAltitude - moonRange) / elapsedTime; //3600
-  moonRange = moonAltitude;
-  moonSpeed = moonOrbitalSpeed(moonAltitude);
-  
-  moonRightAscension = moonRA(moonLongitude);
-  moonHourAngle = normDegrees(greenwichSiderealTime(T,t) - (float)userLongitude - moonRightAscension);
+  PROFILE_BEGIN(PROFILE_EPHEMERIS);
+#ifdef LUNA_FIXED_POINT
+  // Integer ephemeris, angles in TRIG_MAX_ANGLE units
+  fixed_ephemeris(now, &fixed);
+#else
+  // Series only run when the cache window is refitted
+  cached_ephemeris(now, &cached);
+#endif
+  // Only searches again once an event has passed or we moved.  Right
+  // after launch the saved events are drawn and handle_refine_timer()
+  // searches once the frame is up.
+  if (!s_refine_pending) {
+    lunarEventsUpdate(&s_lunar_events, now, userLatitude, userLongitude);
+  }
+  PROFILE_END(PROFILE_EPHEMERIS);
+
+  PROFILE_BEGIN(PROFILE_SIDEREAL);
+#ifdef LUNA_FIXED_POINT
+  siderealAngle = greenwichSiderealTimeFixed(now) -
+                  userLongitude * TRIG_MAX_ANGLE / (360 * LUNAR_LOCATION_SCALE);
+  moonAngle = (siderealAngle - fixed.moonRA) & (TRIG_MAX_ANGLE - 1);
+  sunAngle = (siderealAngle - fixed.sunRA) & (TRIG_MAX_ANGLE - 1);
+  
+  moonAltitude = fixed.range * MILES_PER_METRE;
+  moonDoppler = fixed.rangeRate * MILES_PER_METRE / 24.0;
+  moonHourAngle = 360.0 * moonAngle / TRIG_MAX_ANGLE;
+  sunHourAngle = 360.0 * sunAngle / TRIG_MAX_ANGLE;
+  moonX = (float)sin_lookup(moonAngle) / TRIG_MAX_RATIO;
+  moonY = (float)cos_lookup(moonAngle) / TRIG_MAX_RATIO;
+  moonMinutes = moonAngle * (24 * 60) / TRIG_MAX_ANGLE;
+#else
+  moonAltitude = cached.range;
+  moonDoppler = cached.rangeRate / 24.0;
+  
+  moonRightAscension = cached.moonRA;
+  moonHourAngle = normDegrees(epoch.gst - (float)userLongitude / LUNAR_LOCATION_SCALE - moonRightAscension);
 
   moonX = (float)sinx(radians(moonHourAngle));
   moonY = (float)cosx(radians(moonHourAngle));
-  pointX = (int)(1.0 * moonX * moonOrbitRadius);
-  pointY = (int)(-1.0 * moonY * moonOrbitRadius);
 
+  sunRightAscension = cached.sunRA;
+  sunHourAngle = normDegrees(epoch.gst - (float)userLongitude / LUNAR_LOCATION_SCALE - sunRightAscension);
+  moonMinutes = (int32_t)(moonHourAngle * 4.0);
+#endif
+  PROFILE_END(PROFILE_SIDEREAL);
 
-  sunRightAscension = sunRA(T);
-  sunHourAngle = normDegrees(greenwichSiderealTime(T,t) - (float)userLongitude - sunRightAscension);
+  moonSpeed = moonOrbitalSpeed(moonAltitude);
+  
+  pointX = (int)(1.0 * moonX * moonOrbitRadius);
+  pointY = (int)(-1.0 * moonY * moonOrbitRadius);
 
   // Draw Velocity hints
-  graphics_context_set_stroke_color(ctx, GColorChromeYellow);
+  PROFILE_BEGIN(PROFILE_DRAWING);
+  graphics_context_set_stroke_color(ctx, PBL_IF_COLOR_ELSE(GColorChromeYellow, GColorWhite));
   graphics_draw_line(ctx, GPoint(pointX + (bounds.size.w/2)
                                 ,pointY + (bounds.size.h/2)),
                           GPoint((int)(pointX + (bounds.size.w/2) + moonX * moonDoppler / 5.0),
                                  (int)(pointY + (bounds.size.h/2) + moonY * moonDoppler / -5.0)));
   
-  // dark side
-  graphics_context_set_antialiased(ctx,0);
-  graphics_context_set_stroke_color(ctx, GColorBlack);
-  graphics_context_set_fill_color(ctx, GColorBlack);
-  graphics_fill_circle(ctx,GPoint(pointX + (bounds.size.w/2)
-                             ,pointY + (bounds.size.h/2)),5);
-  graphics_context_set_stroke_color(ctx, GColorDarkGray);
-  graphics_context_set_fill_color(ctx, GColorDarkGray);
-
-  gpath_rotate_to(s_luna_path, TRIG_MAX_ANGLE * ((sunHourAngle / 360.0) + 0.25));
-  gpath_move_to(s_luna_path, GPoint((bounds.size.w/2) + pointX,(bounds.size.h/2) + pointY));
-    
-  gpath_draw_filled(ctx, s_luna_path);
-  
-  graphics_context_set_stroke_color(ctx, GColorLightGray);
-  graphics_context_set_fill_color(ctx, GColorWhite);
-
-  gpath_rotate_to(s_luna_path, TRIG_MAX_ANGLE * ((sunHourAngle / 360.0) - 0.25));
-  gpath_draw_filled(ctx, s_luna_path);
-  graphics_context_set_antialiased(ctx,1);
-  
+  // The moon, lit towards the sun, one sprite from the atlas
+  if (s_phase_atlas != NULL) {
+    int phase = (int)(sunHourAngle * PHASE_SPRITES / 360.0) % PHASE_SPRITES;
+    gbitmap_set_bounds(s_phase_atlas, GRect(0, phase * PHASE_SIZE, PHASE_SIZE, PHASE_SIZE));
+#ifdef PBL_BW
+    // One bit sprites only hold the lit side, black out the orbit behind
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_circle(ctx, GPoint((bounds.size.w/2) + pointX, (bounds.size.h/2) + pointY),
+                         PHASE_RADIUS);
+    graphics_context_set_compositing_mode(ctx, GCompOpOr);
+#else
+    graphics_context_set_compositing_mode(ctx, GCompOpSet);
+#endif
+    graphics_draw_bitmap_in_rect(ctx, s_phase_atlas,
+                                 GRect((bounds.size.w/2) + pointX - PHASE_RADIUS,
+                                       (bounds.size.h/2) + pointY - PHASE_RADIUS,
+                                       PHASE_SIZE, PHASE_SIZE));
+    graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+  }
+  PROFILE_END(PROFILE_DRAWING);
   
-  // Display Moon Time
   
-  text_layer_set_font(s_text_layer, fonts_get_system_font(FONT_KEY_LECO_32_BOLD_NUMBERS));
+  // Display Moon Time, the moon's hour angle as a clock from noon
+  PROFILE_BEGIN(PROFILE_TEXT);
+  formatClock(text, moonMinutes + 12 * 60);
+  text_field_set(FIELD_MOON_TIME, text);
+
+  end = formatText(formatInt(text, (int32_t)moonAltitude), " mi\n");
+  formatText(formatTenths(end, (int32_t)(moonDoppler * 10.0)), " mph");
+  text_field_set(FIELD_ORBIT, text);
+
+  end = eventTime(formatText(text, "Rise "), s_lunar_events.when[LUNAR_RISE]);
+  eventTime(formatText(end, " Set "), s_lunar_events.when[LUNAR_SET]);
+  text_field_set(FIELD_EVENTS, text);
+
+  formatClock(text, lt->tm_hour * 60 + lt->tm_min);
+  text_field_set(FIELD_CLOCK, text);
+
+  formatText(formatTenths(text, (int32_t)(moonSpeed * 10.0)), " mph");
+  text_field_set(FIELD_SPEED, text);
+  PROFILE_END(PROFILE_TEXT);
   
-  text_layer_set_text_color(s_text_layer, GColorWhite);
   
- 
-  text_layer_set_text_alignment(s_text_layer, GTextAlignmentCenter); 
-  moonTime(buf,moonHourAngle);
-  text_layer_set_text(s_text_layer, buf);   
-  
-  text_layer_set_text_alignment(s_text2_layer, GTextAlignmentRight); 
-  text_layer_set_font(s_text2_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
-  
-  snprintf(buf2, 12, "%d mi\n", (int)moonRange);
-  ftoa(buf3,moonDoppler,1);
-  strcat(buf2, buf3);
-  strcat(buf2, " mph");
-  text_layer_set_text(s_text2_layer, buf2); 
-  
-  text_layer_set_text_color(s_text3_layer, GColorBrightGreen);
-  snprintf(buf6,18, "Lon:%ld Lat:%ld", userLongitude, userLatitude);
-  text_layer_set_text(s_text3_layer, buf6);
-  
-  text_layer_set_font(s_text4_layer, fonts_get_system_font(FONT_KEY_LECO_20_BOLD_NUMBERS));
-  text_layer_set_text_color(s_text4_layer, GColorIcterine);
-  snprintf(buf4,12, "%02d:%02d", lt->tm_hour, lt->tm_min);
-  text_layer_set_text(s_text4_layer, buf4);
-  
-  text_layer_set_text_alignment(s_text5_layer, GTextAlignmentLeft); 
-  text_layer_set_font(s_text5_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
-  text_layer_set_text_color(s_text5_layer, GColorTiffanyBlue);
-  ftoa(buf5,moonSpeed,1);
-
-  strcat(buf5, " mph");
-  text_layer_set_text(s_text5_layer, buf5);  
-  
-  
-  if (initialized < 1) {
-    updateCount += 1;
-    if (updateCount > 5) {
-      initialized += 1;
-      tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
-    }
-  } 
-  pt = gmtime(&now);
-  then = time(NULL);
+  FrameState frame = {
+    .moonHourAngle = moonHourAngle,
+    .sunHourAngle = sunHourAngle,
+    .orbitRadius = moonOrbitRadius,
+    .phaseStep = 360.0 / PHASE_SPRITES,
+  };
+  schedule_redraw(&frame, lt->tm_sec);
+  if (frame_correct()) {
+    PROFILE_FRAME_CORRECT();
+  }
+  PROFILE_END(PROFILE_FRAME);
+  PROFILE_FRAME_END();
   
   /*
   if ((lt->tm_min == 0 || lt->tm_min == 55) && lt->tm_sec == 0){
-    initialized = 0;
-    updateCount = 0;
-    tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
     requestLocation();
   }
   */
@@ -766,6 +573,65 @@ static void canvas_update_proc(Layer *this_layer, GContext *ctx) {
 }
 
 
+// All the text in one pass, after canvas_update_proc() has set it.  The
+// two fields at the top share a box, one to each side.
+static void info_update_proc(Layer *this_layer, GContext *ctx) {
+  for (int i = 0; i < FIELDS; i++) {
+    TextField *field = &s_fields[i];
+    graphics_context_set_text_color(ctx, field->color);
+    graphics_draw_text(ctx, field->text, field->font, field->box,
+                       GTextOverflowModeWordWrap, field->alignment, NULL);
+  }
+}
+
+
+// Render every phase into the atlas once, see luna.h.  Sprite k is lit
+// for the sun at the middle of its step, towards (sin, -cos) on screen.
+static GBitmap *create_phase_atlas(void) {
+  GSize size = GSize(PHASE_SIZE, PHASE_SIZE * PHASE_SPRITES);
+#ifdef PBL_BW
+  GBitmap *atlas = gbitmap_create_blank(size, GBitmapFormat1Bit);
+#else
+  static GColor palette[4];
+  palette[PHASE_CLEAR] = GColorClear;
+  palette[PHASE_DARK] = GColorDarkGray;
+  palette[PHASE_LIT] = GColorWhite;
+  palette[3] = GColorClear;
+
+  GBitmap *atlas = gbitmap_create_blank_with_palette(size, GBitmapFormat2BitPalette, palette, false);
+#endif
+  if (atlas == NULL) {
+    return NULL;
+  }
+  uint8_t *data = gbitmap_get_data(atlas);
+  uint16_t row_size = gbitmap_get_bytes_per_row(atlas);
+
+  for (int k = 0; k < PHASE_SPRITES; k++) {
+    int32_t angle = TRIG_MAX_ANGLE * (2 * k + 1) / (2 * PHASE_SPRITES);
+    int32_t s = sin_lookup(angle);
+    int32_t c = cos_lookup(angle);
+    for (int y = -PHASE_RADIUS; y <= PHASE_RADIUS; y++) {
+      uint8_t *row = data + (k * PHASE_SIZE + y + PHASE_RADIUS) * row_size;
+      memset(row, 0, row_size);
+      for (int x = -PHASE_RADIUS; x <= PHASE_RADIUS; x++) {
+        int pixel = PHASE_CLEAR;
+        if (x * x + y * y <= PHASE_RADIUS * PHASE_RADIUS + PHASE_RADIUS) {
+          pixel = x * s - y * c >= 0 ? PHASE_LIT : PHASE_DARK;
+        }
+        int i = x + PHASE_RADIUS;
+#ifdef PBL_BW
+        // Leftmost pixel in the lowest bit
+        row[i / 8] |= (pixel == PHASE_LIT) << (i % 8);
+#else
+        row[i / 4] |= pixel << (6 - 2 * (i % 4));
+#endif
+      }
+    }
+  }
+  return atlas;
+}
+
+
 static void main_window_load(Window *window) {
   // Create Window's child Layers here
   
@@ -773,71 +639,41 @@ static void main_window_load(Window *window) {
   GRect window_bounds = layer_get_bounds(window_layer);
   
   // Create Layer
-  s_canvas_layer = bitmap_layer_create(GRect(0, 0, window_bounds.size.w, window_bounds.size.h));
-  layer_add_child(window_layer, bitmap_layer_get_layer(s_canvas_layer));
+  s_canvas_layer = layer_create(GRect(0, 0, window_bounds.size.w, window_bounds.size.h));
+  layer_add_child(window_layer, s_canvas_layer);
 
   // Set the update_proc
-  layer_set_update_proc(bitmap_layer_get_layer(s_canvas_layer), canvas_update_proc);
-  
-  // Create First Text Layer - Middle, used for time
-  s_text_layer = text_layer_create(GRect(0, 63, window_bounds.size.w, 90));
-  text_layer_set_font(s_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
-  text_layer_set_text(s_text_layer, "No time yet.");
-  text_layer_set_overflow_mode(s_text_layer, GTextOverflowModeWordWrap);
-  text_layer_set_background_color(s_text_layer, GColorClear);
-  
-  layer_add_child(window_layer, text_layer_get_layer(s_text_layer));
-  
-// Create Second Text Layer - Top, used for orbital elements
-  s_text2_layer = text_layer_create(GRect(3, -4, window_bounds.size.w - 6, 36));
-  text_layer_set_font(s_text2_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
-  text_layer_set_text(s_text2_layer, "No data yet.");
-  text_layer_set_overflow_mode(s_text2_layer, GTextOverflowModeWordWrap);
-  text_layer_set_background_color(s_text2_layer, GColorClear);
-  text_layer_set_text_color(s_text2_layer, GColorChromeYellow);
-  
-  layer_add_child(window_layer, text_layer_get_layer(s_text2_layer)); 
-  
-// Create Third Text Layer - Bottom, used for location
-  s_text3_layer = text_layer_create(GRect(0, window_bounds.size.h -20, window_bounds.size.w, 20));
-  text_layer_set_font(s_text3_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
-  text_layer_set_text(s_text3_layer, "No data yet.");
-  text_layer_set_overflow_mode(s_text3_layer, GTextOverflowModeWordWrap);
-  text_layer_set_background_color(s_text3_layer, GColorClear);
-  text_layer_set_text_alignment(s_text3_layer, GTextAlignmentCenter); 
-  
-  layer_add_child(window_layer, text_layer_get_layer(s_text3_layer));   
-
-// Create Fourth Text Layer - Middle, used for standard time
-  s_text4_layer = text_layer_create(GRect(0, 96, window_bounds.size.w, 20));
-  text_layer_set_font(s_text4_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD));
-  text_layer_set_text(s_text4_layer, "No data yet.");
-  text_layer_set_overflow_mode(s_text4_layer, GTextOverflowModeWordWrap);
-  text_layer_set_background_color(s_text4_layer, GColorClear);
-  text_layer_set_text_alignment(s_text4_layer, GTextAlignmentCenter); 
-  
-  layer_add_child(window_layer, text_layer_get_layer(s_text4_layer));   
-  
-// Create Fifth Text Layer - Upper Left, used for orbital speed
-  s_text5_layer = text_layer_create(GRect(3, -4, window_bounds.size.w - 6, 36));
-  text_layer_set_font(s_text5_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
-  text_layer_set_text(s_text5_layer, "No data yet.");
-  text_layer_set_overflow_mode(s_text5_layer, GTextOverflowModeWordWrap);
-  text_layer_set_background_color(s_text5_layer, GColorClear);
-  text_layer_set_text_alignment(s_text5_layer, GTextAlignmentCenter); 
-  
-  layer_add_child(window_layer, text_layer_get_layer(s_text5_layer));  
-  
-  
-// Create Battery Text Layer 
-  s_battery_layer = text_layer_create(GRect(window_bounds.size.w -30, 152, 30, 20));
-  text_layer_set_font(s_battery_layer, fonts_get_system_font(FONT_KEY_GOTHIC_14));
-  text_layer_set_text(s_battery_layer, "No data yet.");
-  text_layer_set_overflow_mode(s_battery_layer, GTextOverflowModeWordWrap);
-  text_layer_set_background_color(s_battery_layer, GColorClear);
-  text_layer_set_text_alignment(s_battery_layer, GTextAlignmentRight); 
-  text_layer_set_text_color(s_battery_layer, GColorVividCerulean);
-  layer_add_child(window_layer, text_layer_get_layer(s_battery_layer)); 
+  layer_set_update_proc(s_canvas_layer, canvas_update_proc);
+  s_phase_atlas = create_phase_atlas();
+  
+  // One layer over the canvas draws all the text
+  s_info_layer = layer_create(GRect(0, 0, window_bounds.size.w, window_bounds.size.h));
+  layer_set_update_proc(s_info_layer, info_update_proc);
+  layer_add_child(window_layer, s_info_layer);
+
+  // Middle, the moon's time
+  text_field_init(FIELD_MOON_TIME, GRect(0, 63, window_bounds.size.w, 90),
+                  FONT_KEY_LECO_32_BOLD_NUMBERS, GColorWhite, GTextAlignmentCenter, "No time yet.");
+  // Top right, the moon's range and how fast it changes
+  text_field_init(FIELD_ORBIT, GRect(3, -4, window_bounds.size.w - 6, 36),
+                  FONT_KEY_GOTHIC_14, PBL_IF_COLOR_ELSE(GColorChromeYellow, GColorWhite),
+                  GTextAlignmentRight, "No data yet.");
+  // Bottom, moonrise and moonset
+  text_field_init(FIELD_EVENTS, GRect(0, window_bounds.size.h - 20, window_bounds.size.w, 20),
+                  FONT_KEY_GOTHIC_18, PBL_IF_COLOR_ELSE(GColorBrightGreen, GColorWhite),
+                  GTextAlignmentCenter, "No data yet.");
+  // Middle, standard time
+  text_field_init(FIELD_CLOCK, GRect(0, 96, window_bounds.size.w, 20),
+                  FONT_KEY_LECO_20_BOLD_NUMBERS, PBL_IF_COLOR_ELSE(GColorIcterine, GColorWhite),
+                  GTextAlignmentCenter, "No data yet.");
+  // Top left, orbital speed
+  text_field_init(FIELD_SPEED, GRect(3, -4, window_bounds.size.w - 6, 36),
+                  FONT_KEY_GOTHIC_14, PBL_IF_COLOR_ELSE(GColorTiffanyBlue, GColorWhite),
+                  GTextAlignmentLeft, "No data yet.");
+  // Bottom right, battery
+  text_field_init(FIELD_BATTERY, GRect(window_bounds.size.w - 30, 152, 30, 20),
+                  FONT_KEY_GOTHIC_14, PBL_IF_COLOR_ELSE(GColorVividCerulean, GColorWhite),
+                  GTextAlignmentRight, "No data yet.");
   
   battery_handler(battery_state_service_peek());
   
@@ -845,7 +681,14 @@ static void main_window_load(Window *window) {
 }
 
 
+// A new request, with REQUEST_RETRIES of its own
 static void requestLocation(void) {
+  s_request_retries = 0;
+  sendRequest();
+}
+
+
+static void sendRequest(void) {
   DictionaryIterator *iter;
   app_message_outbox_begin(&iter);
 
@@ -854,25 +697,32 @@ static void requestLocation(void) {
     return;
   }
 
-  int value = 1;
-  //dict_write_int(iter, 1, &value, sizeof(int), true);
-  //dict_write_end(iter);
-  dict_write_uint8(iter, 0, 0);
-  
+  time_t now = time(NULL);
+  time_t end = ephemerisFeedEnd(&s_feed);
 
+  dict_write_int32(iter, KEY_LOCATION, s_located ? pack_location() : LOCATION_UNKNOWN);
+  // Windows still held are not sent again
+  if (end - now < FEED_REFRESH) {
+    dict_write_int32(iter, KEY_EPHEMERIS, (int32_t)end);
+    s_feed_requested = now;
+  }
+  dict_write_end(iter);
   app_message_outbox_send();
 }
 
 
 static void main_window_unload(Window *window) {
   // Destroy Window's child Layers here
-  text_layer_destroy(s_text_layer);
-  text_layer_destroy(s_text2_layer);
-  text_layer_destroy(s_text3_layer);
-  text_layer_destroy(s_text4_layer);
-  text_layer_destroy(s_text5_layer);
-  text_layer_destroy(s_battery_layer);
-  bitmap_layer_destroy(s_canvas_layer);
+  layer_destroy(s_info_layer);
+  layer_destroy(s_canvas_layer);
+  if (s_background != NULL) {
+    gbitmap_destroy(s_background);
+    s_background = NULL;
+  }
+  if (s_phase_atlas != NULL) {
+    gbitmap_destroy(s_phase_atlas);
+    s_phase_atlas = NULL;
+  }
 }
 
 
@@ -880,12 +730,69 @@ static void main_window_unload(Window *window) {
 
 
 
+static void save_state(void) {
+  SavedState state = {
+    .version = SAVED_VERSION,
+    .located = s_located,
+    .longitude = userLongitude,
+    .latitude = userLatitude,
+    .cacheValid = s_ephemeris_cache.valid,
+    .cacheStart = s_ephemeris_cache.start,
+  };
+
+  persist_write_data(KEY_SAVED_STATE, &state, sizeof(state));
+  persist_write_data(KEY_SAVED_EVENTS, &s_lunar_events, sizeof(s_lunar_events));
+  if (s_ephemeris_cache.valid) {
+    persist_write_data(KEY_SAVED_CACHE, s_ephemeris_cache.coefficients,
+                       sizeof(s_ephemeris_cache.coefficients));
+  }
+  // Windows only change when the phone sends some
+  if (s_feed.chunks != s_feed_saved) {
+    for (int i = 0; i < EPH_FEED_WINDOWS; i++) {
+      persist_write_data(KEY_SAVED_FEED + i, &s_feed.windows[i], sizeof(s_feed.windows[i]));
+    }
+  }
+}
+
+
+// Anything missing or of another layout is left as initialised.
+static void restore_state(void) {
+  SavedState state;
+
+  s_located = false;
+  if (persist_read_data(KEY_SAVED_STATE, &state, sizeof(state)) == (int)sizeof(state) &&
+      state.version == SAVED_VERSION) {
+    s_located = state.located;
+    if (state.located) {
+      userLongitude = state.longitude;
+      userLatitude = state.latitude;
+    }
+    if (state.cacheValid &&
+        persist_read_data(KEY_SAVED_CACHE, s_ephemeris_cache.coefficients,
+                          sizeof(s_ephemeris_cache.coefficients)) ==
+        (int)sizeof(s_ephemeris_cache.coefficients)) {
+      s_ephemeris_cache.valid = true;
+      s_ephemeris_cache.start = state.cacheStart;
+    }
+    if (persist_read_data(KEY_SAVED_EVENTS, &s_lunar_events, sizeof(s_lunar_events)) ==
+        (int)sizeof(s_lunar_events)) {
+      s_lunar_events.evaluations = 0;
+      s_lunar_events.steps = 0;
+    }
+    for (int i = 0; i < EPH_FEED_WINDOWS; i++) {
+      if (persist_read_data(KEY_SAVED_FEED + i, &s_feed.windows[i], sizeof(s_feed.windows[i])) ==
+          (int)sizeof(s_feed.windows[i])) {
+        s_feed.chunks++;
+      }
+    }
+    s_feed_saved = s_feed.chunks;
+  }
+}
+
+
 static void init() {
-  time_t now = time(NULL);
-  
+  PROFILE_LAUNCH();
   // Create main Window  
-  updateCount = 0;
-  updateDivision = 1.0;
   s_main_window = window_create();
   window_set_background_color(s_main_window, GColorBlack);
   window_set_window_handlers(s_main_window, (WindowHandlers) {
@@ -893,32 +800,51 @@ static void init() {
     .unload = main_window_unload,
   });
   window_stack_push(s_main_window, true);
-  s_luna_path = gpath_create(&LUNA_PATH_POINTS);
-  //tick_timer_service_subscribe(SECOND_UNIT, handle_second_tick);
+  ephemerisCacheInit(&s_ephemeris_cache);
+  ephemerisFeedInit(&s_feed);
+  lunarEventsInit(&s_lunar_events);
+  if (s_lunar_events.propagator == NULL) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "no room for the event propagator, searching in full");
+  }
   tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
   
   
   battery_state_service_subscribe(battery_handler);
   
+  // A zeroed chunk holds room for the ones to come
+  static const uint8_t no_chunk[EPH_FEED_CHUNK_SIZE];
   Tuplet initial_values[] = {
-    TupletInteger(KEY_LONGITUDE, (int32_t) 0),
-    TupletInteger(KEY_LATITUDE,  (int32_t) 0),
+    TupletInteger(KEY_LOCATION, (int32_t) 0),
+    TupletBytes(KEY_EPHEMERIS, no_chunk, sizeof(no_chunk)),
   };   
 
-  app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum());
+  app_message_open(INBOX_SIZE, OUTBOX_SIZE);
   
   app_sync_init(&s_sync, s_sync_buffer, sizeof(s_sync_buffer), 
       initial_values, ARRAY_LENGTH(initial_values),
       sync_tuple_changed_callback, sync_error_callback, NULL
   );  
   
+  // After app_sync_init(), whose initial values would overwrite it
+  restore_state();
+  s_refine_pending = true;
+  s_refine_timer = app_timer_register(REFINE_DELAY, handle_refine_timer, NULL);
+  
   requestLocation();
-  pt = gmtime(&now);
-  then = time(NULL);
+  APP_LOG(APP_LOG_LEVEL_INFO, "heap %d used, %d free",
+          (int)heap_bytes_used(), (int)heap_bytes_free());
 }
 
 
 static void deinit() {
+  save_state();
+  if (s_refine_timer != NULL) {
+    app_timer_cancel(s_refine_timer);
+  }
+  if (s_request_timer != NULL) {
+    app_timer_cancel(s_request_timer);
+  }
+  lunarEventsDeinit(&s_lunar_events);
   // Destroy main Window
   window_destroy(s_main_window);
   //app_sync_deinit(&s_sync);
@@ -931,4 +857,5 @@ int main(void) {
   init();
   app_event_loop();
   deinit();
-}
\ No newline at end of file
+  return 0;
+}
@@ -1,44 +1,29 @@
 #pragma once
 #include <pebble.h>
-  
-/*  
-static const GPathInfo LUNA_PATH_POINTS = {
-  26, (GPoint []){
-    {0,0},  {0,8},  {1,8},  {2,8},  {3,7},
-    {4,7},  {5,6},  {6,6},  {6,5},  {7,4},
-    {7,3},  {8,2},  {8,1},  {8,0},  {8,-1},
-    {8,-2}, {7,-3}, {7,-4}, {6,-5}, {6,-6},
-    {5,-6}, {4,-7}, {3,-7}, {2,-8}, {1,-8},
-    {0,-8}
-  }
-};
-*/
-
 
-static const GPathInfo LUNA_PATH_POINTS = {
-  30, (GPoint []){
-    {0,0},   {0,10},  {1,10},  {2,10},  {3,10},
-    {4,9},    {5,9},   {6,8},   {7,7},   {8,6},
-    {9,5},    {9,4},  {10,3},  {10,2},  {10,1},
-    {10,0}, {10,-1}, {10,-2}, {10,-3},  {9,-4},
-    {9,-5},  {8,-6},  {7,-7},  {6,-8},  {5,-9},
-    {4,-9}, {3,-10}, {2,-10}, {1,-10},  {0,-10}
-  }
-};  
-  
+// LUNA_LEAN is the build for the platforms with 24 KB for code, data
+// and heap together, see LEAN_PLATFORMS in wscript.  It keeps half the
+// phase sprites, at one bit a pixel on their black and white screens,
+// and redraws the orbit rather than keeping a copy of it.
 
-#ifndef M_PI 
-  #define M_PI 3.1415926535897932384626433832795 
+// The moon is a disc of PHASE_RADIUS pixels, white on the side facing
+// the sun and dark gray on the other.  It is rendered once for each of
+// PHASE_SPRITES steps of the sun's hour angle, at the middle of the
+// step, into one 2 bit palettized atlas of PHASE_SIZE square sprites
+// stacked top to bottom.  A pixel is in the disc when x^2 + y^2 <=
+// r^2 + r, the outline of the 30 point path it used to be filled from.
+#ifdef LUNA_LEAN
+#define PHASE_SPRITES 32
+#else
+#define PHASE_SPRITES 64
 #endif
+#define PHASE_RADIUS  10
+#define PHASE_SIZE    (2 * PHASE_RADIUS + 1)
 
-// adjustment arguments in degrees
-// a1 = venus
-// a2 = jupiter
-static const double a1a = 119.75;
-static const double a1b = 131.849;
-static const double a2a = 53.09;
-static const double a2b = 479264.290;
-static const double a3a = 313.45;
-static const double a3b = 481266.484;
-
-static const double obliquityE = 23.4392911;  
+// Palette indices in the atlas.  On black and white screens it is one
+// bit a pixel instead, set where lit.
+enum {
+  PHASE_CLEAR = 0,
+  PHASE_DARK = 1,
+  PHASE_LIT = 2,
+};
@@ -0,0 +1,355 @@
+/*
+ * lunar_events.c
+ * Search for the next lunar events, see lunar_events.h.
+ * Meeus - Astronomical Algorithms - chapters 15, 47 and 49
+ */
+
+#include <stdlib.h>
+#include "lunar_events.h"
+#include "ephemeris.h"
+#include "ephemeris_propagator.h"
+#include "lunar_terms.h"
+
+#define SECONDS_PER_DAY 86400
+#define HOUR            3600
+
+// Apparent altitude of the moon's center at rise and set, as sin(h0).
+// Meeus - Astronomical Algorithms - chapter 15: h0 = 0.7275 * parallax
+// - 0m34s, +0.125 deg at the mean parallax.
+#define SIN_RISE_ALTITUDE 0.0021816616
+
+// Mean motions in degrees per day: hour angle, elongation, anomaly
+#define HOUR_ANGLE_RATE   347.8
+#define ELONGATION_RATE   12.190749
+#define ANOMALY_RATE      13.064993
+
+// Half width of the range derivative, seconds
+#define SLOPE_STEP        300
+
+// A local search is retried this often when it found nothing, for
+// example while the moon is circumpolar.
+#define SEARCH_RETRY      HOUR
+
+// Changes sign from negative to positive at the event.
+typedef double (*EventFunction)(LunarEvents *events, time_t t, double target);
+
+typedef struct {
+  EventFunction function;
+  double target;         // passed to function
+  double margin;         // days, the scan starts this far before the prediction
+  int32_t step;          // seconds between samples while scanning
+} EventSearch;
+
+
+// Set to events->propagator while scan() samples at even steps
+static MoonPropagator *s_propagator;
+static int32_t s_propagator_step;
+static bool s_propagator_anchored;
+
+// Position of the moon at t, the epoch built from it.  During a scan
+// the first position anchors the propagator and a time one step on
+// from it is stepped to; anything else is evaluated in full.
+static void moonAt(LunarEvents *events, time_t t, const Epoch *epoch, MoonPosition *moon) {
+  MoonPropagator *p = s_propagator;
+
+  if (p != NULL && s_propagator_anchored && t == p->when + p->step) {
+    moonPropagatorStep(p);
+    moonPropagatorPosition(p, moon);
+    events->steps++;
+  } else if (p != NULL && !s_propagator_anchored) {
+    moonPropagatorStart(p, t, s_propagator_step);
+    moonPropagatorPosition(p, moon);
+    s_propagator_anchored = true;
+    events->evaluations++;
+  } else {
+    moonPositionAt(epoch, moon);
+    events->evaluations++;
+  }
+}
+
+
+// Direction of the moon for the stored location: the equatorial
+// coordinates turned by the local sidereal time.
+typedef struct {
+  double x;              // cos(dec) cos(hour angle)
+  double y;              // cos(dec) sin(hour angle)
+  double z;              // sin(dec)
+  double sinLatitude;
+  double cosLatitude;
+} Horizon;
+
+static void moonHorizon(LunarEvents *events, time_t t, Horizon *h) {
+  Epoch epoch;
+  double sl,cl,sb,cb,se,ce,st,ct;
+  MoonPosition moon;
+
+  epochFromTime(&epoch, t);
+  moonAt(events, t, &epoch, &moon);
+
+  sincosx(radians(moon.longitude), &sl, &cl);
+  sincosx(radians(moon.latitude), &sb, &cb);
+  sincosx(radians(obliquityE), &se, &ce);
+  sincosx(radians(epoch.gst - (double)events->longitude / LUNAR_LOCATION_SCALE),
+          &st, &ct);
+  sincosx(radians((double)events->latitude / LUNAR_LOCATION_SCALE), &h->sinLatitude, &h->cosLatitude);
+
+  // Meeus - Astronomical Algorithms - formulae 13.3 and 13.4
+  double x = cb * cl;                    // cos(dec) cos(RA)
+  double y = cb * sl * ce - sb * se;     // cos(dec) sin(RA)
+  h->z = sb * ce + cb * sl * se;
+  h->x = ct * x + st * y;
+  h->y = st * x - ct * y;
+}
+
+
+// Meeus - Astronomical Algorithms - formula 13.6
+static double riseFunction(LunarEvents *events, time_t t, double target) {
+  Horizon h;
+  moonHorizon(events, t, &h);
+  return h.sinLatitude * h.z + h.cosLatitude * h.x - SIN_RISE_ALTITUDE;
+}
+
+
+static double setFunction(LunarEvents *events, time_t t, double target) {
+  return -riseFunction(events, t, target);
+}
+
+
+// Upper transit only: at the lower one sin(H) goes the other way.
+static double transitFunction(LunarEvents *events, time_t t, double target) {
+  Horizon h;
+  moonHorizon(events, t, &h);
+  return h.y;
+}
+
+
+// Quarter phases are multiples of 90 degrees of the moon's longitude
+// less the sun's.
+// Meeus - Astronomical Algorithms - chapter 49
+static double phaseFunction(LunarEvents *events, time_t t, double target) {
+  Epoch epoch;
+  MoonPosition moon;
+
+  epochFromTime(&epoch, t);
+  moonAt(events, t, &epoch, &moon);
+  return sinx(radians(moon.longitude - sunLongitudeAt(&epoch) - target));
+}
+
+
+// Rate of change of the range, miles per 2 * SLOPE_STEP seconds.
+static double perigeeFunction(LunarEvents *events, time_t t, double target) {
+  Epoch epoch;
+  MoonPosition before,after;
+
+  epochFromTime(&epoch, t - SLOPE_STEP);
+  moonAt(events, t - SLOPE_STEP, &epoch, &before);
+  epochFromTime(&epoch, t + SLOPE_STEP);
+  moonAt(events, t + SLOPE_STEP, &epoch, &after);
+  return after.range - before.range;
+}
+
+
+static double apogeeFunction(LunarEvents *events, time_t t, double target) {
+  return -perigeeFunction(events, t, target);
+}
+
+
+// Closes a bracket f(t0) < 0 <= f(t1) to LUNAR_EVENT_TOLERANCE with
+// the Illinois variant of regula falsi, returns the end where f >= 0.
+static time_t refine(LunarEvents *events, const EventSearch *search,
+                     time_t t0, double f0, time_t t1, double f1) {
+  int side = 0;
+
+  for (int iteration = 0; iteration < 24 && t1 - t0 > LUNAR_EVENT_TOLERANCE; iteration++) {
+    time_t t = t0 + (time_t)((t1 - t0) * (f0 / (f0 - f1)));
+    if (t <= t0) {
+      t = t0 + 1;
+    } else if (t >= t1) {
+      t = t1 - 1;
+    }
+
+    double f = search->function(events, t, search->target);
+    if (f < 0) {
+      t0 = t;
+      f0 = f;
+      if (side < 0) {
+        f1 /= 2.0;
+      }
+      side = -1;
+    } else {
+      t1 = t;
+      f1 = f;
+      if (side > 0) {
+        f0 /= 2.0;
+      }
+      side = 1;
+    }
+  }
+  return t1;
+}
+
+
+// First rising zero of the search function in [start, end], 0 if none.
+static time_t scan(LunarEvents *events, const EventSearch *search, time_t start, time_t end) {
+  time_t t0 = start, t1 = start;
+  double f0, f1 = 0;
+  bool found = false;
+
+  // The samples are evenly spaced, so the moon is stepped between them
+  s_propagator = events->propagator;
+  s_propagator_step = search->step;
+  s_propagator_anchored = false;
+
+  f0 = search->function(events, t0, search->target);
+  while (t0 < end) {
+    t1 = t0 + search->step;
+    f1 = search->function(events, t1, search->target);
+    if (f0 < 0 && f1 >= 0) {
+      found = true;
+      break;
+    }
+    t0 = t1;
+    f0 = f1;
+  }
+
+  s_propagator = NULL;
+  return found ? refine(events, search, t0, f0, t1, f1) : 0;
+}
+
+
+// Scan window around the time at which a mean angle, now at angle and
+// moving at rate degrees per day, next comes to 0 modulo 360, or the
+// one so many cycles later.  An event up to margin days early is not
+// pushed back a whole cycle.
+static void scanFrom(const EventSearch *search, time_t now, double angle, double rate,
+                     int cycles, time_t *start, time_t *end) {
+  double lead = search->margin * rate;
+  double days = (normDegrees(lead - angle) - lead + 360.0 * cycles) / rate;
+
+  *start = now + (time_t)((days - search->margin) * SECONDS_PER_DAY);
+  *end = now + (time_t)((days + search->margin) * SECONDS_PER_DAY) + search->step;
+  if (*start < now) {
+    *start = now;
+  }
+}
+
+
+// Hour angle of the moon, degrees, and the hour angle at which it
+// crosses the rise and set altitude, negative if it never does.
+// Meeus - Astronomical Algorithms - formula 15.1
+static void hourAngles(LunarEvents *events, time_t now, double *hourAngle, double *riseSet) {
+  Horizon h;
+
+  moonHorizon(events, now, &h);
+  *hourAngle = normDegrees(degrees(atan2x(h.y, h.x)));
+
+  double cosDeclination = sqrtx(h.x * h.x + h.y * h.y);
+  double c = (SIN_RISE_ALTITUDE - h.sinLatitude * h.z) / (h.cosLatitude * cosDeclination);
+  if (h.cosLatitude < 1e-6 || c <= -1.0 || c >= 1.0) {
+    *riseSet = -1.0;
+  } else {
+    *riseSet = degrees(atan2x(sqrtx(1.0 - c * c), c));
+  }
+}
+
+
+static const EventSearch s_searches[LUNAR_EVENTS] = {
+  [LUNAR_RISE]          = { riseFunction,      0.0, 2.0 / 24.0, HOUR },
+  [LUNAR_SET]           = { setFunction,       0.0, 2.0 / 24.0, HOUR },
+  [LUNAR_TRANSIT]       = { transitFunction,   0.0, 2.0 / 24.0, HOUR },
+  [LUNAR_NEW_MOON]      = { phaseFunction,     0.0, 1.5, 12 * HOUR },
+  [LUNAR_FIRST_QUARTER] = { phaseFunction,    90.0, 1.5, 12 * HOUR },
+  [LUNAR_FULL_MOON]     = { phaseFunction,   180.0, 1.5, 12 * HOUR },
+  [LUNAR_LAST_QUARTER]  = { phaseFunction,   270.0, 1.5, 12 * HOUR },
+  [LUNAR_PERIGEE]       = { perigeeFunction,   0.0, 3.0, 12 * HOUR },
+  [LUNAR_APOGEE]        = { apogeeFunction,  180.0, 3.0, 12 * HOUR },
+};
+
+
+void lunarEventsInit(LunarEvents *events) {
+  for (int event = 0; event < LUNAR_EVENTS; event++) {
+    events->when[event] = 0;
+    events->expires[event] = 0;
+  }
+  events->latitude = 0;
+  events->longitude = 0;
+  events->evaluations = 0;
+  events->steps = 0;
+  events->propagator = malloc(sizeof(MoonPropagator));
+}
+
+
+void lunarEventsDeinit(LunarEvents *events) {
+  free(events->propagator);
+  events->propagator = NULL;
+}
+
+
+bool lunarEventsUpdate(LunarEvents *events, time_t now,
+                       int32_t latitude, int32_t longitude) {
+  bool changed = false;
+  bool haveHourAngles = false;
+  bool haveMeans = false;
+  double hourAngle = 0, riseSet = 0, elongation = 0, anomaly = 0;
+
+  if (latitude != events->latitude || longitude != events->longitude) {
+    events->latitude = latitude;
+    events->longitude = longitude;
+    events->expires[LUNAR_RISE] = 0;
+    events->expires[LUNAR_SET] = 0;
+    events->expires[LUNAR_TRANSIT] = 0;
+  }
+
+  for (int event = 0; event < LUNAR_EVENTS; event++) {
+    const EventSearch *search = &s_searches[event];
+    double angle = 0, rate = 0;
+    time_t start,end,when = 0;
+
+    if (now < events->expires[event]) {
+      continue;
+    }
+
+    // Predict from the mean motions, one evaluation for a group
+    if (event <= LUNAR_TRANSIT) {
+      if (!haveHourAngles) {
+        hourAngles(events, now, &hourAngle, &riseSet);
+        haveHourAngles = true;
+      }
+      if (event == LUNAR_TRANSIT) {
+        angle = hourAngle;
+        rate = HOUR_ANGLE_RATE;
+      } else if (riseSet >= 0) {
+        angle = hourAngle - (event == LUNAR_RISE ? -riseSet : riseSet);
+        rate = HOUR_ANGLE_RATE;
+      }
+    } else {
+      if (!haveMeans) {
+        Epoch epoch;
+        MoonPosition moon;
+        epochFromTime(&epoch, now);
+        moonPositionAt(&epoch, &moon);
+        events->evaluations++;
+        elongation = moon.longitude - sunLongitudeAt(&epoch);
+        anomaly = degrees(epoch.Mm);
+        haveMeans = true;
+      }
+      angle = (event <= LUNAR_LAST_QUARTER ? elongation : anomaly) - search->target;
+      rate = event <= LUNAR_LAST_QUARTER ? ELONGATION_RATE : ANOMALY_RATE;
+    }
+
+    // If the window around an early prediction has already gone by
+    // the event is in the next cycle
+    for (int cycles = 0; rate > 0 && cycles < 2 && !when; cycles++) {
+      scanFrom(search, now, angle, rate, cycles, &start, &end);
+      if (end > start) {
+        when = scan(events, search, start, end);
+      }
+    }
+    events->expires[event] = when ? when : now + SEARCH_RETRY;
+    if (when != events->when[event]) {
+      events->when[event] = when;
+      changed = true;
+    }
+  }
+  return changed;
+}
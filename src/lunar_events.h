@@ -0,0 +1,62 @@
+#pragma once
+/*
+ * lunar_events.h
+ * Times of the next moonrise, moonset, transit, quarter phases, perigee
+ * and apogee.
+ *
+ * Each event is found by stepping a function of time that changes sign
+ * at the event until it is bracketed, then closing the bracket with the
+ * Illinois variant of regula falsi.  Steps start from a prediction made
+ * with the mean motions, so an event costs a few ephemeris calls.  The
+ * steps are evenly spaced, so after the first the moon is carried from
+ * one to the next by ephemeris_propagator.h instead.  Its propagator
+ * is 4 KB, so it is allocated once by lunarEventsInit() rather than for
+ * every search.
+ * Results are kept until the event has passed, or for rise, set and
+ * transit until the location changes, so lunarEventsUpdate() is free
+ * on almost every frame.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "ephemeris_propagator.h"
+
+enum {
+  LUNAR_RISE,
+  LUNAR_SET,
+  LUNAR_TRANSIT,
+  LUNAR_NEW_MOON,
+  LUNAR_FIRST_QUARTER,
+  LUNAR_FULL_MOON,
+  LUNAR_LAST_QUARTER,
+  LUNAR_PERIGEE,
+  LUNAR_APOGEE,
+  LUNAR_EVENTS
+};
+
+// Events are found to within this many seconds.
+#define LUNAR_EVENT_TOLERANCE 30
+
+// Latitude and longitude are in 1/LUNAR_LOCATION_SCALE degrees.  A
+// quarter degree of longitude is a minute of moon time, the finest
+// step the face shows.
+#define LUNAR_LOCATION_SCALE 4
+
+typedef struct {
+  time_t when[LUNAR_EVENTS];     // 0 if there is none before expires[]
+  time_t expires[LUNAR_EVENTS];  // search again once now reaches this
+  int32_t latitude;              // north, see LUNAR_LOCATION_SCALE
+  int32_t longitude;             // west, as userLongitude in luna.c
+  unsigned int evaluations;      // ephemeris calls so far
+  unsigned int steps;            // positions stepped to instead, see scan()
+  MoonPropagator *propagator;    // NULL if it could not be allocated
+} LunarEvents;
+
+void lunarEventsInit(LunarEvents *events);
+void lunarEventsDeinit(LunarEvents *events);
+
+// Refreshes the events that have passed, or all the local ones if the
+// location moved.  Returns true if any time in events->when changed.
+bool lunarEventsUpdate(LunarEvents *events, time_t now,
+                       int32_t latitude, int32_t longitude);
@@ -0,0 +1,149 @@
+#pragma once
+/*
+ * lunar_terms.h
+ * Meeus - Astronomical Algorithms - chapter 47: the fundamental
+ * arguments, inline so that loops over them can be vectorised, and
+ * tables 47.A and 47.B.
+ *
+ * The tables are generated at build time by tools/lunar_tables.py into
+ * lunar_tables.c, as structs of arrays sorted by amplitude.  Table 47.A
+ * is there in full for code that wants longitude and range from one
+ * argument; each sum also has a dense table of only its non-zero terms.
+ */
+
+#include <stdint.h>
+
+// Terms in each of tables 47.A and 47.B
+#define LUNAR_TERMS 60
+
+typedef struct {
+  int count;
+  const int8_t *D;          // multiples of D, M, M' and F
+  const int8_t *M;
+  const int8_t *Mm;
+  const int8_t *F;
+  const uint8_t *E;         // power of E the term is scaled by, |M|
+  const int32_t *sine;      // 1e-6 degrees, or NULL
+  const int32_t *cosine;    // 1e-3 km, or NULL
+} LunarSeries;
+
+// Table 47.A, longitude (sine) and range (cosine) terms
+extern const LunarSeries lunarLongitudeRangeSeries;
+// Table 47.A, non-zero longitude terms only
+extern const LunarSeries lunarLongitudeSeries;
+// Table 47.A, non-zero range terms only
+extern const LunarSeries lunarRangeSeries;
+// Table 47.B, latitude terms
+extern const LunarSeries lunarLatitudeSeries;
+
+// Precision tiers: how many of the largest terms of each dense table
+// the series sum.  A tier is chosen per build with LUNAR_PRECISION (see
+// the --precision option in wscript) and can be changed at run time
+// through lunarPrecision.  While a tier keeps every longitude and range
+// term they are summed from the combined table 47.A, one sincos a term.
+// host/precision_check reports what each tier changes on screen.  Keep
+// in the order of TIERS in the generator.
+typedef enum {
+  LUNAR_PRECISION_FULL,
+  LUNAR_PRECISION_SCREEN,     // latitude to 0.01 deg, moves Rise and Set
+  LUNAR_PRECISION_LOW,        // terms down to 0.01 deg and 10 km
+  LUNAR_PRECISION_MINIMAL,    // terms down to 0.1 deg and 100 km
+  LUNAR_PRECISIONS
+} LunarPrecision;
+
+typedef struct {
+  const char *name;
+  uint8_t longitude;        // terms of lunarLongitudeSeries
+  uint8_t range;            // terms of lunarRangeSeries
+  uint8_t latitude;         // terms of lunarLatitudeSeries
+} LunarTier;
+
+// The cheapest tier that draws the same face as the full series.  The
+// moonrise and moonset search needs every latitude term.
+#ifndef LUNAR_PRECISION
+#define LUNAR_PRECISION LUNAR_PRECISION_FULL
+#endif
+
+extern const LunarTier lunarTiers[LUNAR_PRECISIONS];
+extern LunarPrecision lunarPrecision;
+
+// Whether the tier keeps all of table 47.A
+static inline int lunarTierComplete(const LunarTier *tier) {
+  return tier->longitude == lunarLongitudeSeries.count && tier->range == lunarRangeSeries.count;
+}
+
+
+// Calculate the moon's mean longitude, measured in degrees [L']
+// Meeus - Astronomical Algorithms - formula 47.1
+static inline double moonMeanLongitude(double T) {
+  return 218.3164477 
+         + 481267.88123421 * T 
+         - 0.0015786 * T * T 
+         + T * T * T/538841.0 
+         - T * T * T * T/65194000.0;
+}
+
+
+// Calculate the moon's mean elongation, measured in degrees [D]
+// Meeus - Astronomical Algorithms - formula 47.2
+static inline double moonMeanElongation(double T) {
+  return 297.8501921 
+         + 445267.1114034 * T 
+         - 0.0018819 * T * T 
+         + T * T * T/544868.0 
+         - T * T * T * T/113065000.0;
+}
+
+
+// Calculate the sun's mean anomaly, measured in degrees [M]
+// Meeus - Astronomical Algorithms - formula 47.3
+static inline double sunMeanAnomaly(double T) {
+  return 357.5291092
+         + 35999.0502909 * T 
+         - 0.0001536 * T * T 
+         + T * T * T / 24490000.0;
+}
+
+
+// Calculate the moon's mean anomaly, measured in degrees [M']
+// Meeus - Astronomical Algorithms - formula 47.4
+static inline double moonMeanAnomaly(double T) {
+  return 134.9633964
+         + 477198.8675055 * T 
+         + 0.0087414 * T * T 
+         + T * T * T / 69699.0
+         - T * T * T * T / 14712000.0;
+}
+
+
+// Calculate the moon's argument of latitude, measured in degrees [F]
+// Meeus - Astronomical Algorithms - formula 47.5
+static inline double moonArgLatitude(double T) {
+  return 93.2720950
+         + 483202.0175233 * T 
+         - 0.0036539 * T * T 
+         - T * T * T/3526000.0
+         + T * T * T * T/863310000.0;
+}
+
+
+static inline double Eccentricity(double T) {
+  return 1.0 - 0.002516 * T - 0.0000074 * T * T;
+}
+
+
+// Daily motions of L', D, M, M' and F, degrees per day: the linear
+// terms of formulae 47.1 to 47.5 over the 36525 days of a century.
+// The T^2 and later terms move them by less than a part in a million.
+#define LUNAR_L_RATE  (481267.88123421 / 36525.0)
+#define LUNAR_D_RATE  (445267.1114034 / 36525.0)
+#define LUNAR_M_RATE  (35999.0502909 / 36525.0)
+#define LUNAR_MM_RATE (477198.8675055 / 36525.0)
+#define LUNAR_F_RATE  (483202.0175233 / 36525.0)
+
+// Daily motion of a term's argument, radians per day
+static inline double lunarTermRate(const LunarSeries *series, int term) {
+  return (series->D[term] * LUNAR_D_RATE + series->M[term] * LUNAR_M_RATE +
+          series->Mm[term] * LUNAR_MM_RATE + series->F[term] * LUNAR_F_RATE) *
+         (3.14159265358979323846 / 180.0);
+}
@@ -1,23 +1,35 @@
 var mConfig = {};
 var id;
+// A fix up to half an hour old is reused rather than waking the GPS;
+// the moon time moves a minute for a quarter degree of longitude.
 //var locationOptions = {"enableHighAccuracy": true, "timeout":60000, "maximumAge": 0};
-var locationOptions = {"timeout":60000, "maximumAge": 0};
-var intLongitude;
-var intLatitude;
-var transactionID;
+var locationOptions = {"enableHighAccuracy": false, "timeout": 60000, "maximumAge": 30 * 60 * 1000};
+
+// Locations go both ways as one int32, see KEY_LOCATION in luna.c
+var LOCATION_SCALE = 4;              // LUNAR_LOCATION_SCALE, per degree
+var LOCATION_UNKNOWN = -2147483648;
+var watchLocation = LOCATION_UNKNOWN;
 
 Pebble.addEventListener("ready", function(e) {
 	console.log("luna is ready");
-  //id = navigator.geolocation.watchPosition(locationSuccess, locationError, locationOptions);
-  id = navigator.geolocation.getCurrentPosition(locationSuccess, locationError, locationOptions);
+  // The watch asks for a location when it starts, with the one it shows
   //loadLocalData();
   //returnConfigToPebble();
 });
 
 Pebble.addEventListener("appmessage", function(e) {
+  if (e.payload.KEY_PROFILE) {
+    profileReceived(e.payload.KEY_PROFILE);
+    return;
+  }
+  if (e.payload.KEY_LOCATION !== undefined) {
+    watchLocation = e.payload.KEY_LOCATION;
+  }
+  if (e.payload.KEY_EPHEMERIS !== undefined &&
+      e.payload.KEY_EPHEMERIS - Date.now() / 1000 < FEED_REFRESH) {
+    sendFeed(Date.now() / 1000, e.payload.KEY_EPHEMERIS);
+  }
   navigator.geolocation.getCurrentPosition(locationSuccess, locationError, locationOptions);
-  //console.log(e.type);
-  //console.log("message!");
 });
 
 Pebble.addEventListener("showConfiguration", function(e) {
@@ -110,25 +122,240 @@ function returnConfigToPebble() {
 
 
 
+// Frame profiler batches from src/profile.c (LUNA_PROFILE builds only).
+// Layout: version, stages, records, heap high water (u32), milliseconds
+// from launch to the first correct frame (u32, all ones if none yet),
+// then per record one u16 of milliseconds per stage and the heap used
+// (u32).
+var profileStages = ["ephemeris", "sidereal", "drawing", "text", "frame"];
+var profileTotals = null;
+var profileFrames = 0;
+var profileHeapHighWater = 0;
+
+function profileReceived(bytes) {
+  var u16 = function(i) { return bytes[i] | (bytes[i + 1] << 8); };
+  var u32 = function(i) { return (u16(i) + u16(i + 2) * 65536); };
+  var version = bytes[0];
+  var stages = bytes[1];
+  var records = bytes[2];
+  var firstCorrect = u32(7);
+  var offset = 11;
+
+  if (version != 2 || stages != profileStages.length) {
+    console.log("profile: unknown batch version " + version);
+    return;
+  }
+  if (profileTotals === null) {
+    profileTotals = profileStages.map(function() { return {sum: 0, max: 0}; });
+  }
+  profileHeapHighWater = Math.max(profileHeapHighWater, u32(3));
+  for (var r = 0; r < records; r++) {
+    for (var s = 0; s < stages; s++) {
+      var ms = u16(offset + 2 * s);
+      profileTotals[s].sum += ms;
+      profileTotals[s].max = Math.max(profileTotals[s].max, ms);
+    }
+    offset += 2 * stages + 4;
+  }
+  profileFrames += records;
+
+  var line = "profile: " + profileFrames + " frames";
+  for (s = 0; s < stages; s++) {
+    line += ", " + profileStages[s] + " " + (profileTotals[s].sum / profileFrames).toFixed(1) +
+            "/" + profileTotals[s].max + " ms";
+  }
+  line += ", heap high water " + profileHeapHighWater + " bytes";
+  if (firstCorrect != 0xffffffff) {
+    line += ", first correct frame " + firstCorrect + " ms after launch";
+  }
+  console.log(line);
+}
+
+
+// Longitude east in the low 16 bits and latitude north in the high 16,
+// each a signed count of 1/LOCATION_SCALE degrees.
+function packLocation(longitude, latitude) {
+  var east = Math.round(longitude * LOCATION_SCALE);
+  var north = Math.round(latitude * LOCATION_SCALE);
+  return ((north & 0xffff) << 16) | (east & 0xffff);
+}
+
+// Only a fix that moves the watch by a step it can show is sent.
 function locationSuccess(pos){
     var coordinates = pos.coords;
-    var changed = 0;
-    if (intLongitude != Math.round( coordinates.longitude )) {
-          intLongitude = Math.round ( coordinates.longitude);
-          changed = 1;
-        }
-    if (intLatitude != Math.round( coordinates.latitude )) {
-          intLatitude = Math.round ( coordinates.latitude );
-          changed = 1;
-        }
-    if (Boolean(changed)) {
-      transactionID = Pebble.sendAppMessage({ 
-        "KEY_LONGITUDE": coordinates.longitude,
-        "KEY_LATITUDE" : coordinates.latitude
+    var location = packLocation(coordinates.longitude, coordinates.latitude);
+    if (location != watchLocation) {
+      queueMessage({ "KEY_LOCATION": location }, function() {
+        watchLocation = location;
       });
     }
 }
 
 function locationError(err){
     console.log("Error getting location.");
+}
+
+
+// One message in flight at a time.  After a failure the rest are
+// dropped; the watch asks again for what it is missing.
+var outbox = [];
+
+function queueMessage(message, sent) {
+  outbox.push({ message: message, sent: sent });
+  if (outbox.length == 1) {
+    sendNext();
+  }
+}
+
+function sendNext() {
+  if (outbox.length === 0) {
+    return;
+  }
+  var next = outbox[0];
+  Pebble.sendAppMessage(next.message, function(e) {
+    outbox.shift();
+    if (next.sent) {
+      next.sent();
+    }
+    sendNext();
+  }, function(e) {
+    console.log("Error sending to the watch.");
+    outbox = [];
+  });
+}
+
+
+// Phone side ephemeris, see src/ephemeris_feed.h.  The windows are the
+// Chebyshev fits of src/ephemeris_cache.c over the series of
+// src/ephemeris.c, with table 47.A from lunar_terms.js, which wscript
+// generates and appends to this file.
+var FEED_WINDOW = 4 * 60 * 60;       // EPH_CACHE_WINDOW, seconds
+var FEED_TERMS = 8;                  // EPH_CACHE_TERMS
+var FEED_WINDOWS = 6;                // EPH_FEED_WINDOWS
+var FEED_VERSION = 1;
+var FEED_ANGLE_UNITS = 1000000;      // per degree
+var FEED_RANGE_UNITS = 1000;         // per mile
+// Sent once the watch holds less than this ahead, seconds, as
+// FEED_REFRESH in luna.c
+var FEED_REFRESH = 4 * 60 * 60;
+
+var J2000_UNIX = 946728000;
+var COS_OBLIQUITY = Math.cos(23.4392911 * Math.PI / 180);
+
+function radians(d) {
+  return d * Math.PI / 180;
+}
+
+function normDegrees(d) {
+  d = d % 360;
+  return d < 0 ? d + 360 : d;
+}
+
+// Meeus - Astronomical Algorithms - chapter 47, longitude in degrees
+// and range in miles
+function moonLongitudeRange(T) {
+  var L = 218.3164477 + 481267.88123421 * T - 0.0015786 * T * T +
+          T * T * T / 538841 - T * T * T * T / 65194000;
+  var D = radians(297.8501921 + 445267.1114034 * T - 0.0018819 * T * T +
+                  T * T * T / 544868 - T * T * T * T / 113065000);
+  var M = radians(357.5291092 + 35999.0502909 * T - 0.0001536 * T * T +
+                  T * T * T / 24490000);
+  var Mm = radians(134.9633964 + 477198.8675055 * T + 0.0087414 * T * T +
+                   T * T * T / 69699 - T * T * T * T / 14712000);
+  var F = radians(93.2720950 + 483202.0175233 * T - 0.0036539 * T * T -
+                  T * T * T / 3526000 + T * T * T * T / 863310000);
+  var E = 1 - 0.002516 * T - 0.0000074 * T * T;
+  var longitude = 0;
+  var range = 0;
+
+  for (var i = 0; i < LUNAR_TABLE_47A.length; i++) {
+    var term = LUNAR_TABLE_47A[i];
+    var e = Math.pow(E, Math.abs(term[1]));
+    var arg = term[0] * D + term[1] * M + term[2] * Mm + term[3] * F;
+    longitude += term[4] * e * Math.sin(arg);
+    range += term[5] * e * Math.cos(arg);
+  }
+  longitude += 3958 * Math.sin(radians(119.75 + 131.849 * T)) +
+               1962 * Math.sin(radians(L) - F) +
+               318 * Math.sin(radians(53.09 + 479264.290 * T));
+
+  return [normDegrees(L + longitude / 1000000), 0.62137119 * (385000.56 + range / 1000)];
+}
+
+// Right ascension of an ecliptic longitude, as eclipticRA()
+function eclipticRA(L) {
+  return normDegrees(Math.atan2(Math.sin(radians(L)) * COS_OBLIQUITY, Math.cos(radians(L))) * 180 / Math.PI);
+}
+
+function sunRA(T) {
+  var d = T * 36525;
+  var g = 357.5291092 + 35999.0502909 * T - 0.0001536 * T * T + T * T * T / 24490000;
+  return eclipticRA(280.461 + 0.9856474 * d + 1.915 * Math.sin(radians(g)) +
+                    0.020 * Math.sin(radians(2 * g)));
+}
+
+// Coefficients of the window from start, as fitWindow() in
+// ephemeris_cache.c: longitude, range, moon RA, sun RA
+function fitFeedWindow(start) {
+  var half = FEED_WINDOW / 2;
+  var samples = [[], [], [], []];
+  var q, j, k;
+
+  for (k = 0; k < FEED_TERMS; k++) {
+    var t = start + half + half * Math.cos(Math.PI * (k + 0.5) / FEED_TERMS);
+    var T = (t - J2000_UNIX) / 86400 / 36525;
+    var moon = moonLongitudeRange(T);
+    samples[0].push(moon[0]);
+    samples[1].push(moon[1]);
+    samples[2].push(eclipticRA(moon[0]));
+    samples[3].push(sunRA(T));
+  }
+  // Angles made continuous over the window
+  [samples[0], samples[2], samples[3]].forEach(function(row) {
+    for (var k = 1; k < FEED_TERMS; k++) {
+      while (row[k] - row[k - 1] > 180) row[k] -= 360;
+      while (row[k] - row[k - 1] < -180) row[k] += 360;
+    }
+  });
+
+  var coefficients = [];
+  for (q = 0; q < 4; q++) {
+    coefficients.push([]);
+    for (j = 0; j < FEED_TERMS; j++) {
+      var sum = 0;
+      for (k = 0; k < FEED_TERMS; k++) {
+        sum += samples[q][k] * Math.cos(Math.PI * j * (k + 0.5) / FEED_TERMS);
+      }
+      coefficients[q].push(2 * sum / FEED_TERMS);
+    }
+  }
+  return coefficients;
+}
+
+function putInt32(bytes, v) {
+  bytes.push(v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >>> 24) & 0xff);
+}
+
+// The windows the watch does not hold, from the end of those it does,
+// or the one holding now, to a day of them from now, one chunk per
+// message
+function sendFeed(now, held) {
+  var current = Math.floor(now / FEED_WINDOW) * FEED_WINDOW;
+  var first = Math.max(current, held);
+  var count = (current + FEED_WINDOWS * FEED_WINDOW - first) / FEED_WINDOW;
+
+  for (var i = 0; i < count; i++) {
+    var start = first + i * FEED_WINDOW;
+    var coefficients = fitFeedWindow(start);
+    var bytes = [FEED_VERSION, i, count, 0];
+
+    putInt32(bytes, start);
+    for (var q = 0; q < 4; q++) {
+      var units = q == 1 ? FEED_RANGE_UNITS : FEED_ANGLE_UNITS;
+      for (var j = 0; j < FEED_TERMS; j++) {
+        putInt32(bytes, Math.round(coefficients[q][j] * units));
+      }
+    }
+    queueMessage({ "KEY_EPHEMERIS": bytes });
+  }
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+/*
+ * profile.c
+ * Frame profiler, see profile.h.
+ */
+
+#include "profile.h"
+
+#ifdef LUNA_PROFILE
+
+typedef struct {
+  uint16_t stage_ms[PROFILE_STAGES];
+  uint32_t heap_used;
+} ProfileRecord;
+
+// s_first_correct until there is one
+#define PROFILE_NOT_YET      0xffffffff
+
+static ProfileRecord s_records[PROFILE_RECORDS];
+static int s_next;
+static int s_count;
+static ProfileRecord s_current;
+static uint32_t s_started[PROFILE_STAGES];
+static uint32_t s_heap_high_water;
+static uint32_t s_launched;
+static uint32_t s_first_correct = PROFILE_NOT_YET;
+
+
+static uint32_t now_ms(void) {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t)seconds * 1000 + ms;
+}
+
+
+static void note_heap(void) {
+  uint32_t used = heap_bytes_used();
+  if (used > s_heap_high_water) {
+    s_heap_high_water = used;
+  }
+  s_current.heap_used = used;
+}
+
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+  return p + 2;
+}
+
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+  p = put_u16(p, v & 0xffff);
+  return put_u16(p, v >> 16);
+}
+
+
+// Sends the ring oldest first.  If the outbox is busy the records stay
+// and the oldest are overwritten until a later flush gets through.
+static void flush(void) {
+  static uint8_t s_batch[PROFILE_BATCH_SIZE];
+  DictionaryIterator *iter;
+  uint8_t *p = s_batch;
+
+  if (app_message_outbox_begin(&iter) != APP_MSG_OK || !iter) {
+    return;
+  }
+
+  *p++ = PROFILE_VERSION;
+  *p++ = PROFILE_STAGES;
+  *p++ = s_count;
+  p = put_u32(p, s_heap_high_water);
+  p = put_u32(p, s_first_correct);
+  for (int i = 0; i < s_count; i++) {
+    ProfileRecord *r = &s_records[(s_next - s_count + i + PROFILE_RECORDS) % PROFILE_RECORDS];
+    for (int stage = 0; stage < PROFILE_STAGES; stage++) {
+      p = put_u16(p, r->stage_ms[stage]);
+    }
+    p = put_u32(p, r->heap_used);
+  }
+
+  dict_write_data(iter, PROFILE_KEY, s_batch, p - s_batch);
+  dict_write_end(iter);
+  if (app_message_outbox_send() == APP_MSG_OK) {
+    s_count = 0;
+  }
+}
+
+
+void profile_begin(ProfileStage stage) {
+  s_started[stage] = now_ms();
+}
+
+
+// Stages entered more than once in a frame add up.
+void profile_end(ProfileStage stage) {
+  s_current.stage_ms[stage] += now_ms() - s_started[stage];
+  note_heap();
+}
+
+
+void profile_launch(void) {
+  s_launched = now_ms();
+  s_first_correct = PROFILE_NOT_YET;
+}
+
+
+// Only the first call after launch counts.
+void profile_frame_correct(void) {
+  if (s_first_correct == PROFILE_NOT_YET) {
+    s_first_correct = now_ms() - s_launched;
+  }
+}
+
+
+void profile_frame_end(void) {
+  note_heap();
+  s_records[s_next] = s_current;
+  s_next = (s_next + 1) % PROFILE_RECORDS;
+  if (s_count < PROFILE_RECORDS) {
+    s_count++;
+  }
+  memset(&s_current, 0, sizeof(s_current));
+
+  if (s_count == PROFILE_RECORDS) {
+    flush();
+  }
+}
+
+#endif
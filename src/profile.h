@@ -0,0 +1,71 @@
+#pragma once
+/*
+ * profile.h
+ * Frame profiler for the watch, built only with LUNA_PROFILE (see the
+ * --profile option in wscript).  Without it every macro below expands
+ * to nothing and profile.c is empty.
+ *
+ * Each frame records the milliseconds spent in each stage, from
+ * time_ms(), and heap_bytes_used() at the end of the frame.  Frames go
+ * into a ring of PROFILE_RECORDS; when it is full the whole ring is
+ * sent to pebble-js-app.js in one AppMessage under PROFILE_KEY, where
+ * it is aggregated and logged.
+ *
+ * Each batch also carries the milliseconds from PROFILE_LAUNCH() in
+ * init() to the first PROFILE_FRAME_CORRECT(), the first frame drawn
+ * for a known location with the events searched for it.
+ */
+
+#include <pebble.h>
+
+// AppMessage key of a batch of records, see appinfo.json
+#define PROFILE_KEY      2
+#define PROFILE_RECORDS  32
+
+// Layout version of the batch, checked by pebble-js-app.js
+#define PROFILE_VERSION  2
+
+typedef enum {
+  PROFILE_EPHEMERIS,     // moon and sun positions, lunar events
+  PROFILE_SIDEREAL,      // sidereal time, right ascension, hour angles
+  PROFILE_DRAWING,       // background, moon sprite, velocity line
+  PROFILE_TEXT,          // formatting the text fields
+  PROFILE_FRAME,         // the whole of canvas_update_proc
+  PROFILE_STAGES
+} ProfileStage;
+
+// Batch layout, little endian:
+//   version, stages, records (one byte each), heap high water (4 bytes),
+//   milliseconds to the first correct frame (4 bytes, all ones until
+//   there is one), then per record stage_ms[] (2 bytes each) and
+//   heap_used (4 bytes)
+#define PROFILE_HEADER_SIZE  11
+#define PROFILE_RECORD_SIZE  (2 * PROFILE_STAGES + 4)
+#define PROFILE_BATCH_SIZE   (PROFILE_HEADER_SIZE + PROFILE_RECORDS * PROFILE_RECORD_SIZE)
+
+// The batch as a dictionary, for sizing the outbox
+#define PROFILE_MESSAGE_SIZE (1 + 7 + PROFILE_BATCH_SIZE)
+
+#ifdef LUNA_PROFILE
+
+void profile_begin(ProfileStage stage);
+void profile_end(ProfileStage stage);
+void profile_frame_end(void);
+void profile_launch(void);
+void profile_frame_correct(void);
+
+#define PROFILE_BEGIN(stage)    profile_begin(stage)
+#define PROFILE_END(stage)      profile_end(stage)
+#define PROFILE_FRAME_END()     profile_frame_end()
+#define PROFILE_LAUNCH()        profile_launch()
+#define PROFILE_FRAME_CORRECT() profile_frame_correct()
+
+#else
+
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+#define PROFILE_FRAME_END()
+#define PROFILE_LAUNCH()
+#define PROFILE_FRAME_CORRECT()
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * schedule.c
+ * Prediction of the next visible change, see schedule.h.
+ */
+
+#include "schedule.h"
+#include "ephemeris.h"
+
+
+// Time for a value moving at rate per second to reach the next
+// multiple of step in the direction it moves.
+static double untilStep(double value, double rate, double step) {
+  double steps = value / step;
+  double fraction = steps - (double)(long)steps;
+
+  if (fraction < 0) {
+    fraction += 1.0;
+  }
+  if (rate > 0) {
+    fraction = 1.0 - fraction;
+  } else if (rate < 0) {
+    rate = -rate;
+  } else {
+    return 1e9;
+  }
+  if (fraction <= 0) {
+    fraction = 1.0;
+  }
+  return fraction * step / rate;
+}
+
+
+static void earliest(double *wait, double candidate) {
+  if (candidate < *wait) {
+    *wait = candidate;
+  }
+}
+
+
+double secondsUntilChange(const FrameState *frame) {
+  double wait = 1e9;
+
+  // Moon marker: a pixel along the orbit.  Its x or y alone can cross a
+  // pixel sooner, and is left to the tick.
+  earliest(&wait, untilStep(frame->moonHourAngle, MOON_HOUR_ANGLE_RATE,
+                            degrees(1.0 / frame->orbitRadius)));
+
+  // Terminator: the next phase sprite is due
+  earliest(&wait, untilStep(frame->sunHourAngle, SUN_HOUR_ANGLE_RATE, frame->phaseStep));
+
+  if (wait < SCHEDULE_MIN_WAIT) {
+    wait = SCHEDULE_MIN_WAIT;
+  }
+  return wait;
+}
@@ -0,0 +1,29 @@
+#pragma once
+/*
+ * schedule.h
+ * How long until the face would look different.
+ *
+ * From what the last frame showed, and how fast each quantity moves,
+ * works out when the next visible change is due: the moon marker
+ * moving a pixel along its orbit, or the next phase sprite.  The text
+ * is left to the minute tick.  The clock changes on the minute and the
+ * moon time a little less often, and waking for every mile of range or
+ * tenth of a mph would wake the face every 20 s or so.
+ */
+
+// Degrees of hour angle per second: sidereal rate less the mean motion
+// of the moon, and of the sun.
+#define MOON_HOUR_ANGLE_RATE ((360.98564736629 - 13.176358) / 86400.0)
+#define SUN_HOUR_ANGLE_RATE  ((360.98564736629 - 0.985647) / 86400.0)
+
+// Never wake again sooner than this, seconds.
+#define SCHEDULE_MIN_WAIT 1.0
+
+typedef struct {
+  double moonHourAngle;  // degrees, as drawn
+  double sunHourAngle;   // degrees, as drawn
+  int orbitRadius;       // pixels
+  double phaseStep;      // degrees of sun hour angle per phase sprite
+} FrameState;
+
+double secondsUntilChange(const FrameState *frame);
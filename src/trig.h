@@ -0,0 +1,21 @@
+#pragma once
+/*
+ * trig.h
+ * Integer trigonometry in the units of the Pebble SDK's sin_lookup(),
+ * cos_lookup() and atan2_lookup(): angles run 0..EPH_TRIG_MAX_ANGLE
+ * for one turn and ratios are scaled by EPH_TRIG_MAX_RATIO.
+ *
+ * On the watch they are the SDK's functions.  trig.c carries plain C
+ * tables of the same resolution for the host build, so that code using
+ * them builds and is checked there too.
+ */
+
+#include <stdint.h>
+
+// Same units as the SDK's TRIG_MAX_ANGLE and TRIG_MAX_RATIO.
+#define EPH_TRIG_MAX_ANGLE 0x10000
+#define EPH_TRIG_MAX_RATIO 0xffff
+
+int32_t sinLookup(int32_t angle);
+int32_t cosLookup(int32_t angle);
+int32_t atan2Lookup(int32_t y, int32_t x);
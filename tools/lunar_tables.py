@@ -0,0 +1,272 @@
+#!/usr/bin/env python
+#
+# Generates the moon's periodic terms as C tables, see lunar_terms.h,
+# or for an output ending in .js as the table pebble-js-app.js computes
+# the phone side ephemeris with, see ephemeris_feed.h.
+#
+#   python tools/lunar_tables.py lunar_tables.c
+#   python tools/lunar_tables.py lunar_terms.js
+#
+# Run by wscript and host/Makefile; the output is not checked in.
+#
+# The terms are Meeus - Astronomical Algorithms - tables 47.A and 47.B,
+# written out below as multiples of D, M, M' and F followed by the
+# coefficients:
+#
+# D = Mean elongation of the moon.
+# M = Mean anomaly of the sun.
+# M'= Mean anomaly of the moon.
+# F = Moon's argument of latitude.
+#
+# Longitude and latitude coefficients are degrees multiplied by
+# 1million, range coefficients are kilometres multiplied by 1000, and
+# the terms are of the form
+#
+# sin[i] * sin(D*D[i] + M*M[i] + M'*M'[i] + F*F[i]) = sum longitude
+# cos[i] * cos(D*D[i] + M*M[i] + M'*M'[i] + F*F[i]) = sum range
+#
+# Each is multiplied by E^n, where n is the absolute value of the M
+# multiplier, because the eccentricity of the earth's orbit is
+# decreasing: E = 1 - 0.002516 * T - 0.0000074 * T * T
+#
+# Every table is written as a struct of arrays: int8_t multipliers, the
+# power of E as an index and int32_t coefficients, largest amplitude
+# first, so a series can be cut short after any term.  Besides table
+# 47.A in full (longitude and range share each argument), the non-zero
+# terms of each sum get a dense table of their own.
+
+import sys
+
+# D, M, M', F, sin (longitude), cos (range)
+TABLE_47A = [
+    ( 0,  0,  1,  0,  6288774, -20905355),
+    ( 2,  0, -1,  0,  1274027,  -3699111),
+    ( 2,  0,  0,  0,   658314,  -2955968),
+    ( 0,  0,  2,  0,   213618,   -569925),
+    ( 0,  1,  0,  0,  -185116,     48888),
+    ( 0,  0,  0,  2,  -114332,     -3149),
+    ( 2,  0, -2,  0,    58793,    246158),
+    ( 2, -1, -1,  0,    57066,   -152138),
+    ( 2,  0,  1,  0,    53322,   -170733),
+    ( 2, -1,  0,  0,    45758,   -204586),
+    ( 0,  1, -1,  0,   -40923,   -129620),
+    ( 1,  0,  0,  0,   -34720,    108743),
+    ( 0,  1,  1,  0,   -30383,    104755),
+    ( 2,  0,  0, -2,    15327,     10321),
+    ( 0,  0,  1,  2,   -12528,         0),
+    ( 0,  0,  1, -2,    10980,     79661),
+    ( 4,  0, -1,  0,    10675,    -34782),
+    ( 0,  0,  3,  0,    10034,    -23210),
+    ( 4,  0, -2,  0,     8548,    -21636),
+    ( 2,  1, -1,  0,    -7888,     24208),
+    ( 2,  1,  0,  0,    -6766,     30824),
+    ( 1,  0, -1,  0,    -5163,     -8379),
+    ( 1,  1,  0,  0,     4987,    -16675),
+    ( 2, -1,  1,  0,     4036,    -12831),
+    ( 2,  0,  2,  0,     3994,    -10445),
+    ( 4,  0,  0,  0,     3861,    -11650),
+    ( 2,  0, -3,  0,     3665,     14403),
+    ( 0,  1, -2,  0,    -2689,     -7003),
+    ( 2,  0, -1,  2,    -2602,         0),
+    ( 2, -1, -2,  0,     2390,     10056),
+    ( 1,  0,  1,  0,    -2348,      6322),
+    ( 2, -2,  0,  0,     2236,     -9884),
+    ( 0,  1,  2,  0,    -2120,      5751),
+    ( 0,  2,  0,  0,    -2069,         0),
+    ( 2, -2, -1,  0,     2048,     -4950),
+    ( 2,  0,  1, -2,    -1773,      4131),
+    ( 2,  0,  0,  2,    -1595,         0),
+    ( 4, -1, -1,  0,     1215,     -3958),
+    ( 0,  0,  2,  2,    -1110,         0),
+    ( 3,  0, -1,  0,     -892,      3258),
+    ( 2,  1,  1,  0,     -810,      2616),
+    ( 4, -1, -2,  0,      759,     -1897),
+    ( 0,  2, -1,  0,     -713,     -2117),
+    ( 2,  2, -1,  0,     -700,      2354),
+    ( 2,  1, -2,  0,      691,         0),
+    ( 2, -1,  0, -2,      596,         0),
+    ( 4,  0,  1,  0,      549,     -1423),
+    ( 0,  0,  4,  0,      537,     -1117),
+    ( 4, -1,  0,  0,      520,     -1571),
+    ( 1,  0, -2,  0,     -487,     -1739),
+    ( 2,  1,  0, -2,     -399,         0),
+    ( 0,  0,  2, -2,     -381,     -4421),
+    ( 1,  1,  1,  0,      351,         0),
+    ( 3,  0, -2,  0,     -340,         0),
+    ( 4,  0, -3,  0,      330,         0),
+    ( 2, -1,  2,  0,      327,         0),
+    ( 0,  2,  1,  0,     -323,      1165),
+    ( 1,  1, -1,  0,      299,         0),
+    ( 2,  0,  3,  0,      294,         0),
+    ( 2,  0, -1, -2,        0,      8752),
+]
+
+# D, M, M', F, sin (latitude)
+TABLE_47B = [
+    ( 0,  0,  0,  1,  5128122),
+    ( 0,  0,  1,  1,   280602),
+    ( 0,  0,  1, -1,   277693),
+    ( 2,  0,  0, -1,   173237),
+    ( 2,  0, -1,  1,    55413),
+    ( 2,  0, -1, -1,    46271),
+    ( 2,  0,  0,  1,    32573),
+    ( 0,  0,  2,  1,    17198),
+    ( 2,  0,  1, -1,     9266),
+    ( 0,  0,  2, -1,     8822),
+    ( 2, -1,  0, -1,     8216),
+    ( 2,  0, -2, -1,     4324),
+    ( 2,  0,  1,  1,     4200),
+    ( 2,  1,  0, -1,    -3359),
+    ( 2, -1, -1,  1,     2463),
+    ( 2, -1,  0,  1,     2211),
+    ( 2, -1, -1, -1,     2065),
+    ( 0,  1, -1, -1,    -1870),
+    ( 4,  0, -1, -1,     1828),
+    ( 0,  1,  0,  1,    -1794),
+    ( 0,  0,  0,  3,    -1749),
+    ( 0,  1, -1,  1,    -1565),
+    ( 1,  0,  0,  1,    -1491),
+    ( 0,  1,  1,  1,    -1475),
+    ( 0,  1,  1, -1,    -1410),
+    ( 0,  1,  0, -1,    -1344),
+    ( 1,  0,  0, -1,    -1335),
+    ( 0,  0,  3,  1,     1107),
+    ( 4,  0,  0, -1,     1021),
+    ( 4,  0, -1,  1,      833),
+    ( 0,  0,  1, -3,      777),
+    ( 4,  0, -2,  1,      671),
+    ( 2,  0,  0, -3,      607),
+    ( 2,  0,  2, -1,      596),
+    ( 2, -1,  1, -1,      491),
+    ( 2,  0, -2,  1,     -451),
+    ( 0,  0,  3, -1,      439),
+    ( 2,  0,  2,  1,      422),
+    ( 2,  0, -3, -1,      421),
+    ( 2,  1, -1,  1,     -366),
+    ( 2,  1,  0,  1,     -351),
+    ( 4,  0,  0,  1,      331),
+    ( 2, -1,  1,  1,      315),
+    ( 2, -2,  0, -1,      302),
+    ( 0,  0,  1,  3,     -283),
+    ( 2,  1,  1, -1,     -229),
+    ( 1,  1,  0, -1,      223),
+    ( 1,  1,  0,  1,      223),
+    ( 0,  1, -2, -1,     -220),
+    ( 2,  1, -1, -1,     -220),
+    ( 1,  0,  1,  1,     -185),
+    ( 2, -1, -2, -1,      181),
+    ( 0,  1,  2,  1,     -177),
+    ( 4,  0, -2, -1,      176),
+    ( 4, -1, -1, -1,      166),
+    ( 1,  0,  1, -1,     -164),
+    ( 4,  0,  1, -1,      132),
+    ( 1,  0, -1, -1,     -119),
+    ( 4, -1,  0, -1,      115),
+    ( 2, -2,  0,  1,      107),
+]
+
+# Precision tiers, in the order of LunarPrecision in lunar_terms.h.  A
+# tier keeps the terms of each dense table down to an amplitude, in
+# 1e-6 degrees of longitude, metres of range and 1e-6 degrees of
+# latitude.  host/precision_check reports what each costs on screen.
+TIERS = [
+    ('full',    0,      0,      0),
+    ('screen',  0,      0,      10000),
+    ('low',     10000,  10000,  10000),
+    ('minimal', 100000, 100000, 100000),
+]
+
+# One 1e-6 degree of longitude moves the moon this many metres, which
+# puts longitude and range terms on one scale for sorting table 47.A
+METRES_PER_MICRODEGREE = 385000.56 * 1000 * 3.14159265358979 / 180 / 1e6
+
+
+def amplitude_47a(term):
+    return max(abs(term[4]) * METRES_PER_MICRODEGREE, abs(term[5]))
+
+
+def series(out, name, comment, terms, sine, cosine):
+    prefix = 'lunar' + name
+    out.append('// ' + comment + ', ' + str(len(terms)) + ' terms')
+    for column, field in enumerate(('D', 'M', 'Mm', 'F')):
+        values = [term[column] for term in terms]
+        out.append(array('int8_t', prefix + field, values))
+    out.append(array('uint8_t', prefix + 'E', [abs(term[1]) for term in terms]))
+    fields = []
+    for column, field in ((sine, 'Sin'), (cosine, 'Cos')):
+        if column is None:
+            fields.append('NULL')
+        else:
+            out.append(array('int32_t', prefix + field, [term[column] for term in terms]))
+            fields.append(prefix + field)
+    out.append('const LunarSeries lunar%sSeries = {\n  %d, %s%s, %s%s, %s%s, %s%s, %sE, %s, %s\n};\n'
+               % (name, len(terms), prefix, 'D', prefix, 'M', prefix, 'Mm', prefix, 'F',
+                  prefix, fields[0], fields[1]))
+
+
+def array(ctype, name, values):
+    lines = []
+    for start in range(0, len(values), 10):
+        lines.append('  ' + ', '.join('%d' % v for v in values[start:start + 10]) + ',')
+    return 'static const %s %s[%d] = {\n%s\n};' % (ctype, name, len(values), '\n'.join(lines))
+
+
+def main_js(path):
+    out = ['// lunar_terms.js',
+           '// Generated by tools/lunar_tables.py, do not edit.',
+           '',
+           '// Table 47.A: D, M, M\', F, longitude (1e-6 degrees), range (metres)',
+           'var LUNAR_TABLE_47A = [']
+    for term in TABLE_47A:
+        out.append('  [%s],' % ', '.join('%d' % v for v in term))
+    out.append('];')
+    out.append('')
+
+    with open(path, 'w') as f:
+        f.write('\n'.join(out))
+
+
+def main(path):
+    table_a = sorted(TABLE_47A, key=amplitude_47a, reverse=True)
+    longitude = sorted([t for t in TABLE_47A if t[4] != 0], key=lambda t: abs(t[4]), reverse=True)
+    range_ = sorted([t for t in TABLE_47A if t[5] != 0], key=lambda t: abs(t[5]), reverse=True)
+    latitude = sorted([t for t in TABLE_47B if t[4] != 0], key=lambda t: abs(t[4]), reverse=True)
+
+    out = ['/*',
+           ' * lunar_tables.c',
+           ' * Generated by tools/lunar_tables.py, do not edit.',
+           ' */',
+           '',
+           '#include <stddef.h>',
+           '#include "lunar_terms.h"',
+           '']
+    series(out, 'LongitudeRange', 'Table 47.A, longitude and range', table_a, 4, 5)
+    series(out, 'Longitude', 'Table 47.A, non-zero longitude terms', longitude, 4, None)
+    series(out, 'Range', 'Table 47.A, non-zero range terms', range_, None, 5)
+    series(out, 'Latitude', 'Table 47.B, non-zero latitude terms', latitude, 4, None)
+
+    out.append('// Terms of each dense table kept by a tier')
+    out.append('const LunarTier lunarTiers[LUNAR_PRECISIONS] = {')
+    for name, longitude_cut, range_cut, latitude_cut in TIERS:
+        out.append('  { "%s", %d, %d, %d },' % (
+            name,
+            len([t for t in longitude if abs(t[4]) >= longitude_cut]),
+            len([t for t in range_ if abs(t[5]) >= range_cut]),
+            len([t for t in latitude if abs(t[4]) >= latitude_cut])))
+    out.append('};')
+    out.append('')
+    out.append('LunarPrecision lunarPrecision = LUNAR_PRECISION;')
+    out.append('')
+
+    with open(path, 'w') as f:
+        f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        sys.stderr.write('usage: lunar_tables.py output.c|output.js\n')
+        sys.exit(2)
+    if sys.argv[1].endswith('.js'):
+        main_js(sys.argv[1])
+    else:
+        main(sys.argv[1])
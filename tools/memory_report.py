@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+#
+# Reports what an app ELF takes of a platform's app memory, by section:
+# code and constants (.text), initialised data (.data) and zeroed data
+# (.bss).  What is left of the budget is what the heap can have; the
+# face's own heap use is logged at launch by init() in luna.c, and
+# host/sim reports its peak for each build.
+#
+#   python tools/memory_report.py pebble-app.elf platform budget report.txt
+#
+# Run by wscript after each platform's app is linked.  Exits non-zero,
+# failing the build, when the sections alone do not fit the budget.
+
+import struct
+import sys
+
+SHT_NOBITS = 8
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+
+
+def sections(path):
+    with open(path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF' or elf[4:5] != b'\x01':
+        raise ValueError('%s is not a 32 bit ELF' % path)
+    endian = '<' if elf[5:6] == b'\x01' else '>'
+    shoff, = struct.unpack_from(endian + 'I', elf, 0x20)
+    shentsize, shnum = struct.unpack_from(endian + 'HH', elf, 0x2E)
+    for i in range(shnum):
+        _, kind, flags, _, _, size = struct.unpack_from(endian + 'IIIIII', elf, shoff + i * shentsize)
+        yield kind, flags, size
+
+
+def measure(path):
+    text = data = bss = 0
+    for kind, flags, size in sections(path):
+        if not flags & SHF_ALLOC:
+            continue
+        if kind == SHT_NOBITS:
+            bss += size
+        elif flags & SHF_WRITE:
+            data += size
+        else:
+            text += size
+    return text, data, bss
+
+
+def main(path, platform, budget, report):
+    text, data, bss = measure(path)
+    total = text + data + bss
+    line = ('%-8s text %6d  data %5d  bss %5d  = %6d of %6d bytes, %6d left for the heap'
+            % (platform, text, data, bss, total, budget, budget - total))
+    with open(report, 'w') as f:
+        f.write(line + '\n')
+    print(line)
+    return 0 if total <= budget else 1
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 5:
+        sys.stderr.write('usage: memory_report.py app.elf platform budget report.txt\n')
+        sys.exit(2)
+    sys.exit(main(sys.argv[1], sys.argv[2], int(sys.argv[3]), sys.argv[4]))
@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+#
+# Fits the polynomial kernels of src/fastmath.h by the Remez exchange.
+#
+#   python tools/minimax.py
+#
+# Prints each kernel's coefficients and its maximum error.  The output
+# is pasted into fastmath.h by hand; nothing runs this at build time.
+#
+# Each kernel is P(u) in u = r * r, fitted so that the weighted error
+# w(u) * (f(u) - P(u)) levels out over the range:
+#
+# sin(r) = r * P(r * r)     |r| <= PI/4           f = sin(r) / r, w = r
+# cos(r) = P(r * r)         |r| <= PI/4           f = cos(r),     w = 1
+# atan(a) = a * P(a * a)    |a| <= tan(PI/8)      f = atan(a) / a, w = a
+#
+# so sin and atan are held to an absolute error, like cos.
+
+from __future__ import print_function
+
+import math
+
+GRID = 20000
+ITERATIONS = 30
+
+
+def solve(A, b):
+    n = len(b)
+    M = [row[:] + [b[i]] for i, row in enumerate(A)]
+    for c in range(n):
+        p = max(range(c, n), key=lambda r: abs(M[r][c]))
+        M[c], M[p] = M[p], M[c]
+        for r in range(n):
+            if r != c:
+                f = M[r][c] / M[c][c]
+                for k in range(c, n + 1):
+                    M[r][k] -= f * M[c][k]
+    return [M[i][n] / M[i][i] for i in range(n)]
+
+
+def remez(f, w, lo, hi, n):
+    """n coefficients of P on [lo, hi] and the maximum weighted error."""
+    m = n + 1
+    points = [lo + (hi - lo) * (1 - math.cos(math.pi * i / (m - 1))) / 2 for i in range(m)]
+    grid = [lo + (hi - lo) * (1 - math.cos(math.pi * i / GRID)) / 2 for i in range(GRID + 1)]
+
+    def error(u):
+        return w(u) * (f(u) - sum(ck * u ** k for k, ck in enumerate(coefficients)))
+
+    for iteration in range(ITERATIONS):
+        A = [[u ** k for k in range(n)] + [(-1) ** i / w(u)] for i, u in enumerate(points)]
+        coefficients = solve(A, [f(u) for u in points])[:n]
+        errors = [error(u) for u in grid]
+
+        # The largest error in each run of one sign
+        extrema = []
+        i = 0
+        while i < len(grid):
+            positive = errors[i] >= 0
+            best = i
+            while i < len(grid) and (errors[i] >= 0) == positive:
+                if abs(errors[i]) > abs(errors[best]):
+                    best = i
+                i += 1
+            extrema.append(best)
+        while len(extrema) > m:
+            if abs(errors[extrema[0]]) < abs(errors[extrema[-1]]):
+                extrema.pop(0)
+            else:
+                extrema.pop()
+        if len(extrema) < m:
+            break
+        points = [grid[k] for k in extrema]
+    return coefficients, max(abs(e) for e in errors)
+
+
+def sinOverR(u):
+    r = math.sqrt(u)
+    return math.sin(r) / r if u > 1e-10 else 1 - u / 6
+
+
+def atanOverA(u):
+    a = math.sqrt(u)
+    return math.atan(a) / a if u > 1e-10 else 1 - u / 3
+
+
+KERNELS = [
+    ('sinKernel', sinOverR, math.sqrt, 1e-12, (math.pi / 4) ** 2, 4),
+    ('cosKernel', lambda u: math.cos(math.sqrt(u)), lambda u: 1.0, 0.0, (math.pi / 4) ** 2, 5),
+    ('atanKernel', atanOverA, math.sqrt, 1e-12, math.tan(math.pi / 8) ** 2, 6),
+]
+
+for name, f, w, lo, hi, n in KERNELS:
+    coefficients, worst = remez(f, w, lo, hi, n)
+    print('%s, |error| < %.2g' % (name, worst))
+    for c in coefficients:
+        print('  %.17g' % c)